@@ -40,7 +40,7 @@ aws s3 sync $IMAGES_S3_BUCKET .
 # run benchmark
 
 cd $CODE_DIR
-python3 src/main/python/make_page.py $IMAGES_DIR --build_path $BUILD_DIR/www \
+python3 src/main/python/make_page.py $IMAGES_DIR --build_path $BUILD_DIR/www --jobs $(nproc) \
   --version "$VERSION_STRING" --machine "$MACHINE_STRING" --compiler "$COMPILER_STRING"
 
 # upload website
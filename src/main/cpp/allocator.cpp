@@ -0,0 +1,248 @@
+#include "allocator.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <stdexcept>
+
+/* each allocation is preceded by a header that records its size */
+static const size_t ARENA_ALIGNMENT = 16;
+static const size_t ARENA_HEADER_SIZE = ARENA_ALIGNMENT;
+static const size_t ARENA_MIN_BLOCK_SIZE = 1 << 20;
+
+static size_t align_up(size_t size) {
+  return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+static size_t& allocation_size(void* ptr) {
+  return *reinterpret_cast<size_t*>((uint8_t*)ptr - ARENA_HEADER_SIZE);
+}
+
+libench::Arena::Arena() : scope_depth_(0), last_(NULL) {}
+
+libench::Arena::~Arena() {
+  for (auto& block : this->blocks_)
+    free(block.data);
+}
+
+libench::Arena& libench::Arena::local() {
+  static thread_local Arena arena;
+
+  return arena;
+}
+
+bool libench::Arena::owns(const void* ptr) const {
+  for (const auto& block : this->blocks_) {
+    if (ptr >= block.data && ptr < block.data + block.capacity)
+      return true;
+  }
+
+  return false;
+}
+
+void* libench::Arena::allocate(size_t size) {
+  if (this->scope_depth_ == 0)
+    return malloc(size);
+
+  size_t needed = ARENA_HEADER_SIZE + align_up(size);
+
+  if (this->blocks_.empty() || this->blocks_.back().capacity - this->blocks_.back().used < needed) {
+    size_t capacity = std::max(needed, ARENA_MIN_BLOCK_SIZE);
+
+    if (!this->blocks_.empty())
+      capacity = std::max(capacity, 2 * this->blocks_.back().capacity);
+
+    uint8_t* data = (uint8_t*) aligned_alloc(ARENA_ALIGNMENT, capacity);
+    if (!data)
+      return NULL;
+
+    this->blocks_.push_back(Block{data, capacity, 0});
+  }
+
+  Block& block = this->blocks_.back();
+
+  uint8_t* ptr = block.data + block.used + ARENA_HEADER_SIZE;
+
+  block.used += needed;
+
+  allocation_size(ptr) = size;
+
+  this->last_ = ptr;
+
+  return ptr;
+}
+
+void* libench::Arena::reallocate(void* ptr, size_t size) {
+  if (ptr == NULL)
+    return this->allocate(size);
+
+  if (!this->owns(ptr))
+    return realloc(ptr, size);
+
+  size_t old_size = allocation_size(ptr);
+
+  /* grow the most recent allocation in place if it fits */
+  if (ptr == this->last_) {
+    Block& block = this->blocks_.back();
+    size_t end = (uint8_t*)ptr - block.data + align_up(size);
+
+    if (end <= block.capacity) {
+      block.used = end;
+      allocation_size(ptr) = size;
+      return ptr;
+    }
+  }
+
+  if (size <= old_size) {
+    allocation_size(ptr) = size;
+    return ptr;
+  }
+
+  void* new_ptr = this->allocate(size);
+  if (new_ptr)
+    memcpy(new_ptr, ptr, old_size);
+
+  return new_ptr;
+}
+
+void libench::Arena::release(void* ptr) {
+  if (ptr != NULL && !this->owns(ptr))
+    free(ptr);
+}
+
+void libench::Arena::reset() {
+  if (this->blocks_.size() > 1) {
+    size_t capacity = 0;
+
+    for (const auto& block : this->blocks_)
+      capacity += block.capacity;
+
+    /* on failure, the blocks are kept as they are */
+    uint8_t* data = (uint8_t*) aligned_alloc(ARENA_ALIGNMENT, capacity);
+
+    if (data) {
+      for (auto& block : this->blocks_)
+        free(block.data);
+
+      this->blocks_.clear();
+      this->blocks_.push_back(Block{data, capacity, 0});
+    }
+  }
+
+  for (auto& block : this->blocks_)
+    block.used = 0;
+
+  this->last_ = NULL;
+}
+
+libench::ArenaScope::ArenaScope() {
+  Arena::local().scope_depth_++;
+}
+
+libench::ArenaScope::~ArenaScope() {
+  Arena& arena = Arena::local();
+
+  if (--arena.scope_depth_ == 0)
+    arena.reset();
+}
+
+/*
+ * Allocator backends
+ */
+
+static libench::AllocatorBackend backend = libench::AllocatorBackend::ARENA;
+
+/* entry points of the library loaded for the JEMALLOC and MIMALLOC backends */
+static void* (*library_malloc)(size_t) = NULL;
+static void* (*library_realloc)(void*, size_t) = NULL;
+static void (*library_free)(void*) = NULL;
+
+libench::AllocatorBackend libench::parse_allocator_backend(const std::string& name) {
+  if (name == "glibc") {
+    return AllocatorBackend::GLIBC;
+  } else if (name == "arena") {
+    return AllocatorBackend::ARENA;
+  } else if (name == "jemalloc") {
+    return AllocatorBackend::JEMALLOC;
+  } else if (name == "mimalloc") {
+    return AllocatorBackend::MIMALLOC;
+  }
+
+  throw std::runtime_error("Unknown allocator: " + name);
+}
+
+static void* load_library(const std::vector<const char*>& names) {
+  for (const char* name : names) {
+    /* RTLD_LOCAL keeps the library from interposing malloc for the rest of the process */
+    void* handle = dlopen(name, RTLD_NOW | RTLD_LOCAL);
+    if (handle)
+      return handle;
+  }
+
+  throw std::runtime_error(std::string("Cannot load ") + names.front());
+}
+
+template <typename F>
+static void load_symbol(void* handle, const char* name, F& fn) {
+  fn = reinterpret_cast<F>(dlsym(handle, name));
+  if (!fn)
+    throw std::runtime_error(std::string("Cannot find ") + name);
+}
+
+void libench::set_allocator_backend(AllocatorBackend new_backend) {
+  if (new_backend == AllocatorBackend::JEMALLOC) {
+    /* dlsym on the library handle finds the definitions of jemalloc, not those of libc */
+    void* handle = load_library({"libjemalloc.so.2", "libjemalloc.so"});
+
+    load_symbol(handle, "malloc", library_malloc);
+    load_symbol(handle, "realloc", library_realloc);
+    load_symbol(handle, "free", library_free);
+  } else if (new_backend == AllocatorBackend::MIMALLOC) {
+    void* handle = load_library({"libmimalloc.so.2", "libmimalloc.so"});
+
+    load_symbol(handle, "mi_malloc", library_malloc);
+    load_symbol(handle, "mi_realloc", library_realloc);
+    load_symbol(handle, "mi_free", library_free);
+  }
+
+  backend = new_backend;
+}
+
+libench::AllocatorBackend libench::allocator_backend() {
+  return backend;
+}
+
+void* libench_malloc(size_t size) {
+  switch (backend) {
+  case libench::AllocatorBackend::GLIBC:
+    return malloc(size);
+  case libench::AllocatorBackend::ARENA:
+    return libench::Arena::local().allocate(size);
+  default:
+    return library_malloc(size);
+  }
+}
+
+void* libench_realloc(void* ptr, size_t size) {
+  switch (backend) {
+  case libench::AllocatorBackend::GLIBC:
+    return realloc(ptr, size);
+  case libench::AllocatorBackend::ARENA:
+    return libench::Arena::local().reallocate(ptr, size);
+  default:
+    return library_realloc(ptr, size);
+  }
+}
+
+void libench_free(void* ptr) {
+  switch (backend) {
+  case libench::AllocatorBackend::GLIBC:
+    free(ptr);
+    break;
+  case libench::AllocatorBackend::ARENA:
+    libench::Arena::local().release(ptr);
+    break;
+  default:
+    library_free(ptr);
+  }
+}
@@ -0,0 +1,91 @@
+#ifndef LIBENCH_ALLOCATOR_H
+#define LIBENCH_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace libench {
+
+/*
+ * Per-thread bump allocator for the scratch memory of codecs that allocate
+ * through a pluggable malloc, e.g. lodepng and QOI. Allocations made inside an
+ * ArenaScope are served from the arena and individual frees are ignored; when
+ * the outermost scope of the thread ends, the arena is rewound but keeps its
+ * capacity, so that repeated calls of similar size do not allocate.
+ * Allocations made outside of any scope fall back to malloc.
+ */
+class Arena {
+ public:
+  ~Arena();
+
+  /* arena of the calling thread */
+  static Arena& local();
+
+  void* allocate(size_t size);
+
+  void* reallocate(void* ptr, size_t size);
+
+  void release(void* ptr);
+
+ private:
+  friend class ArenaScope;
+
+  struct Block {
+    uint8_t* data;
+    size_t capacity;
+    size_t used;
+  };
+
+  Arena();
+
+  bool owns(const void* ptr) const;
+
+  /* rewinds the arena, merging its blocks into one */
+  void reset();
+
+  std::vector<Block> blocks_;
+  unsigned scope_depth_;
+  /* most recent allocation, which can be grown in place */
+  uint8_t* last_;
+};
+
+class ArenaScope {
+ public:
+  ArenaScope();
+  ~ArenaScope();
+
+  ArenaScope(const ArenaScope&) = delete;
+  ArenaScope& operator=(const ArenaScope&) = delete;
+};
+
+/*
+ * Backend of the libench_malloc entry points, i.e. of the allocations of the
+ * codecs that expose an allocator hook: GLIBC calls malloc, ARENA uses the
+ * per-thread Arena above and JEMALLOC and MIMALLOC call the corresponding
+ * library, which is loaded at run time so that neither is a build dependency.
+ */
+enum class AllocatorBackend { GLIBC, ARENA, JEMALLOC, MIMALLOC };
+
+/* accepts "glibc", "arena", "jemalloc" or "mimalloc" */
+AllocatorBackend parse_allocator_backend(const std::string& name);
+
+/*
+ * must be called before the first allocation through libench_malloc; throws if
+ * the library of the backend cannot be loaded
+ */
+void set_allocator_backend(AllocatorBackend backend);
+
+AllocatorBackend allocator_backend();
+
+}  // namespace libench
+
+/* malloc-compatible entry points for C libraries */
+extern "C" {
+void* libench_malloc(size_t size);
+void* libench_realloc(void* ptr, size_t size);
+void libench_free(void* ptr);
+}
+
+#endif
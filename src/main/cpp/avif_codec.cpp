@@ -3,14 +3,89 @@
 #include <cstring>
 #include <stdexcept>
 
+static avifPixelFormat avif_pixel_format(const libench::ImageFormat& format) {
+  if (format.x_sub_factor[1] == 1 && format.y_sub_factor[1] == 1)
+    return AVIF_PIXEL_FORMAT_YUV444;
+  if (format.x_sub_factor[1] == 2 && format.y_sub_factor[1] == 1)
+    return AVIF_PIXEL_FORMAT_YUV422;
+  if (format.x_sub_factor[1] == 2 && format.y_sub_factor[1] == 2)
+    return AVIF_PIXEL_FORMAT_YUV420;
+  throw std::runtime_error("Unsupported chroma subsampling");
+}
+
+static libench::ImageFormat yuv_image_format(const avifImage* avif) {
+  static const libench::ImageFormat* formats[] = {
+      &libench::ImageFormat::YUV420P10, &libench::ImageFormat::YUV422P10,
+      &libench::ImageFormat::YUV444P10, &libench::ImageFormat::YUV420P12,
+      &libench::ImageFormat::YUV422P12, &libench::ImageFormat::YUV444P12};
+
+  for (const libench::ImageFormat* format : formats) {
+    if (format->bit_depth == avif->depth &&
+        avif_pixel_format(*format) == avif->yuvFormat)
+      return *format;
+  }
+
+  throw std::runtime_error("Unsupported YUV format");
+}
+
+/*
+ * resolves the name of an AV1 codec, or the libavif default if empty, to one
+ * that libavif was built with, so that the codec in use is known
+ */
+static avifCodecChoice codec_choice(const std::string& name, avifCodecFlags flags) {
+  avifCodecChoice choice = AVIF_CODEC_CHOICE_AUTO;
+
+  if (! name.empty()) {
+    choice = avifCodecChoiceFromName(name.c_str());
+
+    if (choice == AVIF_CODEC_CHOICE_AUTO)
+      throw std::runtime_error("Unknown AV1 codec: " + name);
+  }
+
+  const char* resolved = avifCodecName(choice, flags);
+
+  if (! resolved)
+    throw std::runtime_error("libavif was built without the AV1 codec: " + (name.empty() ? "default" : name));
+
+  return avifCodecChoiceFromName(resolved);
+}
+
+/* tile counts are powers of 2, 0 selecting automatic tiling */
+static int tile_count_log2(int count) {
+  if (count < 0 || (count & (count - 1)) != 0 || count > 64)
+    throw std::runtime_error("AVIF tile count must be 0 (automatic) or a power of 2 up to 64");
+
+  int log2 = 0;
+
+  while ((1 << log2) < count)
+    log2++;
+
+  return log2;
+}
+
 /*
  * AVIFEncoder
  */
 
-libench::AVIFEncoder::AVIFEncoder() {
+libench::AVIFEncoder::AVIFEncoder(const std::string& codec, int threads, int tile_cols, int tile_rows)
+    : codec_choice_(codec_choice(codec, AVIF_CODEC_FLAG_CAN_ENCODE)),
+      threads_(threads),
+      is_auto_tiling_(tile_cols == 0),
+      tile_cols_log2_(tile_count_log2(tile_cols)),
+      tile_rows_log2_(tile_count_log2(tile_rows)) {
+  if (threads < 1)
+    throw std::runtime_error("AVIF thread count must be at least 1");
+
+  if ((tile_cols == 0) != (tile_rows == 0))
+    throw std::runtime_error("AVIF tile columns and rows must both be automatic or both be specified");
+
   this->output_ = AVIF_DATA_EMPTY;
 }
 
+std::string libench::AVIFEncoder::backend() const {
+  return avifCodecName(this->codec_choice_, AVIF_CODEC_FLAG_CAN_ENCODE);
+}
+
 libench::AVIFEncoder::~AVIFEncoder() {
   avifRWDataFree(&this->output_);
 }
@@ -40,14 +115,48 @@ libench::CodestreamContext libench::AVIFEncoder::encode8(const ImageContext &ima
   avifResult result = avifImageRGBToYUV(avif.get(), &rgb);
   if (result != AVIF_RESULT_OK)
     throw std::runtime_error("avifImageRGBToYUV failed");
+
+  return this->encode(avif.get());
+}
+
+libench::CodestreamContext libench::AVIFEncoder::encodeYUV(const ImageContext &image) {
+  avifRWDataFree(&this->output_);
+
+  avif::ImagePtr avif(avifImageCreate(image.width, image.height,
+                                      image.format.bit_depth,
+                                      avif_pixel_format(image.format)));
+  if (!avif)
+    throw std::runtime_error("avifImageCreate failed");
+
+  /* the encoder reads the source planes in place, without any conversion */
+  for (int i = 0; i < 3; i++) {
+    avif->yuvPlanes[i] = image.planes8[i];
+    avif->yuvRowBytes[i] = image.line_size(i);
+  }
+  avif->imageOwnsYUVPlanes = AVIF_FALSE;
+
+  return this->encode(avif.get());
+}
+
+libench::CodestreamContext libench::AVIFEncoder::encode(avifImage* avif) {
+  avifResult result;
   avif::EncoderPtr encoder(avifEncoderCreate());
   if (!encoder)
     throw std::runtime_error("avifEncoderCreate failed");
+  encoder->codecChoice = this->codec_choice_;
+  encoder->maxThreads = this->threads_;
   encoder->speed = 6;
   encoder->quality = AVIF_QUALITY_LOSSLESS;
   encoder->qualityAlpha = encoder->quality;
-  encoder->autoTiling = AVIF_TRUE;
-  result = avifEncoderAddImage(encoder.get(), avif.get(), 1,
+
+  /* tiles can be encoded and decoded in parallel */
+  if (this->is_auto_tiling_) {
+    encoder->autoTiling = AVIF_TRUE;
+  } else {
+    encoder->tileColsLog2 = this->tile_cols_log2_;
+    encoder->tileRowsLog2 = this->tile_rows_log2_;
+  }
+  result = avifEncoderAddImage(encoder.get(), avif, 1,
                                AVIF_ADD_IMAGE_FLAG_SINGLE);
   if (result != AVIF_RESULT_OK)
     throw std::runtime_error("avifEncoderAddImage failed");
@@ -65,10 +174,18 @@ libench::CodestreamContext libench::AVIFEncoder::encode8(const ImageContext &ima
  * AVIFDecoder
  */
 
-libench::AVIFDecoder::AVIFDecoder() {
+libench::AVIFDecoder::AVIFDecoder(const std::string& codec, int threads)
+    : codec_choice_(codec_choice(codec, AVIF_CODEC_FLAG_CAN_DECODE)), threads_(threads) {
+  if (threads < 1)
+    throw std::runtime_error("AVIF thread count must be at least 1");
+
   memset(&this->rgb_, 0, sizeof(this->rgb_));
 }
 
+std::string libench::AVIFDecoder::backend() const {
+  return avifCodecName(this->codec_choice_, AVIF_CODEC_FLAG_CAN_DECODE);
+}
+
 libench::AVIFDecoder::~AVIFDecoder() {
   avifRGBImageFreePixels(&this->rgb_);
 }
@@ -81,10 +198,13 @@ libench::ImageContext libench::AVIFDecoder::decodeRGBA8(const CodestreamContext&
   return this->decode8(cs, 4);
 }
 
-libench::ImageContext libench::AVIFDecoder::decode8(const CodestreamContext& cs, uint8_t num_comps) {
+/* parses the codestream and decodes its first image */
+static avif::DecoderPtr decode_avif(const libench::CodestreamContext& cs, avifCodecChoice codec_choice, int threads) {
   avif::DecoderPtr decoder(avifDecoderCreate());
   if (!decoder)
     throw std::runtime_error("avifDecoderCreate failed");
+  decoder->codecChoice = codec_choice;
+  decoder->maxThreads = threads;
   avifResult result = avifDecoderSetIOMemory(decoder.get(), cs.codestream,
                                              cs.size);
   if (result != AVIF_RESULT_OK)
@@ -96,17 +216,40 @@ libench::ImageContext libench::AVIFDecoder::decode8(const CodestreamContext& cs,
   if (result != AVIF_RESULT_OK)
     throw std::runtime_error("avifDecoderNextImage failed");
 
-  if (decoder->image->depth != 8)
+  return decoder;
+}
+
+static void check_lossless_rgb(const avifImage* image) {
+  if (image->depth != 8)
     throw std::runtime_error("Bit depth must be 8");
-  if (decoder->image->yuvFormat != AVIF_PIXEL_FORMAT_YUV444)
+  if (image->yuvFormat != AVIF_PIXEL_FORMAT_YUV444)
     throw std::runtime_error("YUV format must be 4:4:4 for lossless");
-  if (decoder->image->matrixCoefficients != AVIF_MATRIX_COEFFICIENTS_IDENTITY)
+  if (image->matrixCoefficients != AVIF_MATRIX_COEFFICIENTS_IDENTITY)
     throw std::runtime_error("Matrix coefficients must be identity for lossless");
+}
+
+/* copies the planes of the decoded image, which are owned by the decoder and may be padded */
+static void copy_yuv_planes(const avifImage* avif, libench::ImageContext& image) {
+  for (int i = 0; i < image.format.num_planes(); i++) {
+    const uint8_t* src_line = avif->yuvPlanes[i];
+    uint8_t* dst_line = image.planes8[i];
+    for (uint32_t y = 0; y < image.plane_height(i); y++) {
+      memcpy(dst_line, src_line, image.line_size(i));
+      src_line += avif->yuvRowBytes[i];
+      dst_line += image.line_size(i);
+    }
+  }
+}
+
+libench::ImageContext libench::AVIFDecoder::decode8(const CodestreamContext& cs, uint8_t num_comps) {
+  avif::DecoderPtr decoder = decode_avif(cs, this->codec_choice_, this->threads_);
+
+  check_lossless_rgb(decoder->image);
 
   avifRGBImageSetDefaults(&this->rgb_, decoder->image);
   this->rgb_.format = num_comps == 3 ? AVIF_RGB_FORMAT_RGB
                                      : AVIF_RGB_FORMAT_RGBA;
-  result = avifRGBImageAllocatePixels(&this->rgb_);
+  avifResult result = avifRGBImageAllocatePixels(&this->rgb_);
   if (result != AVIF_RESULT_OK)
     throw std::runtime_error("avifRGBImageAllocatePixels failed");
   result = avifImageYUVToRGB(decoder->image, &this->rgb_);
@@ -121,3 +264,48 @@ libench::ImageContext libench::AVIFDecoder::decode8(const CodestreamContext& cs,
   image.planes8[0] = this->rgb_.pixels;
   return image;
 }
+
+libench::ImageContext libench::AVIFDecoder::decodeYUV(const CodestreamContext& cs) {
+  avif::DecoderPtr decoder = decode_avif(cs, this->codec_choice_, this->threads_);
+
+  ImageContext image;
+  image.width = decoder->image->width;
+  image.height = decoder->image->height;
+  image.format = yuv_image_format(decoder->image);
+
+  for (int i = 0; i < image.format.num_planes(); i++) {
+    this->planes_[i].resize(image.plane_size(i));
+    image.planes8[i] = this->planes_[i].data();
+  }
+
+  copy_yuv_planes(decoder->image, image);
+
+  return image;
+}
+
+void libench::AVIFDecoder::decodeInto(const CodestreamContext& cs, ImageContext& image) {
+  avif::DecoderPtr decoder = decode_avif(cs, this->codec_choice_, this->threads_);
+
+  if (decoder->image->width != image.width || decoder->image->height != image.height)
+    throw std::runtime_error("Destination image does not match the codestream");
+
+  if (image.format == libench::ImageFormat::RGB8 || image.format == libench::ImageFormat::RGBA8) {
+    check_lossless_rgb(decoder->image);
+
+    /* libavif converts directly into the destination pixels */
+    avifRGBImage rgb;
+    avifRGBImageSetDefaults(&rgb, decoder->image);
+    rgb.format = image.format.comps.num_comps == 3 ? AVIF_RGB_FORMAT_RGB
+                                                   : AVIF_RGB_FORMAT_RGBA;
+    rgb.pixels = image.planes8[0];
+    rgb.rowBytes = image.line_size(0);
+
+    if (avifImageYUVToRGB(decoder->image, &rgb) != AVIF_RESULT_OK)
+      throw std::runtime_error("avifImageYUVToRGB failed");
+  } else {
+    if (!(yuv_image_format(decoder->image) == image.format))
+      throw std::runtime_error("Destination image does not match the codestream");
+
+    copy_yuv_planes(decoder->image, image);
+  }
+}
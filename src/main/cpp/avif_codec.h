@@ -1,6 +1,8 @@
 #ifndef LIBENCH_AVIF_H
 #define LIBENCH_AVIF_H
 
+#include <string>
+#include <vector>
 #include "codec.h"
 
 #include "avif/avif.h"
@@ -9,32 +11,59 @@ namespace libench {
 
 class AVIFEncoder : public Encoder {
  public:
-  AVIFEncoder();
+  /*
+   * codec is the name of the AV1 encoder, e.g. aom or svt, or empty for the
+   * libavif default; tile_cols and tile_rows are powers of 2, or 0 to let
+   * libavif choose the tiling from the image size
+   */
+  AVIFEncoder(const std::string& codec = "", int threads = 1, int tile_cols = 0, int tile_rows = 0);
   ~AVIFEncoder() override;
 
   CodestreamContext encodeRGB8(const ImageContext &image) override;
 
   CodestreamContext encodeRGBA8(const ImageContext &image) override;
 
+  CodestreamContext encodeYUV(const ImageContext &image) override;
+
+  std::string backend() const override;
+
  private:
   CodestreamContext encode8(const ImageContext &image);
 
+  CodestreamContext encode(avifImage* image);
+
+  avifCodecChoice codec_choice_;
+  int threads_;
+  bool is_auto_tiling_;
+  int tile_cols_log2_;
+  int tile_rows_log2_;
   avifRWData output_;
 };
 
 class AVIFDecoder : public Decoder {
  public:
-  AVIFDecoder();
+  /* codec is the name of the AV1 decoder, e.g. dav1d or aom, or empty for the libavif default */
+  AVIFDecoder(const std::string& codec = "", int threads = 1);
   ~AVIFDecoder() override;
 
   ImageContext decodeRGB8(const CodestreamContext& cs) override;
 
   ImageContext decodeRGBA8(const CodestreamContext& cs) override;
 
+  ImageContext decodeYUV(const CodestreamContext& cs) override;
+
+  void decodeInto(const CodestreamContext& cs, ImageContext& image) override;
+
+  std::string backend() const override;
+
  private:
   ImageContext decode8(const CodestreamContext& cs, uint8_t num_comps);
 
+  avifCodecChoice codec_choice_;
+  int threads_;
+
   avifRGBImage rgb_;
+  std::vector<uint8_t> planes_[3];
 };
 
 }  // namespace libench
@@ -0,0 +1,328 @@
+#include "bands_codec.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <stdexcept>
+
+static const char BANDS_MAGIC[4] = {'L', 'B', 'N', 'D'};
+
+struct BandIndexEntry {
+  uint64_t offset;
+  uint64_t size;
+  uint64_t state_size;
+  uint32_t first_row;
+  uint32_t rows;
+};
+
+static const size_t BANDS_HEADER_SIZE = sizeof(BANDS_MAGIC) + 3 * sizeof(uint32_t);
+
+/*
+ * BandWorkers
+ */
+
+libench::BandWorkers::BandWorkers(size_t n)
+    : fn_(NULL), count_(0), generation_(0), pending_(0), is_stopping_(false) {
+  for (size_t i = 1; i < n; i++) {
+    this->threads_.emplace_back(&BandWorkers::work, this, i);
+  }
+}
+
+libench::BandWorkers::~BandWorkers() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->is_stopping_ = true;
+  }
+
+  this->start_cv_.notify_all();
+
+  for (auto& t : this->threads_) {
+    t.join();
+  }
+}
+
+void libench::BandWorkers::work(size_t i) {
+  uint64_t generation = 0;
+
+  for (;;) {
+    std::unique_lock<std::mutex> lock(this->mutex_);
+
+    this->start_cv_.wait(lock, [&] { return this->is_stopping_ || this->generation_ != generation; });
+
+    if (this->is_stopping_)
+      return;
+
+    generation = this->generation_;
+
+    if (i >= this->count_)
+      continue;
+
+    const std::function<void(size_t)>& fn = *this->fn_;
+
+    lock.unlock();
+
+    try {
+      fn(i);
+    } catch (...) {
+      this->errors_[i] = std::current_exception();
+    }
+
+    lock.lock();
+
+    if (--this->pending_ == 0)
+      this->done_cv_.notify_one();
+  }
+}
+
+void libench::BandWorkers::run(size_t count, const std::function<void(size_t)>& fn) {
+  if (count > this->threads_.size() + 1)
+    throw std::runtime_error("Not enough band workers");
+
+  if (count == 0)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->fn_ = &fn;
+    this->count_ = count;
+    this->pending_ = count - 1;
+    this->errors_.assign(count, std::exception_ptr());
+    this->generation_++;
+  }
+
+  this->start_cv_.notify_all();
+
+  try {
+    fn(0);
+  } catch (...) {
+    this->errors_[0] = std::current_exception();
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    this->done_cv_.wait(lock, [&] { return this->pending_ == 0; });
+  }
+
+  for (auto& e : this->errors_) {
+    if (e)
+      std::rethrow_exception(e);
+  }
+}
+
+/* returns a view of rows [first_row, first_row + rows) of the image */
+static libench::ImageContext band_image(const libench::ImageContext& image, uint32_t first_row, uint32_t rows) {
+  libench::ImageContext band = image;
+
+  band.height = rows;
+
+  for (uint8_t p = 0; p < image.format.num_planes(); p++) {
+    band.planes8[p] = image.planes8[p] + (size_t)(first_row / image.format.y_sub_factor[p]) * image.line_size(p);
+  }
+
+  return band;
+}
+
+/*
+ * BandsEncoder
+ */
+
+libench::BandsEncoder::BandsEncoder(std::vector<std::unique_ptr<Encoder>> encoders)
+    : encoders_(std::move(encoders)), workers_(encoders_.size()) {
+  if (this->encoders_.empty())
+    throw std::runtime_error("At least one band is required");
+}
+
+libench::CodestreamContext libench::BandsEncoder::encodeRGB8(const ImageContext &image) {
+  return this->encode(image);
+}
+
+libench::CodestreamContext libench::BandsEncoder::encodeRGBA8(const ImageContext &image) {
+  return this->encode(image);
+}
+
+libench::CodestreamContext libench::BandsEncoder::encodeYUV(const ImageContext &image) {
+  return this->encode(image);
+}
+
+libench::CodestreamContext libench::BandsEncoder::encode(const ImageContext &image) {
+  /* band boundaries fall on chroma rows */
+
+  uint32_t row_align = 1;
+  for (uint8_t p = 0; p < image.format.num_planes(); p++) {
+    row_align = std::max<uint32_t>(row_align, image.format.y_sub_factor[p]);
+  }
+
+  uint32_t band_height = (image.height + this->encoders_.size() - 1) / this->encoders_.size();
+  band_height = (band_height + row_align - 1) / row_align * row_align;
+
+  size_t band_count = (image.height + band_height - 1) / band_height;
+
+  std::vector<BandIndexEntry> index(band_count);
+
+  for (size_t i = 0; i < band_count; i++) {
+    index[i].first_row = i * band_height;
+    index[i].rows = std::min(band_height, image.height - index[i].first_row);
+  }
+
+  /* encode */
+
+  this->band_cs_.resize(band_count);
+
+  this->workers_.run(band_count, [&](size_t i) {
+    this->band_cs_[i] = this->encoders_[i]->encodeImage(band_image(image, index[i].first_row, index[i].rows));
+  });
+
+  /* pack */
+
+  size_t offset = BANDS_HEADER_SIZE + band_count * sizeof(BandIndexEntry);
+
+  for (size_t i = 0; i < band_count; i++) {
+    index[i].offset = offset;
+    index[i].size = this->band_cs_[i].size;
+    index[i].state_size = this->band_cs_[i].state_size;
+    offset += index[i].size + index[i].state_size;
+  }
+
+  this->codestream_.resize(offset);
+
+  uint8_t* out = this->codestream_.data();
+  uint32_t header[3] = {(uint32_t)band_count, image.width, image.height};
+
+  memcpy(out, BANDS_MAGIC, sizeof(BANDS_MAGIC));
+  memcpy(out + sizeof(BANDS_MAGIC), header, sizeof(header));
+  memcpy(out + BANDS_HEADER_SIZE, index.data(), band_count * sizeof(BandIndexEntry));
+
+  for (size_t i = 0; i < band_count; i++) {
+    memcpy(out + index[i].offset, this->band_cs_[i].codestream, index[i].size);
+    if (index[i].state_size > 0)
+      memcpy(out + index[i].offset + index[i].size, this->band_cs_[i].state, index[i].state_size);
+  }
+
+  CodestreamContext cs;
+
+  cs.codestream = this->codestream_.data();
+  cs.size = this->codestream_.size();
+
+  return cs;
+}
+
+/*
+ * BandsDecoder
+ */
+
+libench::BandsDecoder::BandsDecoder(std::vector<std::unique_ptr<Decoder>> decoders)
+    : decoders_(std::move(decoders)), workers_(decoders_.size()) {
+  if (this->decoders_.empty())
+    throw std::runtime_error("At least one band is required");
+}
+
+libench::ImageContext libench::BandsDecoder::decodeRGB8(const CodestreamContext& cs) {
+  return this->decode(cs, libench::ImageFormat::RGB8);
+}
+
+libench::ImageContext libench::BandsDecoder::decodeRGBA8(const CodestreamContext& cs) {
+  return this->decode(cs, libench::ImageFormat::RGBA8);
+}
+
+libench::ImageContext libench::BandsDecoder::decodeYUV(const CodestreamContext& cs) {
+  /* the inner decoders report the exact YUV format */
+  return this->decode(cs, libench::ImageFormat::YUV422P10);
+}
+
+/* parses the container header and index */
+static std::vector<BandIndexEntry> read_index(const libench::CodestreamContext& cs, size_t max_band_count,
+                                              uint32_t& width, uint32_t& height) {
+  if (cs.size < BANDS_HEADER_SIZE || memcmp(cs.codestream, BANDS_MAGIC, sizeof(BANDS_MAGIC)))
+    throw std::runtime_error("Not a bands codestream");
+
+  uint32_t header[3];
+  memcpy(header, cs.codestream + sizeof(BANDS_MAGIC), sizeof(header));
+
+  size_t band_count = header[0];
+
+  if (band_count > max_band_count)
+    throw std::runtime_error("Not enough band decoders");
+
+  if (cs.size < BANDS_HEADER_SIZE + band_count * sizeof(BandIndexEntry))
+    throw std::runtime_error("Truncated bands index");
+
+  std::vector<BandIndexEntry> index(band_count);
+  memcpy(index.data(), cs.codestream + BANDS_HEADER_SIZE, band_count * sizeof(BandIndexEntry));
+
+  width = header[1];
+  height = header[2];
+
+  return index;
+}
+
+/* returns the codestream and state of a band */
+static libench::CodestreamContext band_codestream(const libench::CodestreamContext& cs, const BandIndexEntry& entry) {
+  if (entry.offset + entry.size + entry.state_size > cs.size)
+    throw std::runtime_error("Truncated band codestream");
+
+  libench::CodestreamContext band_cs;
+
+  band_cs.codestream = cs.codestream + entry.offset;
+  band_cs.size = entry.size;
+
+  if (entry.state_size > 0) {
+    band_cs.state = band_cs.codestream + band_cs.size;
+    band_cs.state_size = entry.state_size;
+  }
+
+  return band_cs;
+}
+
+void libench::BandsDecoder::decodeInto(const CodestreamContext& cs, ImageContext& image) {
+  uint32_t width;
+  uint32_t height;
+
+  std::vector<BandIndexEntry> index = read_index(cs, this->decoders_.size(), width, height);
+
+  if (width != image.width || height != image.height)
+    throw std::runtime_error("Destination image does not match the codestream");
+
+  this->workers_.run(index.size(), [&](size_t i) {
+    if (index[i].first_row + index[i].rows > image.height)
+      throw std::runtime_error("Band does not match the image");
+
+    ImageContext band = band_image(image, index[i].first_row, index[i].rows);
+
+    this->decoders_[i]->decodeInto(band_codestream(cs, index[i]), band);
+  });
+}
+
+libench::ImageContext libench::BandsDecoder::decode(const CodestreamContext& cs, const ImageFormat& format) {
+  ImageContext image;
+
+  std::vector<BandIndexEntry> index = read_index(cs, this->decoders_.size(), image.width, image.height);
+
+  size_t band_count = index.size();
+
+  std::vector<ImageContext> bands(band_count);
+
+  this->workers_.run(band_count, [&](size_t i) {
+    bands[i] = this->decoders_[i]->decodeImage(band_codestream(cs, index[i]), format);
+  });
+
+  /* assemble the bands */
+
+  image.format = band_count > 0 ? bands[0].format : format;
+
+  for (uint8_t p = 0; p < image.format.num_planes(); p++) {
+    this->planes_[p].resize(image.plane_size(p));
+    image.planes8[p] = this->planes_[p].data();
+  }
+
+  this->workers_.run(band_count, [&](size_t i) {
+    if (bands[i].width != image.width || bands[i].height != index[i].rows || !(bands[i].format == image.format))
+      throw std::runtime_error("Band does not match the image");
+
+    for (uint8_t p = 0; p < image.format.num_planes(); p++) {
+      memcpy(image.planes8[p] + (size_t)(index[i].first_row / image.format.y_sub_factor[p]) * image.line_size(p),
+             bands[i].planes8[p], bands[i].plane_size(p));
+    }
+  });
+
+  return image;
+}
@@ -0,0 +1,110 @@
+#ifndef LIBENCH_BANDS_H
+#define LIBENCH_BANDS_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "codec.h"
+
+namespace libench {
+
+/*
+ * Threads that live as long as the codec and run bands 1 to n - 1 of each
+ * call, the calling thread running band 0, so that no thread is created per
+ * encode or decode
+ */
+
+class BandWorkers {
+ public:
+  explicit BandWorkers(size_t n);
+  ~BandWorkers();
+
+  /* runs fn(0) ... fn(count - 1) concurrently, count <= n, and rethrows the first failure */
+  void run(size_t count, const std::function<void(size_t)>& fn);
+
+ private:
+  void work(size_t i);
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_cv_;
+  std::condition_variable done_cv_;
+  const std::function<void(size_t)>* fn_;
+  size_t count_;
+  /* incremented by each call to run() */
+  uint64_t generation_;
+  /* workers yet to finish the current call */
+  size_t pending_;
+  bool is_stopping_;
+  std::vector<std::exception_ptr> errors_;
+};
+
+/*
+ * Splits the image into horizontal bands that are coded concurrently, one
+ * band per inner codec instance. The band codestreams are packed into a
+ * container that starts with an index:
+ *
+ *   "LBND" | band count (u32) | width (u32) | height (u32)
+ *   band count x [ offset (u64) | size (u64) | state size (u64) | first row (u32) | rows (u32) ]
+ *
+ * The codestream state of each band, if any, immediately follows the band
+ * codestream, so that the container is self-contained.
+ */
+
+class BandsEncoder : public Encoder {
+ public:
+  BandsEncoder(std::vector<std::unique_ptr<Encoder>> encoders);
+
+  CodestreamContext encodeRGB8(const ImageContext &image) override;
+
+  CodestreamContext encodeRGBA8(const ImageContext &image) override;
+
+  CodestreamContext encodeYUV(const ImageContext &image) override;
+
+  /* all bands use the same codec */
+  std::string backend() const override {
+    return this->encoders_.front()->backend();
+  }
+
+ private:
+  CodestreamContext encode(const ImageContext &image);
+
+  std::vector<std::unique_ptr<Encoder>> encoders_;
+  BandWorkers workers_;
+  std::vector<CodestreamContext> band_cs_;
+  std::vector<uint8_t> codestream_;
+};
+
+class BandsDecoder : public Decoder {
+ public:
+  BandsDecoder(std::vector<std::unique_ptr<Decoder>> decoders);
+
+  ImageContext decodeRGB8(const CodestreamContext& cs) override;
+
+  ImageContext decodeRGBA8(const CodestreamContext& cs) override;
+
+  ImageContext decodeYUV(const CodestreamContext& cs) override;
+
+  /* each band is decoded directly into its rows of the image */
+  void decodeInto(const CodestreamContext& cs, ImageContext& image) override;
+
+  std::string backend() const override {
+    return this->decoders_.front()->backend();
+  }
+
+ private:
+  ImageContext decode(const CodestreamContext& cs, const ImageFormat& format);
+
+  std::vector<std::unique_ptr<Decoder>> decoders_;
+  BandWorkers workers_;
+  std::vector<uint8_t> planes_[4];
+};
+
+}  // namespace libench
+
+#endif
@@ -0,0 +1,187 @@
+#include "cache_control.h"
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "trace.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+static const size_t CACHE_LINE_SIZE = 64;
+
+/* used when the last-level cache size cannot be determined */
+static const size_t DEFAULT_LLC_SIZE = 64 << 20;
+
+/* the sweep buffer is this many times the last-level cache */
+static const size_t SWEEP_FACTOR = 4;
+
+/*
+ * CacheEvictor
+ */
+
+libench::CacheEvictor::CacheEvictor(Method method) : method_(method), checksum_(0) {
+  size_t llc_size = lastLevelCacheSize();
+
+  if (llc_size == 0)
+    llc_size = DEFAULT_LLC_SIZE;
+
+  this->sweep_buffer_.resize(SWEEP_FACTOR * llc_size, 1);
+}
+
+libench::CacheEvictor::Method libench::CacheEvictor::parseMethod(const std::string& name) {
+  if (name == "sweep") {
+    return Method::SWEEP;
+  } else if (name == "clflush") {
+#if defined(__x86_64__) || defined(__i386__)
+    return Method::CLFLUSH;
+#else
+    throw std::runtime_error("clflush is only available on x86");
+#endif
+  }
+
+  throw std::runtime_error("Unknown cache eviction method: " + name);
+}
+
+size_t libench::CacheEvictor::lastLevelCacheSize() {
+  size_t llc_size = 0;
+
+#ifdef _SC_LEVEL3_CACHE_SIZE
+  long l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  if (l3 > 0)
+    llc_size = (size_t) l3;
+#endif
+
+  if (llc_size > 0)
+    return llc_size;
+
+  /* the largest cache listed by sysfs, e.g. "32768K" */
+  for (int index = 0; index < 8; index++) {
+    std::ifstream f("/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/size");
+    std::string size;
+
+    if (!(f >> size))
+      break;
+
+    size_t value = std::stoul(size);
+
+    if (size.back() == 'K') {
+      value <<= 10;
+    } else if (size.back() == 'M') {
+      value <<= 20;
+    }
+
+    if (value > llc_size)
+      llc_size = value;
+  }
+
+  return llc_size;
+}
+
+void libench::CacheEvictor::evict(const std::vector<MemoryRegion>& regions) {
+  LIBENCH_TRACE_SPAN("evict");
+
+  if (this->method_ == Method::SWEEP) {
+    /* writes, in addition to reads, also displace dirty lines */
+    volatile uint8_t* buffer = this->sweep_buffer_.data();
+    uint64_t sum = 0;
+
+    for (size_t i = 0; i < this->sweep_buffer_.size(); i += CACHE_LINE_SIZE) {
+      sum += buffer[i];
+      buffer[i] = (uint8_t) sum;
+    }
+
+    this->checksum_ += sum;
+
+    return;
+  }
+
+#if defined(__x86_64__) || defined(__i386__)
+  for (const auto& region : regions) {
+    const uint8_t* begin = (const uint8_t*) region.data;
+
+    if (begin == NULL)
+      continue;
+
+    for (size_t i = 0; i < region.size; i += CACHE_LINE_SIZE)
+      _mm_clflush(begin + i);
+
+    if (region.size > 0)
+      _mm_clflush(begin + region.size - 1);
+  }
+
+  _mm_mfence();
+#endif
+}
+
+std::vector<libench::MemoryRegion> libench::image_regions(const ImageContext& image) {
+  std::vector<MemoryRegion> regions;
+
+  for (uint8_t i = 0; i < image.format.num_planes(); i++)
+    regions.push_back(MemoryRegion{image.planes8[i], image.plane_size(i)});
+
+  return regions;
+}
+
+/*
+ * FreshImage
+ */
+
+libench::FreshImage::FreshImage(const ImageContext& image) : image_(image), fd_(-1), size_(0), data_(NULL) {
+  for (uint8_t i = 0; i < image.format.num_planes(); i++)
+    this->size_ += image.plane_size(i);
+
+  this->fd_ = memfd_create("libench-fresh-image", 0);
+  if (this->fd_ < 0)
+    throw std::runtime_error("Cannot create in-memory file");
+
+  for (uint8_t i = 0; i < image.format.num_planes(); i++) {
+    const uint8_t* data = image.planes8[i];
+    size_t remaining = image.plane_size(i);
+
+    while (remaining > 0) {
+      ssize_t written = write(this->fd_, data, remaining);
+      if (written <= 0) {
+        close(this->fd_);
+        throw std::runtime_error("Cannot write in-memory file");
+      }
+
+      data += written;
+      remaining -= written;
+    }
+  }
+}
+
+libench::FreshImage::~FreshImage() {
+  this->unmap();
+
+  if (this->fd_ >= 0)
+    close(this->fd_);
+}
+
+void libench::FreshImage::unmap() {
+  if (this->data_)
+    munmap(this->data_, this->size_);
+
+  this->data_ = NULL;
+}
+
+libench::ImageContext libench::FreshImage::remap() {
+  this->unmap();
+
+  void* data = mmap(NULL, this->size_, PROT_READ, MAP_SHARED, this->fd_, 0);
+  if (data == MAP_FAILED)
+    throw std::runtime_error("Cannot map in-memory file");
+
+  this->data_ = (uint8_t*) data;
+
+  ImageContext image = this->image_;
+  size_t offset = 0;
+
+  for (uint8_t i = 0; i < image.format.num_planes(); i++) {
+    image.planes8[i] = this->data_ + offset;
+    offset += image.plane_size(i);
+  }
+
+  return image;
+}
@@ -0,0 +1,75 @@
+#ifndef LIBENCH_CACHE_CONTROL_H
+#define LIBENCH_CACHE_CONTROL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "codec.h"
+
+namespace libench {
+
+struct MemoryRegion {
+  const void* data;
+  size_t size;
+};
+
+/*
+ * Evicts data from the CPU caches between benchmark phases, either by
+ * streaming through a buffer several times larger than the last-level cache,
+ * which also evicts the code and tables of the codec, or by flushing only the
+ * specified regions with clflush.
+ */
+class CacheEvictor {
+ public:
+  enum class Method { SWEEP, CLFLUSH };
+
+  explicit CacheEvictor(Method method);
+
+  /* accepts "sweep" or "clflush" */
+  static Method parseMethod(const std::string& name);
+
+  void evict(const std::vector<MemoryRegion>& regions);
+
+  /* size of the last-level cache, as reported by the OS, or 0 if unknown */
+  static size_t lastLevelCacheSize();
+
+ private:
+  Method method_;
+  std::vector<uint8_t> sweep_buffer_;
+  /* prevents the sweep from being optimized away */
+  uint64_t checksum_;
+};
+
+/* regions covering the planes of an image */
+std::vector<MemoryRegion> image_regions(const ImageContext& image);
+
+/*
+ * Copy of an image whose planes are placed in a fresh, never-touched mapping
+ * on each call to remap(), so that the encoder takes the page faults and TLB
+ * misses of a newly received frame. The pixels are held in an anonymous
+ * in-memory file, so the mapping is populated from the page cache.
+ */
+class FreshImage {
+ public:
+  explicit FreshImage(const ImageContext& image);
+  ~FreshImage();
+
+  FreshImage(const FreshImage&) = delete;
+  FreshImage& operator=(const FreshImage&) = delete;
+
+  /* unmaps the previous mapping, if any; the returned planes remain valid until the next call */
+  ImageContext remap();
+
+ private:
+  void unmap();
+
+  ImageContext image_;
+  int fd_;
+  size_t size_;
+  uint8_t* data_;
+};
+
+}  // namespace libench
+
+#endif
@@ -1,4 +1,5 @@
 #include "codec.h"
+#include <algorithm>
 
 libench::ImageComponents libench::ImageComponents::RGBA = libench::ImageComponents(4, "RGBA");
 libench::ImageComponents libench::ImageComponents::RGB = libench::ImageComponents(3, "RGB");
@@ -6,4 +7,113 @@ libench::ImageComponents libench::ImageComponents::YUV = libench::ImageComponent
 
 libench::ImageFormat libench::ImageFormat::RGBA8 = libench::ImageFormat(8, libench::ImageComponents::RGBA, false, {1, 1, 1, 1}, {1, 1, 1, 1});
 libench::ImageFormat libench::ImageFormat::RGB8 = libench::ImageFormat(8, libench::ImageComponents::RGB, false, {1, 1, 1, 1}, {1, 1, 1, 1});
+libench::ImageFormat libench::ImageFormat::YUV420P10 = libench::ImageFormat(10, libench::ImageComponents::YUV, true, {1, 2, 2, 1}, {1, 2, 2, 1});
 libench::ImageFormat libench::ImageFormat::YUV422P10 = libench::ImageFormat(10, libench::ImageComponents::YUV, true, {1, 2, 2, 1}, {1, 1, 1, 1});
+libench::ImageFormat libench::ImageFormat::YUV444P10 = libench::ImageFormat(10, libench::ImageComponents::YUV, true, {1, 1, 1, 1}, {1, 1, 1, 1});
+libench::ImageFormat libench::ImageFormat::YUV420P12 = libench::ImageFormat(12, libench::ImageComponents::YUV, true, {1, 2, 2, 1}, {1, 2, 2, 1});
+libench::ImageFormat libench::ImageFormat::YUV422P12 = libench::ImageFormat(12, libench::ImageComponents::YUV, true, {1, 2, 2, 1}, {1, 1, 1, 1});
+libench::ImageFormat libench::ImageFormat::YUV444P12 = libench::ImageFormat(12, libench::ImageComponents::YUV, true, {1, 1, 1, 1}, {1, 1, 1, 1});
+
+libench::CodestreamContext libench::Encoder::encodeImage(const ImageContext &image) {
+  if (image.format == libench::ImageFormat::RGB8) {
+    return this->encodeRGB8(image);
+  } else if (image.format == libench::ImageFormat::RGBA8) {
+    return this->encodeRGBA8(image);
+  } else if (image.format.comps == libench::ImageComponents::YUV) {
+    return this->encodeYUV(image);
+  }
+
+  throw std::runtime_error("Unsupported number of components");
+}
+
+libench::ImageContext libench::Decoder::decodeImage(const CodestreamContext& cs, const ImageFormat& format) {
+  if (format == libench::ImageFormat::RGB8) {
+    return this->decodeRGB8(cs);
+  } else if (format == libench::ImageFormat::RGBA8) {
+    return this->decodeRGBA8(cs);
+  } else if (format.comps == libench::ImageComponents::YUV) {
+    return this->decodeYUV(cs);
+  }
+
+  throw std::runtime_error("Unsupported number of components");
+}
+
+/*
+ * OutputBuffer
+ */
+
+libench::OutputBuffer::~OutputBuffer() {
+  free_pages(this->data_, this->capacity_, this->pages_);
+}
+
+void libench::OutputBuffer::reserve(size_t capacity) {
+  if (capacity <= this->capacity_)
+    return;
+
+  uint8_t* data;
+
+  if (this->pages_ == PageSize::DEFAULT) {
+    data = (uint8_t*)realloc(this->data_, capacity);
+  } else {
+    /* mappings cannot be grown in place */
+    data = (uint8_t*)allocate_pages(capacity, this->pages_);
+    if (data && this->data_) {
+      memcpy(data, this->data_, this->size_);
+      free_pages(this->data_, this->capacity_, this->pages_);
+    }
+  }
+
+  if (!data)
+    throw std::runtime_error("Cannot allocate memory");
+
+  this->data_ = data;
+  this->capacity_ = capacity;
+}
+
+void libench::OutputBuffer::resize(size_t size) {
+  this->reserve(size);
+  this->size_ = size;
+}
+
+void libench::OutputBuffer::append(const uint8_t* data, size_t size) {
+  if (this->size_ + size > this->capacity_)
+    this->reserve(std::max(this->size_ + size, 2 * this->capacity_));
+
+  memcpy(this->data_ + this->size_, data, size);
+  this->size_ += size;
+}
+
+/*
+ * Default caller-owned buffer implementations
+ */
+
+libench::CodestreamContext libench::Encoder::encodeInto(const ImageContext &image, OutputBuffer& out) {
+  CodestreamContext cs = this->encodeImage(image);
+
+  out.clear();
+  out.append(cs.codestream, cs.size);
+
+  cs.codestream = out.data();
+
+  return cs;
+}
+
+static void check_destination(const libench::ImageContext& decoded, const libench::ImageContext& image) {
+  if (decoded.width != image.width || decoded.height != image.height
+      || decoded.format.num_planes() != image.format.num_planes())
+    throw std::runtime_error("Decoded image does not match the destination image");
+
+  for (uint8_t i = 0; i < image.format.num_planes(); i++) {
+    if (decoded.plane_size(i) != image.plane_size(i))
+      throw std::runtime_error("Decoded image does not match the destination image");
+  }
+}
+
+void libench::Decoder::decodeInto(const CodestreamContext& cs, ImageContext& image) {
+  ImageContext decoded = this->decodeImage(cs, image.format);
+
+  check_destination(decoded, image);
+
+  for (uint8_t i = 0; i < image.format.num_planes(); i++)
+    memcpy(image.planes8[i], decoded.planes8[i], image.plane_size(i));
+}
@@ -2,15 +2,25 @@
 #define LIBENCH_CODEC_H
 
 #include <stddef.h>
+#include <cstdlib>
+#include <cstring>
 #include <cstdint>
 #include <stdexcept>
 #include <array>
+#include <string>
 extern "C" {
 #include "md5.h"
 }
+#include "page_memory.h"
 
 namespace libench {
 
+/*
+ * The state, if any, is out-of-band data that the decoder needs in addition to
+ * the codestream, e.g. codec extradata. It consists of state_size bytes that
+ * are self-contained, so that a codestream and its state can be persisted and
+ * decoded by another process.
+ */
 struct CodestreamContext {
   uint8_t* codestream;
   size_t size;
@@ -67,7 +77,12 @@ struct ImageFormat {
 
   static ImageFormat RGBA8;
   static ImageFormat RGB8;
+  static ImageFormat YUV420P10;
   static ImageFormat YUV422P10;
+  static ImageFormat YUV444P10;
+  static ImageFormat YUV420P12;
+  static ImageFormat YUV422P12;
+  static ImageFormat YUV444P12;
 };
 
 
@@ -91,12 +106,10 @@ struct ImageContext {
     return this->format.bit_depth > 8;
   }
 
+  /* sizes are computed in 64-bit arithmetic since gigapixel images exceed 4 GB */
+
   size_t plane_size(int i) const {
-    if (this->format.is_planar) {
-      return this->width * this->height * this->component_size() / this->format.x_sub_factor[i] / this->format.y_sub_factor[i];
-    } else {
-      return this->width * this->height * this->component_size() * this->format.comps.num_comps / this->format.x_sub_factor[i] / this->format.y_sub_factor[i];
-    }
+    return this->line_size(i) * this->plane_height(i);
   }
 
   uint32_t plane_height(int i) const {
@@ -104,20 +117,23 @@ struct ImageContext {
   }
 
 
-  uint32_t line_size(int i) const {
+  size_t line_size(int i) const {
     if (this->format.is_planar) {
-      return this->width * this->component_size() / this->format.x_sub_factor[i];
+      return (size_t) (this->width / this->format.x_sub_factor[i]) * this->component_size();
     } else {
-      return this->width * this->component_size() * this->format.comps.num_comps / this->format.x_sub_factor[i];
+      return (size_t) (this->width / this->format.x_sub_factor[i]) * this->component_size() * this->format.comps.num_comps;
     }
   }
 
-  size_t total_bits() const {
-    size_t total = 0;
+  uint64_t total_bits() const {
+    uint64_t total = 0;
+
+    /* each plane of a planar image holds a single component */
+    uint8_t plane_comps = this->format.is_planar ? 1 : this->format.comps.num_comps;
 
     for(uint8_t i = 0; i < this->format.num_planes(); i++) {
-      total += (this->width / this->format.x_sub_factor[i]) * (this->height / this->format.y_sub_factor[i])
-               * this->format.comps.num_comps * this->format.bit_depth;
+      total += (uint64_t) (this->width / this->format.x_sub_factor[i]) * (this->height / this->format.y_sub_factor[i])
+               * plane_comps * this->format.bit_depth;
     }
 
     return total;
@@ -136,6 +152,51 @@ struct ImageContext {
   }
 };
 
+/*
+ * Caller-owned codestream buffer. It only grows, so that a buffer reused
+ * across calls stops allocating once it has reached the largest codestream.
+ */
+class OutputBuffer {
+ public:
+  OutputBuffer() : data_(NULL), size_(0), capacity_(0), pages_(PageSize::DEFAULT) {}
+
+  /* backs the buffer with the specified pages instead of malloc */
+  explicit OutputBuffer(PageSize pages) : data_(NULL), size_(0), capacity_(0), pages_(pages) {}
+
+  ~OutputBuffer();
+
+  OutputBuffer(const OutputBuffer&) = delete;
+  OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+  uint8_t* data() const { return this->data_; }
+
+  size_t size() const { return this->size_; }
+
+  size_t capacity() const { return this->capacity_; }
+
+  void clear() { this->size_ = 0; }
+
+  void reserve(size_t capacity);
+
+  /* the contents are preserved up to the smaller of the old and new sizes */
+  void resize(size_t size);
+
+  void append(const uint8_t* data, size_t size);
+
+ private:
+  uint8_t* data_;
+  size_t size_;
+  size_t capacity_;
+  PageSize pages_;
+};
+
+/*
+ * Unless stated otherwise, the codestream returned by an encoder, and the
+ * planes of the image returned by a decoder, are owned by the encoder or decoder
+ * and remain valid until its next call. encodeInto() and decodeInto() instead
+ * write into memory owned by the caller.
+ */
+
 class Encoder {
  public:
   virtual CodestreamContext encodeRGB8(const ImageContext &image) {
@@ -150,6 +211,35 @@ class Encoder {
     throw std::runtime_error("Not yet implemented");
   }
 
+  /* dispatches to the encode method that matches the image format */
+  CodestreamContext encodeImage(const ImageContext &image);
+
+  /*
+   * writes the codestream into out, replacing its contents; the returned
+   * codestream points into out while its state, if any, is owned by the encoder.
+   * The default implementation copies the output of encodeImage().
+   */
+  virtual CodestreamContext encodeInto(const ImageContext &image, OutputBuffer& out);
+
+  /*
+   * Out-of-core mode: subsequent encodes stream the image and write the
+   * codestream to the file at path instead of memory, in which case the
+   * returned codestream is NULL and its size is the number of bytes written.
+   * Returns false if the codec does not support it.
+   */
+  virtual bool setOutputFile(const std::string& path) {
+    return false;
+  }
+
+  /*
+   * implementation used by the codec library, where it is built with several,
+   * e.g. aom or svt for AVIF, or library that implements the decoder, where a
+   * codec pairs several, e.g. libpng or spng for png_fpnge; empty otherwise
+   */
+  virtual std::string backend() const {
+    return "";
+  }
+
   virtual ~Encoder() {}
 };
 
@@ -167,6 +257,21 @@ class Decoder {
     throw std::runtime_error("Not yet implemented");
   }
 
+  /* dispatches to the decode method that matches the expected image format */
+  ImageContext decodeImage(const CodestreamContext& cs, const ImageFormat& format);
+
+  /*
+   * decodes into the planes of image, which the caller has allocated according
+   * to its width, height and format; throws if the codestream does not match.
+   * The default implementation copies the output of decodeImage().
+   */
+  virtual void decodeInto(const CodestreamContext& cs, ImageContext& image);
+
+  /* see Encoder::backend() */
+  virtual std::string backend() const {
+    return "";
+  }
+
   virtual ~Decoder() {}
 };
 
@@ -0,0 +1,274 @@
+#include "codec_factory.h"
+#include <stdexcept>
+#include "avif_codec.h"
+#include "bands_codec.h"
+#include "ffmpeg_codec.h"
+#ifdef LIBENCH_HAS_FPNGE
+#include "fpnge_codec.h"
+#endif
+#ifdef LIBENCH_HAS_CHARLS
+#include "jpegls_codec.h"
+#endif
+#include "jxl_codec.h"
+#include "kduht_codec.h"
+#ifdef LIBENCH_HAS_LIBPNG
+#include "libpng_codec.h"
+#endif
+#include "ojph_codec.h"
+#include "png_codec.h"
+#include "qoi_codec.h"
+#ifdef LIBENCH_HAS_SPNG
+#include "spng_codec.h"
+#endif
+#include "webp_codec.h"
+
+libench::CodecOptions libench::parse_codec_options(const std::vector<std::string>& args) {
+  CodecOptions opts;
+
+  for (const auto& arg : args) {
+    size_t sep = arg.find('=');
+
+    if (sep == std::string::npos) {
+      throw std::runtime_error("Codec option must be of the form key=value: " + arg);
+    }
+
+    opts[arg.substr(0, sep)] = arg.substr(sep + 1);
+  }
+
+  return opts;
+}
+
+std::string libench::get_option(const CodecOptions& opts, const std::string& key, const std::string& default_value) {
+  auto it = opts.find(key);
+
+  return it == opts.end() ? default_value : it->second;
+}
+
+std::string libench::format_codec_options(const CodecOptions& opts) {
+  std::string s;
+
+  for (const auto& opt : opts) {
+    if (! s.empty())
+      s += ",";
+    s += opt.first + "=" + opt.second;
+  }
+
+  return s;
+}
+
+/* sizes are specified as <width>x<height> */
+static ojph::size parse_size(const std::string& s) {
+  size_t sep = s.find('x');
+
+  if (sep == std::string::npos) {
+    throw std::runtime_error("Size must be of the form <width>x<height>: " + s);
+  }
+
+  return ojph::size(std::stoi(s.substr(0, sep)), std::stoi(s.substr(sep + 1)));
+}
+
+void libench::make_codec(const std::string& name, const CodecOptions& opts,
+                         std::unique_ptr<Encoder>& encoder, std::unique_ptr<Decoder>& decoder) {
+  if (name.compare(0, 5, "bands") == 0 && name.find(':') != std::string::npos) {
+    /* bands<K>:<codec> */
+
+    size_t sep = name.find(':');
+    int band_count = std::stoi(name.substr(5, sep - 5));
+
+    if (band_count < 1) {
+      throw std::runtime_error("Band count must be at least 1");
+    }
+
+    std::vector<std::unique_ptr<Encoder>> band_encoders(band_count);
+    std::vector<std::unique_ptr<Decoder>> band_decoders(band_count);
+
+    for (int i = 0; i < band_count; i++) {
+      make_codec(name.substr(sep + 1), opts, band_encoders[i], band_decoders[i]);
+    }
+
+    encoder.reset(new BandsEncoder(std::move(band_encoders)));
+    decoder.reset(new BandsDecoder(std::move(band_decoders)));
+  } else if (name == "j2k_ht_ojph" || name == "j2k_ht_ojph_imf") {
+    bool is_imf = name == "j2k_ht_ojph_imf";
+
+    ojph::ui32 num_decomps = std::stoi(get_option(opts, "levels", "5"));
+    ojph::size block_dims = parse_size(get_option(opts, "block", is_imf ? "32x32" : "64x64"));
+    std::string precinct_opt = get_option(opts, "precincts", is_imf ? "imf" : "");
+
+    std::vector<ojph::size> precincts;
+    if (precinct_opt == "imf") {
+      precincts = OJPHEncoder::imfPrecincts(num_decomps);
+    } else if (! precinct_opt.empty()) {
+      precincts.push_back(parse_size(precinct_opt));
+    }
+
+    encoder.reset(new OJPHEncoder(num_decomps, block_dims, precincts, is_imf ? "CPRL" : ""));
+    decoder.reset(new OJPHDecoder());
+  } else if (name == "avif") {
+    int threads = std::stoi(get_option(opts, "threads", "1"));
+    std::string tiles = get_option(opts, "tiles", "auto");
+    ojph::size tile_counts = tiles == "auto" ? ojph::size(0, 0) : parse_size(tiles);
+
+    encoder.reset(new AVIFEncoder(get_option(opts, "encoder", ""), threads, tile_counts.w, tile_counts.h));
+    decoder.reset(new AVIFDecoder(get_option(opts, "decoder", ""), threads));
+  } else if (name == "qoi") {
+    encoder.reset(new QOIEncoder());
+    decoder.reset(new QOIDecoder());
+  } else if (name == "jxl_e3") {
+    encoder.reset(new JXLEncoder<3>());
+    decoder.reset(new JXLDecoder());
+  } else if (name == "jxl_e2") {
+    encoder.reset(new JXLEncoder<2>());
+    decoder.reset(new JXLDecoder());
+  } else if (name == "jxl") {
+    encoder.reset(new JXLEncoder<1>());
+    decoder.reset(new JXLDecoder());
+  } else if (name == "j2k_ht_kdu") {
+    encoder.reset(new KDUEncoder(true));
+    decoder.reset(new KDUDecoder());
+  } else if (name == "j2k_1_kdu") {
+    encoder.reset(new KDUEncoder(false));
+    decoder.reset(new KDUDecoder());
+  } else if (name == "png") {
+    encoder.reset(new PNGEncoder());
+    decoder.reset(new PNGDecoder());
+  } else if (name == "png_libpng") {
+#ifdef LIBENCH_HAS_LIBPNG
+    int level = std::stoi(get_option(opts, "level", "6"));
+
+    encoder.reset(new LibPNGEncoder(level));
+    decoder.reset(new LibPNGDecoder());
+#else
+    throw std::runtime_error("libench was built without ext/libpng and ext/zlib-ng");
+#endif
+  } else if (name == "png_spng") {
+#ifdef LIBENCH_HAS_SPNG
+    int level = std::stoi(get_option(opts, "level", "6"));
+
+    encoder.reset(new SPNGEncoder(level));
+    decoder.reset(new SPNGDecoder());
+#else
+    throw std::runtime_error("libench was built without ext/libspng and ext/zlib-ng");
+#endif
+  } else if (name == "png_fpnge") {
+#ifdef LIBENCH_HAS_FPNGE
+    int level = std::stoi(get_option(opts, "level", "4"));
+
+    encoder.reset(new FPNGEEncoder(level));
+    /* decoded by a library as fast as fpnge's own class, rather than lodepng */
+#if defined(LIBENCH_HAS_LIBPNG)
+    decoder.reset(new LibPNGDecoder());
+#else
+    decoder.reset(new SPNGDecoder());
+#endif
+#else
+    throw std::runtime_error("libench was built without ext/fpnge");
+#endif
+  } else if (name == "ffv1" || name == "ffvhuff" || name == "huffyuv" || name == "magicyuv" || name == "utvideo") {
+    const AVCodec* codec = avcodec_find_encoder_by_name(name.c_str());
+
+    if (!codec)
+      throw std::runtime_error("libench was built without the FFmpeg " + name + " codec");
+
+    int threads = std::stoi(get_option(opts, "threads", "1"));
+    int slices = std::stoi(get_option(opts, "slices", "0"));
+
+    encoder.reset(new FFmpegEncoder(codec->id, threads, slices));
+    decoder.reset(new FFmpegDecoder(codec->id, threads));
+  } else if (name == "jpegls") {
+#ifdef LIBENCH_HAS_CHARLS
+    charls::interleave_mode interleave = JPEGLSEncoder::parseInterleaveMode(get_option(opts, "interleave", "line"));
+
+    encoder.reset(new JPEGLSEncoder(interleave));
+    decoder.reset(new JPEGLSDecoder());
+#else
+    throw std::runtime_error("libench was built without ext/charls");
+#endif
+  } else if (name == "webp") {
+    encoder.reset(new WEBPEncoder());
+    decoder.reset(new WEBPDecoder());
+  } else {
+    throw std::runtime_error("Unknown encoder");
+  }
+}
+
+/* FFmpeg codecs, each enabled in the FFmpeg configure step of CMakeLists.txt */
+static const char* FFMPEG_CODEC_NAMES[] = {"ffv1", "ffvhuff", "huffyuv", "magicyuv", "utvideo"};
+
+std::vector<std::string> libench::codec_names() {
+  std::vector<std::string> names = {"j2k_ht_ojph", "j2k_ht_ojph_imf", "avif", "qoi", "jxl", "jxl_e2", "jxl_e3",
+                                    "j2k_ht_kdu", "j2k_1_kdu", "png"};
+
+#ifdef LIBENCH_HAS_LIBPNG
+  names.push_back("png_libpng");
+#endif
+#ifdef LIBENCH_HAS_SPNG
+  names.push_back("png_spng");
+#endif
+#ifdef LIBENCH_HAS_FPNGE
+  names.push_back("png_fpnge");
+#endif
+
+  for (const char* name : FFMPEG_CODEC_NAMES) {
+    if (avcodec_find_encoder_by_name(name) && avcodec_find_decoder_by_name(name))
+      names.push_back(name);
+  }
+
+#ifdef LIBENCH_HAS_CHARLS
+  names.push_back("jpegls");
+#endif
+
+  names.push_back("webp");
+
+  return names;
+}
+
+bool libench::codec_accepts_format(const std::string& name, const ImageFormat& format) {
+  size_t sep = name.find(':');
+  bool is_yuv = format.comps == ImageComponents::YUV;
+
+  if (name.compare(0, 5, "bands") == 0 && sep != std::string::npos) {
+    return codec_accepts_format(name.substr(sep + 1), format);
+  } else if (name == "j2k_ht_ojph_imf") {
+    return is_yuv;
+  } else if (name == "jxl" || name == "jxl_e2" || name == "jxl_e3" || name == "qoi" || name == "png"
+             || name == "png_libpng" || name == "png_spng" || name == "png_fpnge" || name == "huffyuv"
+             || name == "magicyuv" || name == "utvideo" || name == "webp") {
+    return ! is_yuv;
+  }
+
+  return true;
+}
+
+std::string libench::codec_library(const std::string& name) {
+  size_t sep = name.find(':');
+
+  if (name.compare(0, 5, "bands") == 0 && sep != std::string::npos) {
+    return codec_library(name.substr(sep + 1));
+  } else if (name == "j2k_ht_ojph" || name == "j2k_ht_ojph_imf") {
+    return "ext/OpenJPH";
+  } else if (name == "avif") {
+    return "ext/libavif";
+  } else if (name == "qoi") {
+    return "ext/qoi";
+  } else if (name == "jxl" || name == "jxl_e2" || name == "jxl_e3") {
+    return "ext/libjxl";
+  } else if (name == "png") {
+    return "ext/lodepng";
+  } else if (name == "png_libpng") {
+    return "ext/libpng";
+  } else if (name == "png_spng") {
+    return "ext/libspng";
+  } else if (name == "png_fpnge") {
+    return "ext/fpnge";
+  } else if (name == "ffv1" || name == "ffvhuff" || name == "huffyuv" || name == "magicyuv" || name == "utvideo") {
+    return "ext/ffmpeg";
+  } else if (name == "jpegls") {
+    return "ext/charls";
+  } else if (name == "webp") {
+    return "ext/libwebp";
+  }
+
+  /* e.g. the Kakadu SDK */
+  return "";
+}
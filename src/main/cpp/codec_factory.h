@@ -0,0 +1,46 @@
+#ifndef LIBENCH_CODEC_FACTORY_H
+#define LIBENCH_CODEC_FACTORY_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "codec.h"
+
+namespace libench {
+
+typedef std::map<std::string, std::string> CodecOptions;
+
+/* codec options are specified as key=value */
+CodecOptions parse_codec_options(const std::vector<std::string>& args);
+
+std::string get_option(const CodecOptions& opts, const std::string& key, const std::string& default_value);
+
+/* canonical key=value,... form of the options */
+std::string format_codec_options(const CodecOptions& opts);
+
+/* creates the encoder and decoder registered under name, e.g. "jxl" or "bands4:png" */
+void make_codec(const std::string& name, const CodecOptions& opts,
+                std::unique_ptr<Encoder>& encoder, std::unique_ptr<Decoder>& decoder);
+
+/*
+ * names of the codecs that libench was built with, excluding the bands<K>:
+ * prefix; codecs whose optional dependencies are missing are not listed
+ */
+std::vector<std::string> codec_names();
+
+/*
+ * whether the encoder registered under name accepts images of the format, as
+ * listed for each codec in make_page.py
+ */
+bool codec_accepts_format(const std::string& name, const ImageFormat& format);
+
+/*
+ * path of the submodule that implements the codec registered under name, e.g.
+ * ext/libjxl, or the empty string if the codec is not built from a submodule
+ */
+std::string codec_library(const std::string& name);
+
+}  // namespace libench
+
+#endif
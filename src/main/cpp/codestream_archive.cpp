@@ -0,0 +1,217 @@
+#include "codestream_archive.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static const char ARCHIVE_MAGIC[4] = {'L', 'B', 'C', 'A'};
+static const uint32_t ARCHIVE_VERSION = 1;
+static const size_t ARCHIVE_HEADER_SIZE = 32;
+static const size_t ARCHIVE_ALIGNMENT = 64;
+
+/*
+ * Index record
+ *
+ *   image hash (16 bytes) | width (u32) | height (u32)
+ *   bit depth (u8) | component count (u8) | planar (u8) | x subsampling (4 x u8) | y subsampling (4 x u8)
+ *   codestream offset (u64) | codestream size (u64) | state offset (u64) | state size (u64)
+ *   codec (u16 length + chars) | options (u16 length + chars) | components name (u16 length + chars)
+ */
+
+class IndexWriter {
+ public:
+  template <typename T>
+  void put(const T& value) {
+    const uint8_t* p = (const uint8_t*)&value;
+    this->buf_.insert(this->buf_.end(), p, p + sizeof(T));
+  }
+
+  void put_bytes(const uint8_t* p, size_t size) {
+    this->buf_.insert(this->buf_.end(), p, p + size);
+  }
+
+  void put_string(const std::string& s) {
+    if (s.size() > UINT16_MAX)
+      throw std::runtime_error("Archive string too long");
+    this->put<uint16_t>(s.size());
+    this->put_bytes((const uint8_t*)s.data(), s.size());
+  }
+
+  const std::vector<uint8_t>& buffer() const { return this->buf_; }
+
+ private:
+  std::vector<uint8_t> buf_;
+};
+
+class IndexReader {
+ public:
+  IndexReader(const uint8_t* data, size_t size) : data_(data), size_(size), pos_(0) {}
+
+  template <typename T>
+  T get() {
+    T value;
+    this->get_bytes((uint8_t*)&value, sizeof(T));
+    return value;
+  }
+
+  void get_bytes(uint8_t* p, size_t size) {
+    if (this->pos_ + size > this->size_)
+      throw std::runtime_error("Truncated archive index");
+    memcpy(p, this->data_ + this->pos_, size);
+    this->pos_ += size;
+  }
+
+  std::string get_string() {
+    uint16_t size = this->get<uint16_t>();
+    if (this->pos_ + size > this->size_)
+      throw std::runtime_error("Truncated archive index");
+    std::string s((const char*)this->data_ + this->pos_, size);
+    this->pos_ += size;
+    return s;
+  }
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  size_t pos_;
+};
+
+bool libench::ArchiveKey::operator==(const ArchiveKey& other) const {
+  return memcmp(this->image_hash, other.image_hash, sizeof(this->image_hash)) == 0 &&
+         this->codec == other.codec && this->options == other.options;
+}
+
+libench::CodestreamArchive::CodestreamArchive() {}
+
+void libench::CodestreamArchive::open(const std::string& path) {
+  this->entries_.clear();
+  this->file_.open(path);
+
+  const uint8_t* data = this->file_.data();
+  size_t size = this->file_.size();
+
+  if (size < ARCHIVE_HEADER_SIZE || memcmp(data, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)))
+    throw std::runtime_error("Not a codestream archive: " + path);
+
+  IndexReader header(data + sizeof(ARCHIVE_MAGIC), ARCHIVE_HEADER_SIZE - sizeof(ARCHIVE_MAGIC));
+
+  if (header.get<uint32_t>() != ARCHIVE_VERSION)
+    throw std::runtime_error("Unsupported codestream archive version: " + path);
+
+  uint64_t entry_count = header.get<uint64_t>();
+  uint64_t index_offset = header.get<uint64_t>();
+  uint64_t index_size = header.get<uint64_t>();
+
+  if (index_offset > size || index_size > size - index_offset)
+    throw std::runtime_error("Truncated archive index");
+
+  IndexReader index(data + index_offset, index_size);
+
+  for (uint64_t i = 0; i < entry_count; i++) {
+    ArchiveEntry entry;
+
+    index.get_bytes(entry.key.image_hash, sizeof(entry.key.image_hash));
+    entry.width = index.get<uint32_t>();
+    entry.height = index.get<uint32_t>();
+    entry.format.bit_depth = index.get<uint8_t>();
+    uint8_t num_comps = index.get<uint8_t>();
+    entry.format.is_planar = index.get<uint8_t>();
+    index.get_bytes(entry.format.x_sub_factor.data(), entry.format.x_sub_factor.size());
+    index.get_bytes(entry.format.y_sub_factor.data(), entry.format.y_sub_factor.size());
+
+    uint64_t codestream_offset = index.get<uint64_t>();
+    uint64_t codestream_size = index.get<uint64_t>();
+    uint64_t state_offset = index.get<uint64_t>();
+    uint64_t state_size = index.get<uint64_t>();
+
+    entry.key.codec = index.get_string();
+    entry.key.options = index.get_string();
+    entry.format.comps = ImageComponents(num_comps, index.get_string());
+
+    if (codestream_offset > size || codestream_size > size - codestream_offset ||
+        state_offset > size || state_size > size - state_offset)
+      throw std::runtime_error("Archive entry out of bounds");
+
+    /* the decoders do not modify the codestream */
+    entry.cs.codestream = const_cast<uint8_t*>(data) + codestream_offset;
+    entry.cs.size = codestream_size;
+    entry.cs.state = state_size ? const_cast<uint8_t*>(data) + state_offset : NULL;
+    entry.cs.state_size = state_size;
+
+    this->entries_.push_back(entry);
+  }
+}
+
+const libench::ArchiveEntry* libench::CodestreamArchive::find(const ArchiveKey& key) const {
+  for (const auto& entry : this->entries_) {
+    if (entry.key == key)
+      return &entry;
+  }
+
+  return NULL;
+}
+
+void libench::CodestreamArchive::write(const std::string& path, const std::vector<ArchiveEntry>& entries) {
+  /* write to a temporary file so that existing mappings of path remain valid */
+
+  std::string tmp_path = path + ".tmp";
+
+  std::ofstream f(tmp_path, std::ios::binary | std::ios::trunc);
+  if (!f)
+    throw std::runtime_error("Cannot create archive: " + tmp_path);
+
+  uint64_t offset = ARCHIVE_HEADER_SIZE;
+  static const uint8_t padding[ARCHIVE_ALIGNMENT] = {0};
+
+  auto put_blob = [&](const void* data, size_t size) -> uint64_t {
+    uint64_t aligned = (offset + ARCHIVE_ALIGNMENT - 1) / ARCHIVE_ALIGNMENT * ARCHIVE_ALIGNMENT;
+    f.write((const char*)padding, aligned - offset);
+    f.write((const char*)data, size);
+    offset = aligned + size;
+    return aligned;
+  };
+
+  f.write((const char*)padding, ARCHIVE_HEADER_SIZE);
+
+  IndexWriter index;
+
+  for (const auto& entry : entries) {
+    uint64_t codestream_offset = put_blob(entry.cs.codestream, entry.cs.size);
+    uint64_t state_offset = put_blob(entry.cs.state, entry.cs.state_size);
+
+    index.put_bytes(entry.key.image_hash, sizeof(entry.key.image_hash));
+    index.put<uint32_t>(entry.width);
+    index.put<uint32_t>(entry.height);
+    index.put<uint8_t>(entry.format.bit_depth);
+    index.put<uint8_t>(entry.format.comps.num_comps);
+    index.put<uint8_t>(entry.format.is_planar);
+    index.put_bytes(entry.format.x_sub_factor.data(), entry.format.x_sub_factor.size());
+    index.put_bytes(entry.format.y_sub_factor.data(), entry.format.y_sub_factor.size());
+    index.put<uint64_t>(codestream_offset);
+    index.put<uint64_t>(entry.cs.size);
+    index.put<uint64_t>(state_offset);
+    index.put<uint64_t>(entry.cs.state_size);
+    index.put_string(entry.key.codec);
+    index.put_string(entry.key.options);
+    index.put_string(entry.format.comps.name);
+  }
+
+  uint64_t index_offset = put_blob(index.buffer().data(), index.buffer().size());
+
+  IndexWriter header;
+  header.put_bytes((const uint8_t*)ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+  header.put<uint32_t>(ARCHIVE_VERSION);
+  header.put<uint64_t>(entries.size());
+  header.put<uint64_t>(index_offset);
+  header.put<uint64_t>(index.buffer().size());
+
+  f.seekp(0);
+  f.write((const char*)header.buffer().data(), header.buffer().size());
+  f.close();
+
+  if (!f)
+    throw std::runtime_error("Cannot write archive: " + tmp_path);
+
+  if (std::rename(tmp_path.c_str(), path.c_str()))
+    throw std::runtime_error("Cannot replace archive: " + path);
+}
@@ -0,0 +1,59 @@
+#ifndef LIBENCH_CODESTREAM_ARCHIVE_H
+#define LIBENCH_CODESTREAM_ARCHIVE_H
+
+#include <string>
+#include <vector>
+#include "codec.h"
+#include "mapped_file.h"
+
+namespace libench {
+
+/*
+ * Single-file archive of codestreams, keyed by source image hash, codec name
+ * and codec options. The archive is memory-mapped when read, and the
+ * codestreams and states of its entries point directly into the mapping.
+ *
+ *   header: "LBCA" | version (u32) | entry count (u64) | index offset (u64) | index size (u64)
+ *   data:   codestream and state blobs, each aligned on ARCHIVE_ALIGNMENT bytes
+ *   index:  one record per entry, see codestream_archive.cpp
+ */
+
+struct ArchiveKey {
+  uint8_t image_hash[MD5_BLOCK_SIZE];
+  std::string codec;
+  std::string options;
+
+  bool operator==(const ArchiveKey& other) const;
+};
+
+struct ArchiveEntry {
+  ArchiveKey key;
+  uint32_t width;
+  uint32_t height;
+  ImageFormat format;
+  CodestreamContext cs;
+};
+
+class CodestreamArchive {
+ public:
+  CodestreamArchive();
+
+  /* maps the archive at path */
+  void open(const std::string& path);
+
+  /* returns NULL if there is no entry for the key */
+  const ArchiveEntry* find(const ArchiveKey& key) const;
+
+  const std::vector<ArchiveEntry>& entries() const { return this->entries_; }
+
+  /* writes the entries to a new archive at path, replacing any existing file */
+  static void write(const std::string& path, const std::vector<ArchiveEntry>& entries);
+
+ private:
+  MappedFile file_;
+  std::vector<ArchiveEntry> entries_;
+};
+
+}  // namespace libench
+
+#endif
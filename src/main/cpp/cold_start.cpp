@@ -0,0 +1,295 @@
+#include "cold_start.h"
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "image_io.h"
+#include "test_context.h"
+
+typedef std::chrono::steady_clock::duration Duration;
+
+/*
+ * child
+ */
+
+void run_cold_start_child(std::ostream& os, const std::string& codec, const libench::CodecOptions& codec_options,
+                          const std::string& filepath, int repetitions,
+                          std::chrono::steady_clock::time_point start,
+                          std::chrono::steady_clock::time_point main_entry) {
+  ColdStartSample sample;
+
+  sample.startup_time = main_entry - start;
+
+  libench::ImageContext image = load_image(filepath);
+
+  uint8_t image_hash[MD5_BLOCK_SIZE];
+
+  image.md5(image_hash);
+
+  auto verify = [&](const libench::ImageContext& decoded) {
+    uint8_t decoded_hash[MD5_BLOCK_SIZE];
+
+    decoded.md5(decoded_hash);
+
+    if (memcmp(decoded_hash, image_hash, MD5_BLOCK_SIZE))
+      throw std::runtime_error("Image does not match");
+  };
+
+  /* construction */
+
+  std::unique_ptr<libench::Encoder> encoder;
+  std::unique_ptr<libench::Decoder> decoder;
+
+  auto construction_start = std::chrono::steady_clock::now();
+
+  libench::make_codec(codec, codec_options, encoder, decoder);
+
+  sample.construction_time = std::chrono::steady_clock::now() - construction_start;
+
+  /* first calls */
+
+  auto encode_start = std::chrono::steady_clock::now();
+
+  libench::CodestreamContext cs = encoder->encodeImage(image);
+
+  auto decode_start = std::chrono::steady_clock::now();
+
+  libench::ImageContext decoded = decoder->decodeImage(cs, image.format);
+
+  auto decode_end = std::chrono::steady_clock::now();
+
+  sample.first_encode_time = decode_start - encode_start;
+  sample.first_decode_time = decode_end - decode_start;
+
+  verify(decoded);
+
+  /* steady state */
+
+  sample.steady_encode_time = Duration::zero();
+  sample.steady_decode_time = Duration::zero();
+
+  for (int i = 0; i < repetitions; i++) {
+    encode_start = std::chrono::steady_clock::now();
+
+    cs = encoder->encodeImage(image);
+
+    decode_start = std::chrono::steady_clock::now();
+
+    decoded = decoder->decodeImage(cs, image.format);
+
+    decode_end = std::chrono::steady_clock::now();
+
+    sample.steady_encode_time += decode_start - encode_start;
+    sample.steady_decode_time += decode_end - decode_start;
+
+    verify(decoded);
+  }
+
+  if (repetitions > 0) {
+    sample.steady_encode_time /= repetitions;
+    sample.steady_decode_time /= repetitions;
+  }
+
+  free_image(image);
+
+  /* internal format read by run_child(): the durations in nanoseconds */
+
+  for (const auto& t : {sample.startup_time, sample.construction_time, sample.first_encode_time,
+                        sample.first_decode_time, sample.steady_encode_time, sample.steady_decode_time}) {
+    os << std::chrono::duration_cast<std::chrono::nanoseconds>(t).count() << " ";
+  }
+
+  os << std::endl;
+}
+
+/*
+ * parent
+ */
+
+/* regular files mapped by the process, i.e. the executable and its shared libraries */
+static std::vector<std::string> mapped_files() {
+  std::ifstream maps("/proc/self/maps");
+  std::set<std::string> paths;
+  std::string line;
+
+  while (std::getline(maps, line)) {
+    size_t path_start = line.find('/');
+
+    if (path_start == std::string::npos || line.find(" (deleted)") != std::string::npos)
+      continue;
+
+    paths.insert(line.substr(path_start));
+  }
+
+  return std::vector<std::string>(paths.begin(), paths.end());
+}
+
+/*
+ * evicts the pages of the files from the page cache, except those mapped by a
+ * running process, e.g. the code of the parent itself, which does not run the
+ * codecs; returns the number of files for which the kernel accepted the advice
+ */
+static int drop_page_cache(const std::vector<std::string>& paths) {
+  int count = 0;
+
+  for (const auto& path : paths) {
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+      continue;
+
+    if (posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0)
+      count++;
+
+    close(fd);
+  }
+
+  return count;
+}
+
+static std::string executable_path() {
+  char path[4096];
+
+  ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+
+  if (len < 0)
+    throw std::runtime_error("Cannot determine the path of the executable");
+
+  return std::string(path, len);
+}
+
+static ColdStartSample run_child(const std::string& exe, const std::vector<std::string>& child_args) {
+  int fds[2];
+
+  if (pipe(fds))
+    throw std::runtime_error("Cannot create pipe");
+
+  std::vector<std::string> args = {exe};
+  args.insert(args.end(), child_args.begin(), child_args.end());
+  args.push_back("--cold-start-child");
+
+  auto start = std::chrono::steady_clock::now();
+
+  args.push_back(std::to_string(std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count()));
+
+  std::vector<char*> argv;
+  for (auto& arg : args)
+    argv.push_back(&arg[0]);
+  argv.push_back(NULL);
+
+  pid_t pid = fork();
+
+  if (pid < 0)
+    throw std::runtime_error("Cannot fork");
+
+  if (pid == 0) {
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+
+    execv(exe.c_str(), argv.data());
+
+    _exit(127);
+  }
+
+  close(fds[1]);
+
+  std::string output;
+  char buffer[256];
+  ssize_t n;
+
+  while ((n = read(fds[0], buffer, sizeof(buffer))) > 0)
+    output.append(buffer, n);
+
+  close(fds[0]);
+
+  int status;
+
+  if (waitpid(pid, &status, 0) < 0 || ! WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    throw std::runtime_error("Cold-start child process failed");
+
+  std::istringstream is(output);
+  int64_t ns[6];
+
+  for (auto& t : ns) {
+    if (! (is >> t))
+      throw std::runtime_error("Unexpected cold-start child output");
+  }
+
+  ColdStartSample sample;
+
+  sample.startup_time = std::chrono::nanoseconds(ns[0]);
+  sample.construction_time = std::chrono::nanoseconds(ns[1]);
+  sample.first_encode_time = std::chrono::nanoseconds(ns[2]);
+  sample.first_decode_time = std::chrono::nanoseconds(ns[3]);
+  sample.steady_encode_time = std::chrono::nanoseconds(ns[4]);
+  sample.steady_decode_time = std::chrono::nanoseconds(ns[5]);
+
+  return sample;
+}
+
+ColdStartReport run_cold_start(const ColdStartConfig& config) {
+  if (config.sample_count < 1)
+    throw std::runtime_error("At least one sample is required");
+
+  std::string exe = executable_path();
+  std::vector<std::string> files = mapped_files();
+
+  ColdStartReport report;
+
+  report.dropped_file_count = 0;
+
+  for (int i = 0; i < config.sample_count; i++) {
+    if (config.is_page_cache_dropped)
+      report.dropped_file_count = drop_page_cache(files);
+
+    report.samples.push_back(run_child(exe, config.child_args));
+  }
+
+  return report;
+}
+
+static void print_phase(std::ostream& os, const char* name, const std::vector<ColdStartSample>& samples,
+                        Duration ColdStartSample::*phase, bool is_last = false) {
+  double sum = 0;
+
+  os << "\"" << name << "Times\" : [";
+  for (const auto& s : samples) {
+    double t = std::chrono::duration<double>(s.*phase).count();
+
+    sum += t;
+    os << t << (&s != &samples.back() ? ", " : "");
+  }
+  os << "]," << std::endl;
+
+  os << "\"" << name << "Time\" : " << sum / samples.size() << (is_last ? "" : ",") << std::endl;
+}
+
+std::ostream& operator<<(std::ostream& os, const ColdStartReport& report) {
+  os << "{" << std::endl;
+
+  os << "\"samples\" : " << report.samples.size() << "," << std::endl;
+
+  os << "\"droppedFiles\" : " << report.dropped_file_count << "," << std::endl;
+
+  print_phase(os, "startup", report.samples, &ColdStartSample::startup_time);
+
+  print_phase(os, "construction", report.samples, &ColdStartSample::construction_time);
+
+  print_phase(os, "firstEncode", report.samples, &ColdStartSample::first_encode_time);
+
+  print_phase(os, "firstDecode", report.samples, &ColdStartSample::first_decode_time);
+
+  print_phase(os, "steadyEncode", report.samples, &ColdStartSample::steady_encode_time);
+
+  print_phase(os, "steadyDecode", report.samples, &ColdStartSample::steady_decode_time, true);
+
+  os << "}" << std::endl;
+
+  return os;
+}
@@ -0,0 +1,59 @@
+#ifndef LIBENCH_COLD_START_H
+#define LIBENCH_COLD_START_H
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "codec_factory.h"
+
+/* phases of a single fresh process, see run_cold_start() */
+struct ColdStartSample {
+  /* from before the fork to the entry of main(), i.e. exec, loading and static initialization */
+  std::chrono::steady_clock::duration startup_time;
+  /* creation of the encoder and decoder */
+  std::chrono::steady_clock::duration construction_time;
+  std::chrono::steady_clock::duration first_encode_time;
+  std::chrono::steady_clock::duration first_decode_time;
+  /* mean of the subsequent encodes and decodes */
+  std::chrono::steady_clock::duration steady_encode_time;
+  std::chrono::steady_clock::duration steady_decode_time;
+};
+
+struct ColdStartConfig {
+  /* arguments of the child processes, without the executable and --cold-start-child */
+  std::vector<std::string> child_args;
+  int sample_count;
+  /* drop the page cache of the executable and its libraries before each sample */
+  bool is_page_cache_dropped;
+
+  ColdStartConfig() : sample_count(5), is_page_cache_dropped(false) {}
+};
+
+struct ColdStartReport {
+  std::vector<ColdStartSample> samples;
+  /* number of files whose page cache was dropped before each sample */
+  int dropped_file_count;
+};
+
+/*
+ * Runs each sample in a fresh process, forked and exec'ed from the current
+ * executable with --cold-start-child, so that process startup, library
+ * initialization, codec construction and the first calls, which fill lazily
+ * built tables, are timed separately from the steady state.
+ */
+ColdStartReport run_cold_start(const ColdStartConfig& config);
+
+/*
+ * Measures a sample in the child process and writes it to os; start is the
+ * time at which the parent forked and main_entry the time at which main() was
+ * entered.
+ */
+void run_cold_start_child(std::ostream& os, const std::string& codec, const libench::CodecOptions& codec_options,
+                          const std::string& filepath, int repetitions,
+                          std::chrono::steady_clock::time_point start,
+                          std::chrono::steady_clock::time_point main_entry);
+
+std::ostream& operator<<(std::ostream& os, const ColdStartReport& report);
+
+#endif
@@ -0,0 +1,575 @@
+#include "ffmpeg_codec.h"
+#include <inttypes.h>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "trace.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+
+#include <libavutil/imgutils.h>
+#include <libavutil/opt.h>
+}
+
+/*
+ * Pixel formats
+ *
+ * Each codec codes an image format in a single pixel format, chosen among
+ * those its encoder accepts so that no information is lost.
+ */
+
+struct PixelFormatMapping {
+  const libench::ImageFormat* format;
+  AVPixelFormat pix_fmt;
+};
+
+static const std::vector<PixelFormatMapping>& pixel_formats(AVCodecID codec_id) {
+  static const std::vector<PixelFormatMapping> FFV1 = {
+      {&libench::ImageFormat::RGB8, AV_PIX_FMT_0RGB32},
+      {&libench::ImageFormat::RGBA8, AV_PIX_FMT_RGB32},
+      {&libench::ImageFormat::YUV420P10, AV_PIX_FMT_YUV420P10LE},
+      {&libench::ImageFormat::YUV422P10, AV_PIX_FMT_YUV422P10LE},
+      {&libench::ImageFormat::YUV444P10, AV_PIX_FMT_YUV444P10LE},
+      {&libench::ImageFormat::YUV420P12, AV_PIX_FMT_YUV420P12LE},
+      {&libench::ImageFormat::YUV422P12, AV_PIX_FMT_YUV422P12LE},
+      {&libench::ImageFormat::YUV444P12, AV_PIX_FMT_YUV444P12LE}};
+
+  static const std::vector<PixelFormatMapping> FFVHUFF = {
+      {&libench::ImageFormat::RGB8, AV_PIX_FMT_RGB24},
+      {&libench::ImageFormat::RGBA8, AV_PIX_FMT_RGB32},
+      {&libench::ImageFormat::YUV420P10, AV_PIX_FMT_YUV420P10LE},
+      {&libench::ImageFormat::YUV422P10, AV_PIX_FMT_YUV422P10LE},
+      {&libench::ImageFormat::YUV444P10, AV_PIX_FMT_YUV444P10LE},
+      {&libench::ImageFormat::YUV420P12, AV_PIX_FMT_YUV420P12LE},
+      {&libench::ImageFormat::YUV422P12, AV_PIX_FMT_YUV422P12LE},
+      {&libench::ImageFormat::YUV444P12, AV_PIX_FMT_YUV444P12LE}};
+
+  /* the HuffYUV, MagicYUV and UtVideo encoders only accept 8-bit samples */
+
+  static const std::vector<PixelFormatMapping> HUFFYUV = {
+      {&libench::ImageFormat::RGB8, AV_PIX_FMT_RGB24},
+      {&libench::ImageFormat::RGBA8, AV_PIX_FMT_RGB32}};
+
+  static const std::vector<PixelFormatMapping> PLANAR_RGB = {
+      {&libench::ImageFormat::RGB8, AV_PIX_FMT_GBRP},
+      {&libench::ImageFormat::RGBA8, AV_PIX_FMT_GBRAP}};
+
+  if (codec_id == AV_CODEC_ID_FFV1) {
+    return FFV1;
+  } else if (codec_id == AV_CODEC_ID_FFVHUFF) {
+    return FFVHUFF;
+  } else if (codec_id == AV_CODEC_ID_HUFFYUV) {
+    return HUFFYUV;
+  } else if (codec_id == AV_CODEC_ID_MAGICYUV || codec_id == AV_CODEC_ID_UTVIDEO) {
+    return PLANAR_RGB;
+  }
+
+  throw std::runtime_error("Unsupported FFmpeg codec");
+}
+
+/* copies the image into the frame, which is allocated in the pixel format that the table maps the image format to */
+static void copy_to_frame(const libench::ImageContext& image, AVFrame* frame) {
+  int num_comps = image.format.comps.num_comps;
+
+  if (frame->format == AV_PIX_FMT_0RGB32) {
+    for (int i = 0; i < image.height; i++) {
+      uint8_t* dst_line = frame->data[0] + (i * frame->linesize[0]);
+      const uint8_t* src_line = image.planes8[0] + ((size_t) i * image.width * num_comps);
+      for (int j = 0; j < image.width; j++) {
+#if HAVE_BIGENDIAN
+        /* RGB -> 0RGB */
+        dst_line[4 * j + 0] = 255;
+        dst_line[4 * j + 1] = src_line[3 * j + 0];
+        dst_line[4 * j + 2] = src_line[3 * j + 1];
+        dst_line[4 * j + 3] = src_line[3 * j + 2];
+#else
+        /* RGB -> BGR0 */
+        dst_line[4 * j + 0] = src_line[3 * j + 2];
+        dst_line[4 * j + 1] = src_line[3 * j + 1];
+        dst_line[4 * j + 2] = src_line[3 * j + 0];
+        dst_line[4 * j + 3] = 0;
+#endif
+      }
+    }
+  } else if (frame->format == AV_PIX_FMT_RGB32) {
+    for (int i = 0; i < image.height; i++) {
+      uint8_t* dst_line = frame->data[0] + (i * frame->linesize[0]);
+      const uint8_t* src_line = image.planes8[0] + ((size_t) i * image.width * num_comps);
+      for (int j = 0; j < image.width; j++) {
+#if HAVE_BIGENDIAN
+        /* RGBA -> ARGB */
+        dst_line[4 * j + 0] = src_line[4 * j + 3];
+        dst_line[4 * j + 3] = src_line[4 * j + 2];
+        dst_line[4 * j + 2] = src_line[4 * j + 1];
+        dst_line[4 * j + 1] = src_line[4 * j + 0];
+#else
+        /* RGBA -> BGRA */
+        dst_line[4 * j + 0] = src_line[4 * j + 2];
+        dst_line[4 * j + 1] = src_line[4 * j + 1];
+        dst_line[4 * j + 2] = src_line[4 * j + 0];
+        dst_line[4 * j + 3] = src_line[4 * j + 3];
+#endif
+      }
+    }
+  } else if (frame->format == AV_PIX_FMT_GBRP || frame->format == AV_PIX_FMT_GBRAP) {
+    /* RGB(A) -> G, B, R (and A) planes */
+    static const int plane_of_comp[4] = {2, 0, 1, 3};
+
+    for (int i = 0; i < image.height; i++) {
+      const uint8_t* src_line = image.planes8[0] + ((size_t) i * image.width * num_comps);
+      for (int c = 0; c < num_comps; c++) {
+        uint8_t* dst_line = frame->data[plane_of_comp[c]] + (i * frame->linesize[plane_of_comp[c]]);
+        for (int j = 0; j < image.width; j++)
+          dst_line[j] = src_line[num_comps * j + c];
+      }
+    }
+  } else {
+    /* packed RGB24 and planar YUV have the layout of the image */
+    for (int i = 0; i < image.format.num_planes(); i++) {
+      av_image_copy_plane(frame->data[i], frame->linesize[i],
+                          image.planes8[i], image.line_size(i),
+                          image.line_size(i), image.plane_height(i));
+    }
+  }
+}
+
+/* pixel format that the table of the codec maps the image format to */
+static AVPixelFormat coded_pix_fmt(AVCodecID codec_id, const libench::ImageFormat& format) {
+  for (const auto& m : pixel_formats(codec_id)) {
+    if (*m.format == format)
+      return m.pix_fmt;
+  }
+
+  throw std::runtime_error("Unsupported image format");
+}
+
+/* image format that the table of the codec maps the coded pixel format to */
+static const libench::ImageFormat& coded_image_format(AVCodecID codec_id, AVPixelFormat pix_fmt) {
+  for (const auto& m : pixel_formats(codec_id)) {
+    if (m.pix_fmt == pix_fmt)
+      return *m.format;
+  }
+
+  throw std::runtime_error("Bad pixel format");
+}
+
+/*
+ * inverse of copy_to_frame(); the decoder can output another pixel format than
+ * the coded one, e.g. HuffYUV outputs RGB24 as 0RGB32, so any frame layout that
+ * holds the components of the image is accepted
+ */
+static void copy_from_frame(AVCodecID codec_id, const AVFrame* frame, libench::ImageContext& image) {
+  int num_comps = image.format.comps.num_comps;
+
+  if (frame->format == AV_PIX_FMT_0RGB32 && image.format == libench::ImageFormat::RGB8) {
+    for (int i = 0; i < image.height; i++) {
+      const uint8_t* src_line = frame->data[0] + (i * frame->linesize[0]);
+      uint8_t* dst_line = image.planes8[0] + ((size_t) i * image.width * num_comps);
+      for (int j = 0; j < image.width; j++) {
+#if HAVE_BIGENDIAN
+        /* 0RGB -> RGB */
+        dst_line[3 * j + 0] = src_line[4 * j + 1];
+        dst_line[3 * j + 1] = src_line[4 * j + 2];
+        dst_line[3 * j + 2] = src_line[4 * j + 3];
+#else
+        /* BGR0 -> RGB */
+        dst_line[3 * j + 0] = src_line[4 * j + 2];
+        dst_line[3 * j + 1] = src_line[4 * j + 1];
+        dst_line[3 * j + 2] = src_line[4 * j + 0];
+#endif
+      }
+    }
+  } else if (frame->format == AV_PIX_FMT_RGB32 && image.format == libench::ImageFormat::RGBA8) {
+    for (int i = 0; i < image.height; i++) {
+      const uint8_t* src_line = frame->data[0] + (i * frame->linesize[0]);
+      uint8_t* dst_line = image.planes8[0] + ((size_t) i * image.width * num_comps);
+      for (int j = 0; j < image.width; j++) {
+#if HAVE_BIGENDIAN
+        /* ARGB -> RGBA */
+        dst_line[4 * j + 0] = src_line[4 * j + 1];
+        dst_line[4 * j + 1] = src_line[4 * j + 2];
+        dst_line[4 * j + 2] = src_line[4 * j + 3];
+        dst_line[4 * j + 3] = src_line[4 * j + 0];
+#else
+        /* BGRA -> RGBA */
+        dst_line[4 * j + 0] = src_line[4 * j + 2];
+        dst_line[4 * j + 1] = src_line[4 * j + 1];
+        dst_line[4 * j + 2] = src_line[4 * j + 0];
+        dst_line[4 * j + 3] = src_line[4 * j + 3];
+#endif
+      }
+    }
+  } else if ((frame->format == AV_PIX_FMT_GBRP && image.format == libench::ImageFormat::RGB8)
+             || (frame->format == AV_PIX_FMT_GBRAP && image.format == libench::ImageFormat::RGBA8)) {
+    /* G, B, R (and A) planes -> RGB(A) */
+    static const int plane_of_comp[4] = {2, 0, 1, 3};
+
+    for (int i = 0; i < image.height; i++) {
+      uint8_t* dst_line = image.planes8[0] + ((size_t) i * image.width * num_comps);
+      for (int c = 0; c < num_comps; c++) {
+        const uint8_t* src_line = frame->data[plane_of_comp[c]] + (i * frame->linesize[plane_of_comp[c]]);
+        for (int j = 0; j < image.width; j++)
+          dst_line[num_comps * j + c] = src_line[j];
+      }
+    }
+  } else if ((frame->format == AV_PIX_FMT_RGB24 && image.format == libench::ImageFormat::RGB8)
+             || frame->format == coded_pix_fmt(codec_id, image.format)) {
+    /* packed RGB24 and planar YUV have the layout of the image */
+    for (int i = 0; i < image.format.num_planes(); i++) {
+      av_image_copy_plane(image.planes8[i], image.line_size(i),
+                          frame->data[i], frame->linesize[i],
+                          image.line_size(i), image.plane_height(i));
+    }
+  } else {
+    throw std::runtime_error("Bad pixel format");
+  }
+}
+
+/*
+ * Codestream state
+ *
+ * The decoder needs the stream parameters and the extradata of the encoder,
+ * which are serialized as an FFmpegState header followed by the extradata.
+ */
+
+struct FFmpegState {
+  int32_t width;
+  int32_t height;
+  int32_t pix_fmt;
+  int32_t extradata_size;
+};
+
+/* frees the codec context, including the extradata, on all paths */
+struct CodecContextDeleter {
+  void operator()(AVCodecContext* ctx) const {
+    avcodec_free_context(&ctx);
+  }
+};
+
+typedef std::unique_ptr<AVCodecContext, CodecContextDeleter> CodecContextPtr;
+
+/*
+ * FFmpegEncoder
+ */
+
+libench::FFmpegEncoder::FFmpegEncoder(AVCodecID codec_id, int threads, int slices)
+    : threads_(threads), slices_(slices), pts_(0) {
+  if (threads < 1)
+    throw std::runtime_error("Thread count must be at least 1");
+
+  this->codec_ = avcodec_find_encoder(codec_id);
+  if (!this->codec_)
+    throw std::runtime_error(std::string("avcodec_find_encoder failed: ") + avcodec_get_name(codec_id));
+
+  this->pkt_ = av_packet_alloc();
+  if (!this->pkt_)
+    throw std::runtime_error("Cannot allocate packet");
+
+  this->frame_ = av_frame_alloc();
+  if (!this->frame_)
+    throw std::runtime_error("Could not allocate image frame");
+
+  this->codec_ctx_ = NULL;
+}
+
+libench::FFmpegEncoder::~FFmpegEncoder() {
+  av_packet_unref(this->pkt_);
+  av_frame_unref(this->frame_);
+  av_packet_free(&this->pkt_);
+  av_frame_free(&this->frame_);
+  avcodec_free_context(&this->codec_ctx_);
+}
+
+/*
+ * opens the codec context, and its thread pool, for the stream parameters of
+ * the image, unless the context of the previous call matches them
+ */
+void libench::FFmpegEncoder::openContext(const ImageContext &image) {
+  int ret;
+  AVPixelFormat pix_fmt = coded_pix_fmt(this->codec_->id, image.format);
+
+  if (this->codec_ctx_ && (uint32_t) this->codec_ctx_->width == image.width
+      && (uint32_t) this->codec_ctx_->height == image.height && this->codec_ctx_->pix_fmt == pix_fmt) {
+    /* the codecs are intra-only and hold no frame between calls */
+    if (this->codec_->capabilities & AV_CODEC_CAP_ENCODER_FLUSH)
+      avcodec_flush_buffers(this->codec_ctx_);
+    return;
+  }
+
+  avcodec_free_context(&this->codec_ctx_);
+
+  CodecContextPtr ctx(avcodec_alloc_context3(this->codec_));
+  if (!ctx)
+    throw std::runtime_error("avcodec_alloc_context3 failed");
+
+  ctx->width = image.width;
+  ctx->height = image.height;
+  ctx->time_base = (AVRational){1, 25};
+  ctx->framerate = (AVRational){25, 1};
+  ctx->pix_fmt = pix_fmt;
+  ctx->thread_count = this->threads_;
+  ctx->thread_type = FF_THREAD_SLICE;
+  ctx->slices = this->slices_;
+  /* every frame is a key frame, which FFV1 otherwise only codes every 12 frames */
+  ctx->gop_size = 1;
+
+  AVDictionary *opts = NULL;
+
+  if (this->codec_->id == AV_CODEC_ID_FFV1 && image.format.bit_depth > 8) {
+    ret = av_dict_set(&opts, "coder", "range_tab", 0);
+    if (ret < 0)
+      throw std::runtime_error("Opts allocation failed");
+  }
+
+  ret = avcodec_open2(ctx.get(), this->codec_, &opts);
+  av_dict_free(&opts);
+  if (ret < 0)
+    throw std::runtime_error("Could not open codec");
+
+  av_frame_unref(this->frame_);
+
+  this->frame_->format = ctx->pix_fmt;
+  this->frame_->width = ctx->width;
+  this->frame_->height = ctx->height;
+
+  ret = av_frame_get_buffer(this->frame_, 0);
+  if (ret < 0)
+    throw std::runtime_error("Could not allocate the video frame data");
+
+  /* the stream parameters and the extradata are fixed once the context is open */
+  FFmpegState state;
+  state.width = ctx->width;
+  state.height = ctx->height;
+  state.pix_fmt = ctx->pix_fmt;
+  state.extradata_size = ctx->extradata_size;
+
+  this->state_.resize(sizeof(state) + state.extradata_size);
+  memcpy(this->state_.data(), &state, sizeof(state));
+  if (state.extradata_size > 0)
+    memcpy(this->state_.data() + sizeof(state), ctx->extradata, state.extradata_size);
+
+  this->codec_ctx_ = ctx.release();
+}
+
+libench::CodestreamContext libench::FFmpegEncoder::encode(const ImageContext &image) {
+  int ret;
+
+  this->openContext(image);
+
+  av_packet_unref(this->pkt_);
+
+  /* copies the frame if the encoder still references it */
+  ret = av_frame_make_writable(this->frame_);
+  if (ret < 0)
+    throw std::runtime_error("Frame is not writable");
+
+  copy_to_frame(image, this->frame_);
+
+  this->frame_->pts = this->pts_++;
+
+  {
+    LIBENCH_TRACE_SPAN("avcodec_send_frame");
+
+    ret = avcodec_send_frame(this->codec_ctx_, this->frame_);
+    if (ret < 0) {
+      avcodec_free_context(&this->codec_ctx_);
+      throw std::runtime_error("Error sending a frame for encoding");
+    }
+  }
+
+  {
+    LIBENCH_TRACE_SPAN("avcodec_receive_packet");
+
+    ret = avcodec_receive_packet(this->codec_ctx_, this->pkt_);
+    if (ret) {
+      avcodec_free_context(&this->codec_ctx_);
+      throw std::runtime_error("Error during encoding");
+    }
+  }
+
+  libench::CodestreamContext cs;
+
+  cs.codestream = this->pkt_->data;
+  cs.size = (size_t)this->pkt_->size;
+  cs.state = this->state_.data();
+  cs.state_size = this->state_.size();
+
+  return cs;
+}
+
+libench::CodestreamContext libench::FFmpegEncoder::encodeRGB8(const ImageContext &image) {
+  return this->encode(image);
+}
+
+libench::CodestreamContext libench::FFmpegEncoder::encodeRGBA8(const ImageContext &image) {
+  return this->encode(image);
+}
+
+libench::CodestreamContext libench::FFmpegEncoder::encodeYUV(const ImageContext &image) {
+  return this->encode(image);
+}
+
+/*
+ * FFmpegDecoder
+ */
+
+libench::FFmpegDecoder::FFmpegDecoder(AVCodecID codec_id, int threads) : threads_(threads) {
+  if (threads < 1)
+    throw std::runtime_error("Thread count must be at least 1");
+
+  this->codec_ = avcodec_find_decoder(codec_id);
+  if (!this->codec_)
+    throw std::runtime_error(std::string("avcodec_find_decoder failed: ") + avcodec_get_name(codec_id));
+
+  this->pkt_ = av_packet_alloc();
+  if (!this->pkt_)
+    throw std::runtime_error("Cannot allocate packet");
+
+  this->frame_ = av_frame_alloc();
+  if (!this->frame_)
+    throw std::runtime_error("Could not allocate image frame");
+
+  this->codec_ctx_ = NULL;
+}
+
+libench::FFmpegDecoder::~FFmpegDecoder() {
+  av_packet_free(&this->pkt_);
+  av_frame_free(&this->frame_);
+  avcodec_free_context(&this->codec_ctx_);
+}
+
+libench::ImageContext libench::FFmpegDecoder::decodeRGB8(const CodestreamContext& cs) {
+  return this->decode(cs);
+}
+
+libench::ImageContext libench::FFmpegDecoder::decodeRGBA8(const CodestreamContext& cs) {
+  return this->decode(cs);
+}
+
+libench::ImageContext libench::FFmpegDecoder::decodeYUV(const CodestreamContext& cs) {
+  return this->decode(cs);
+}
+
+/*
+ * opens the codec context, and its thread pool, for the stream parameters and
+ * extradata of the codestream state, unless the context of the previous call
+ * matches them; returns the coded pixel format
+ */
+AVPixelFormat libench::FFmpegDecoder::openContext(const CodestreamContext& cs) {
+  int ret;
+  FFmpegState state;
+
+  if (!cs.state || cs.state_size < sizeof(state))
+    throw std::runtime_error("Missing codestream state");
+
+  memcpy(&state, cs.state, sizeof(state));
+
+  if (state.extradata_size < 0 || cs.state_size != sizeof(state) + state.extradata_size)
+    throw std::runtime_error("Bad codestream state");
+
+  if (this->codec_ctx_ && this->state_.size() == cs.state_size && !memcmp(this->state_.data(), cs.state, cs.state_size)) {
+    avcodec_flush_buffers(this->codec_ctx_);
+    return (AVPixelFormat)state.pix_fmt;
+  }
+
+  avcodec_free_context(&this->codec_ctx_);
+  this->state_.clear();
+
+  CodecContextPtr ctx(avcodec_alloc_context3(this->codec_));
+  if (!ctx)
+    throw std::runtime_error("avcodec_alloc_context3 failed");
+
+  ctx->width = state.width;
+  ctx->height = state.height;
+  ctx->pix_fmt = (AVPixelFormat)state.pix_fmt;
+  ctx->time_base = (AVRational){1, 25};
+  ctx->framerate = (AVRational){25, 1};
+  ctx->thread_count = this->threads_;
+  ctx->thread_type = FF_THREAD_SLICE;
+
+  if (state.extradata_size > 0) {
+    /* FFmpeg requires padding after the extradata, which the context owns */
+    ctx->extradata = (uint8_t*)av_mallocz(state.extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!ctx->extradata)
+      throw std::runtime_error("Cannot allocate extradata");
+    memcpy(ctx->extradata, (const uint8_t*)cs.state + sizeof(state), state.extradata_size);
+    ctx->extradata_size = state.extradata_size;
+  }
+
+  ret = avcodec_open2(ctx.get(), this->codec_, NULL);
+  if (ret < 0)
+    throw std::runtime_error("Could not open codec");
+
+  this->codec_ctx_ = ctx.release();
+  this->state_.assign((const uint8_t*)cs.state, (const uint8_t*)cs.state + cs.state_size);
+
+  return (AVPixelFormat)state.pix_fmt;
+}
+
+/* decodes the codestream into frame_ and returns the coded pixel format */
+AVPixelFormat libench::FFmpegDecoder::decodeFrame(const CodestreamContext& cs) {
+  int ret;
+
+  AVPixelFormat pix_fmt = this->openContext(cs);
+
+  av_frame_unref(this->frame_);
+
+  this->pkt_->data = (uint8_t*)cs.codestream;
+  this->pkt_->size = cs.size;
+
+  {
+    LIBENCH_TRACE_SPAN("avcodec_send_packet");
+
+    ret = avcodec_send_packet(this->codec_ctx_, this->pkt_);
+    if (ret < 0) {
+      avcodec_free_context(&this->codec_ctx_);
+      throw std::runtime_error("Error sending a packet for decoding");
+    }
+  }
+
+  {
+    LIBENCH_TRACE_SPAN("avcodec_receive_frame");
+
+    ret = avcodec_receive_frame(this->codec_ctx_, this->frame_);
+    if (ret < 0) {
+      avcodec_free_context(&this->codec_ctx_);
+      throw std::runtime_error("Error during decoding");
+    }
+  }
+
+  return pix_fmt;
+}
+
+libench::ImageContext libench::FFmpegDecoder::decode(const CodestreamContext& cs) {
+  AVPixelFormat pix_fmt = this->decodeFrame(cs);
+
+  libench::ImageContext image;
+
+  image.height = this->frame_->height;
+  image.width = this->frame_->width;
+  image.format = coded_image_format(this->codec_->id, pix_fmt);
+
+  for (int i = 0; i < image.format.num_planes(); i++) {
+    this->planes_[i].resize(image.plane_size(i));
+    image.planes8[i] = this->planes_[i].data();
+  }
+
+  copy_from_frame(this->codec_->id, this->frame_, image);
+
+  return image;
+}
+
+void libench::FFmpegDecoder::decodeInto(const CodestreamContext& cs, ImageContext& image) {
+  AVPixelFormat pix_fmt = this->decodeFrame(cs);
+
+  if ((uint32_t) this->frame_->width != image.width || (uint32_t) this->frame_->height != image.height
+      || !(coded_image_format(this->codec_->id, pix_fmt) == image.format))
+    throw std::runtime_error("Destination image does not match the codestream");
+
+  /* the frame is converted directly into the destination planes */
+  copy_from_frame(this->codec_->id, this->frame_, image);
+}
@@ -0,0 +1,86 @@
+#ifndef LIBENCH_FFMPEG_H
+#define LIBENCH_FFMPEG_H
+
+#include <vector>
+#include "codec.h"
+
+extern "C" {
+#include "libavcodec/codec.h"
+#include "libavcodec/packet.h"
+#include <libavcodec/avcodec.h>
+}
+
+namespace libench {
+
+/*
+ * Intra-only lossless codecs of FFmpeg, e.g. FFV1, FFVHuff, HuffYUV, MagicYUV
+ * and UtVideo, keyed by codec ID. Each codec has a table that maps the image
+ * formats it supports to the FFmpeg pixel format it codes them in, see
+ * ffmpeg_codec.cpp.
+ */
+
+class FFmpegEncoder : public Encoder {
+ public:
+  /*
+   * threads is the number of slice threads; slices, if not 0, sets the number
+   * of slices of the codecs that code slices, e.g. FFV1, MagicYUV and UtVideo
+   */
+  FFmpegEncoder(AVCodecID codec_id, int threads = 1, int slices = 0);
+  ~FFmpegEncoder();
+
+  virtual CodestreamContext encodeRGB8(const ImageContext &image);
+
+  virtual CodestreamContext encodeRGBA8(const ImageContext &image);
+
+  virtual CodestreamContext encodeYUV(const ImageContext &image);
+
+ private:
+  CodestreamContext encode(const ImageContext &image);
+
+  void openContext(const ImageContext &image);
+
+  int threads_;
+  int slices_;
+  int64_t pts_;
+  AVPacket* pkt_;
+  AVFrame* frame_;
+  const AVCodec* codec_;
+  /* reused across calls with the same stream parameters */
+  AVCodecContext* codec_ctx_;
+  std::vector<uint8_t> state_;
+};
+
+class FFmpegDecoder : public Decoder {
+ public:
+  FFmpegDecoder(AVCodecID codec_id, int threads = 1);
+  ~FFmpegDecoder();
+
+  virtual ImageContext decodeRGB8(const CodestreamContext& cs);
+
+  virtual ImageContext decodeRGBA8(const CodestreamContext& cs);
+
+  virtual ImageContext decodeYUV(const CodestreamContext& cs);
+
+  virtual void decodeInto(const CodestreamContext& cs, ImageContext& image);
+
+ private:
+  ImageContext decode(const CodestreamContext& cs);
+
+  AVPixelFormat openContext(const CodestreamContext& cs);
+
+  AVPixelFormat decodeFrame(const CodestreamContext& cs);
+
+  int threads_;
+  AVPacket* pkt_;
+  AVFrame* frame_;
+  const AVCodec* codec_;
+  /* reused across calls with the same codestream state */
+  AVCodecContext* codec_ctx_;
+  /* codestream state the context was opened with */
+  std::vector<uint8_t> state_;
+  std::vector<uint8_t> planes_[3];
+};
+
+}  // namespace libench
+
+#endif
@@ -0,0 +1,67 @@
+#ifdef LIBENCH_HAS_FPNGE
+
+#include "fpnge_codec.h"
+#include <stdexcept>
+#include "fpnge.h"
+
+/*
+ * FPNGEEncoder
+ */
+
+libench::FPNGEEncoder::FPNGEEncoder(int level) : level_(level) {
+  if (level < 1 || level > FPNGE_COMPRESS_LEVEL_BEST)
+    throw std::runtime_error("fpnge compression level must be between 1 and 5");
+
+  /* fpnge has no run-time dispatch, so it cannot be capped below the level it was compiled for */
+  if (isaLevel() > host_isa_level() || isaLevel() > isa_level())
+    throw std::runtime_error("fpnge was compiled for " + isa_level_name(isaLevel())
+                             + ", which exceeds the CPU or the --isa cap, see LIBENCH_FPNGE_ISA");
+}
+
+libench::IsaLevel libench::FPNGEEncoder::isaLevel() {
+#ifdef LIBENCH_FPNGE_AVX2
+  return IsaLevel::AVX2;
+#else
+  return IsaLevel::SSE4;
+#endif
+}
+
+libench::CodestreamContext libench::FPNGEEncoder::encodeRGB8(const ImageContext &image) {
+  return this->encodeInto(image, this->out_);
+}
+
+libench::CodestreamContext libench::FPNGEEncoder::encodeRGBA8(const ImageContext &image) {
+  return this->encodeInto(image, this->out_);
+}
+
+libench::CodestreamContext libench::FPNGEEncoder::encodeInto(const ImageContext &image, OutputBuffer& out) {
+  if (!(image.format == libench::ImageFormat::RGB8 || image.format == libench::ImageFormat::RGBA8))
+    throw std::runtime_error("Unsupported image format");
+
+  FPNGEOptions options;
+
+  FPNGEFillOptions(&options, this->level_, FPNGE_CICP_NONE);
+
+  size_t num_comps = image.format.comps.num_comps;
+
+  /* fpnge writes into a buffer of its worst-case output size, which only grows across calls */
+  out.clear();
+  out.resize(FPNGEOutputAllocSize(1, num_comps, image.width, image.height));
+
+  size_t size = FPNGEEncode(1, num_comps, image.planes8[0], image.width, image.line_size(0), image.height,
+                            out.data(), &options);
+
+  if (size == 0)
+    throw std::runtime_error("PNG encode failed");
+
+  out.resize(size);
+
+  libench::CodestreamContext cs;
+
+  cs.codestream = out.data();
+  cs.size = out.size();
+
+  return cs;
+}
+
+#endif
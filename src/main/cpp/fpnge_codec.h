@@ -0,0 +1,38 @@
+#ifndef LIBENCH_FPNGE_H
+#define LIBENCH_FPNGE_H
+
+#include "codec.h"
+#include "isa.h"
+
+namespace libench {
+
+/*
+ * PNG encoder based on fpnge, which is encode-only; the codec registered as
+ * png_fpnge pairs it with the libpng decoder, or the libspng decoder if libench
+ * is built without libpng
+ */
+class FPNGEEncoder : public Encoder {
+ public:
+  /*
+   * level is the fpnge compression level, from 1 (fastest) to 5 (best); throws
+   * if fpnge was compiled for a SIMD level above the CPU or the --isa cap
+   */
+  explicit FPNGEEncoder(int level = 4);
+
+  /* SIMD level fpnge was compiled for, see LIBENCH_FPNGE_ISA */
+  static IsaLevel isaLevel();
+
+  CodestreamContext encodeRGB8(const ImageContext &image);
+
+  CodestreamContext encodeRGBA8(const ImageContext &image);
+
+  CodestreamContext encodeInto(const ImageContext &image, OutputBuffer& out);
+
+ private:
+  int level_;
+  OutputBuffer out_;
+};
+
+}  // namespace libench
+
+#endif
@@ -0,0 +1,172 @@
+#include "image_io.h"
+#include "synth_image.h"
+#include <fstream>
+#include <stdexcept>
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#define STBI_NO_LINEAR
+#include "stb_image.h"
+
+libench::ImageFormat parse_pixel_format(const std::string& pix_fmt) {
+  if (pix_fmt == "rgb24") {
+    return libench::ImageFormat::RGB8;
+  } else if (pix_fmt == "rgba") {
+    return libench::ImageFormat::RGBA8;
+  } else if (pix_fmt == "yuv420p10le") {
+    return libench::ImageFormat::YUV420P10;
+  } else if (pix_fmt == "yuv422p10le") {
+    return libench::ImageFormat::YUV422P10;
+  } else if (pix_fmt == "yuv444p10le") {
+    return libench::ImageFormat::YUV444P10;
+  } else if (pix_fmt == "yuv420p12le") {
+    return libench::ImageFormat::YUV420P12;
+  } else if (pix_fmt == "yuv422p12le") {
+    return libench::ImageFormat::YUV422P12;
+  } else if (pix_fmt == "yuv444p12le") {
+    return libench::ImageFormat::YUV444P12;
+  }
+
+  throw std::runtime_error("Unknown pixel format: " + pix_fmt);
+}
+
+/* the path must be of the form XXXXXX.<width>x<height>.<pixel_fmt>.yuv */
+static void parse_yuv_path(const std::string& filepath, libench::ImageContext& image) {
+  size_t start = filepath.find_last_of(".");
+
+  if (filepath.substr(start + 1) != "yuv") {
+    throw std::runtime_error("Image file must be YUV");
+  }
+
+  size_t end = start - 1;
+  start = filepath.find_last_of(".", end);
+  std::string pix_fmt = filepath.substr(start + 1, end - start);
+
+  end = start - 1;
+  start = filepath.find_last_of("x", end);
+  image.height = std::stoul(filepath.substr(start + 1, end - start));
+
+  end = start - 1;
+  start = filepath.find_last_of(".", end);
+  image.width = std::stoul(filepath.substr(start + 1, end - start));
+
+  image.format = parse_pixel_format(pix_fmt);
+
+  if (! image.format.is_planar) {
+    throw std::runtime_error("Only planar pixel formats are supported: " + pix_fmt);
+  }
+}
+
+libench::ImageContext load_image(const std::string& filepath) {
+  if (is_synth_image(filepath)) {
+    return generate_image(filepath);
+  }
+
+  libench::ImageContext image;
+
+  size_t start = filepath.find_last_of(".");
+
+  std::string file_ext = filepath.substr(start + 1);
+
+  if (file_ext == "png") {
+    int height;
+    int width;
+    int num_comps;
+
+    image.planes8[0] = stbi_load(filepath.c_str(), &width, &height, &num_comps, 0);
+    if (! image.planes8[0]) {
+      throw std::runtime_error("Cannot read image file");
+    }
+
+    image.height = height;
+    image.width = width;
+
+    switch (num_comps) {
+    case 3:
+      image.format = libench::ImageFormat::RGB8;
+      break;
+    case 4:
+      image.format = libench::ImageFormat::RGBA8;
+      break;
+    default:
+      throw std::runtime_error("Only RGB or RGBA images are supported");
+    }
+
+  } else if (file_ext == "yuv") {
+    parse_yuv_path(filepath, image);
+
+    std::ifstream in(filepath);
+
+    for(uint8_t i = 0; i < image.format.num_planes(); i++) {
+
+      image.planes16[i] = (uint16_t*) malloc(image.plane_size(i));
+      if (! image.planes16[i]) {
+        throw std::runtime_error("Cannot allocate memory");
+      }
+
+      in.read((char*) image.planes16[i], image.plane_size(i));
+      if (in.bad()) {
+        throw std::runtime_error("Read failed");
+      }
+    }
+
+  } else {
+    throw std::runtime_error("Image file must be YUV or PNG");
+  }
+
+  return image;
+}
+
+void free_image(libench::ImageContext& image) {
+  for(uint8_t i = 0; i < image.format.num_planes(); i++) {
+    free(image.planes8[i]);
+    image.planes8[i] = NULL;
+  }
+}
+
+libench::ImageContext place_image(const libench::ImageContext& image, libench::PageBuffer& buffer,
+                                  libench::PageSize pages, bool copy_samples) {
+  size_t size = 0;
+
+  for (uint8_t i = 0; i < image.format.num_planes(); i++)
+    size += image.plane_size(i);
+
+  buffer.allocate(size, pages);
+
+  libench::ImageContext placed = image;
+  size_t offset = 0;
+
+  for (uint8_t i = 0; i < image.format.num_planes(); i++) {
+    placed.planes8[i] = buffer.data() + offset;
+
+    if (copy_samples)
+      memcpy(placed.planes8[i], image.planes8[i], image.plane_size(i));
+
+    offset += image.plane_size(i);
+  }
+
+  return placed;
+}
+
+libench::ImageContext map_image(const std::string& filepath, libench::MappedFile& file) {
+  libench::ImageContext image;
+
+  parse_yuv_path(filepath, image);
+
+  file.open(filepath);
+
+  size_t offset = 0;
+
+  for(uint8_t i = 0; i < image.format.num_planes(); i++) {
+    if (offset + image.plane_size(i) > file.size()) {
+      throw std::runtime_error("Image file is too short");
+    }
+
+    /* the mapping is read-only, which encoders respect since they take a const image */
+    image.planes8[i] = const_cast<uint8_t*>(file.data()) + offset;
+
+    offset += image.plane_size(i);
+  }
+
+  return image;
+}
@@ -0,0 +1,35 @@
+#ifndef LIBENCH_IMAGE_IO_H
+#define LIBENCH_IMAGE_IO_H
+
+#include <string>
+#include "codec.h"
+#include "mapped_file.h"
+
+/* maps an FFmpeg pixel format name, e.g. yuv422p10le, to an image format */
+libench::ImageFormat parse_pixel_format(const std::string& pix_fmt);
+
+/*
+ * loads a PNG image, a raw YUV image named XXXXXX.<width>x<height>.<pixel_fmt>.yuv
+ * or generates a synthetic image if the path starts with synth: (see synth_image.h)
+ */
+libench::ImageContext load_image(const std::string& filepath);
+
+/*
+ * maps a raw YUV image instead of reading it into memory, so that images
+ * larger than memory can be encoded; the planes remain valid while file is open
+ * and must not be freed
+ */
+libench::ImageContext map_image(const std::string& filepath, libench::MappedFile& file);
+
+/*
+ * returns a copy of image whose planes are placed contiguously in buffer, which
+ * is allocated with the specified pages; the samples are only copied if
+ * copy_samples is set
+ */
+libench::ImageContext place_image(const libench::ImageContext& image, libench::PageBuffer& buffer,
+                                  libench::PageSize pages, bool copy_samples);
+
+/* frees the planes allocated by load_image */
+void free_image(libench::ImageContext& image);
+
+#endif
@@ -0,0 +1,303 @@
+#include "isa.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include "codec_factory.h"
+#ifdef LIBENCH_HAS_FPNGE
+#include "fpnge_codec.h"
+#endif
+#include "hwy/targets.h"
+
+extern "C" {
+#include <libavutil/cpu.h>
+}
+
+/* exported by dav1d and libwebp, but only declared in their internal headers */
+extern "C" {
+void dav1d_set_cpu_flags_mask(unsigned mask);
+
+typedef int (*VP8CPUInfo)(int feature);
+extern VP8CPUInfo VP8GetCPUInfo;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LIBENCH_ISA_X86 1
+#endif
+
+static libench::IsaLevel cap_level = libench::IsaLevel::NATIVE;
+
+libench::IsaLevel libench::parse_isa_level(const std::string& name) {
+  if (name == "scalar") {
+    return IsaLevel::SCALAR;
+  } else if (name == "sse4") {
+    return IsaLevel::SSE4;
+  } else if (name == "avx2") {
+    return IsaLevel::AVX2;
+  } else if (name == "avx512") {
+    return IsaLevel::AVX512;
+  } else if (name == "native") {
+    return IsaLevel::NATIVE;
+  }
+
+  throw std::runtime_error("Unknown instruction set level: " + name);
+}
+
+std::string libench::isa_level_name(IsaLevel level) {
+  switch (level) {
+    case IsaLevel::SCALAR:
+      return "scalar";
+    case IsaLevel::SSE2:
+      return "sse2";
+    case IsaLevel::SSSE3:
+      return "ssse3";
+    case IsaLevel::SSE4:
+      return "sse4";
+    case IsaLevel::AVX2:
+      return "avx2";
+    case IsaLevel::AVX512:
+      return "avx512";
+    default:
+      return "native";
+  }
+}
+
+libench::IsaLevel libench::host_isa_level() {
+#ifdef LIBENCH_ISA_X86
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    return IsaLevel::AVX512;
+  if (__builtin_cpu_supports("avx2"))
+    return IsaLevel::AVX2;
+  if (__builtin_cpu_supports("sse4.1"))
+    return IsaLevel::SSE4;
+  if (__builtin_cpu_supports("ssse3"))
+    return IsaLevel::SSSE3;
+  if (__builtin_cpu_supports("sse2"))
+    return IsaLevel::SSE2;
+  return IsaLevel::SCALAR;
+#else
+  return IsaLevel::NATIVE;
+#endif
+}
+
+/*
+ * libjxl: Highway orders its targets so that lower bits are better, and
+ * cannot disable the baseline target it was compiled for
+ */
+
+static int64_t hwy_target(libench::IsaLevel level) {
+  switch (level) {
+    case libench::IsaLevel::AVX512:
+      return HWY_AVX3;
+    case libench::IsaLevel::AVX2:
+      return HWY_AVX2;
+    case libench::IsaLevel::SSE4:
+      return HWY_SSE4;
+    case libench::IsaLevel::SSSE3:
+      return HWY_SSSE3;
+#ifdef HWY_SSE2
+    case libench::IsaLevel::SSE2:
+      return HWY_SSE2;
+#endif
+    default:
+      return HWY_EMU128;
+  }
+}
+
+static libench::IsaLevel hwy_level(int64_t target) {
+  if (target < HWY_AVX2)
+    return libench::IsaLevel::AVX512;
+  if (target < HWY_SSE4)
+    return libench::IsaLevel::AVX2;
+  if (target < HWY_SSSE3)
+    return libench::IsaLevel::SSE4;
+  if (target == HWY_SSSE3)
+    return libench::IsaLevel::SSSE3;
+#ifdef HWY_SSE2
+  if (target == HWY_SSE2)
+    return libench::IsaLevel::SSE2;
+#endif
+  return libench::IsaLevel::SCALAR;
+}
+
+/* FFmpeg: flags cumulated up to each level */
+
+static const int FFMPEG_SSE2_FLAGS = AV_CPU_FLAG_MMX | AV_CPU_FLAG_MMXEXT | AV_CPU_FLAG_SSE | AV_CPU_FLAG_SSE2
+                                     | AV_CPU_FLAG_SSE2SLOW | AV_CPU_FLAG_CMOV;
+static const int FFMPEG_SSSE3_FLAGS = FFMPEG_SSE2_FLAGS | AV_CPU_FLAG_SSE3 | AV_CPU_FLAG_SSE3SLOW | AV_CPU_FLAG_SSSE3
+                                      | AV_CPU_FLAG_SSSE3SLOW | AV_CPU_FLAG_ATOM;
+static const int FFMPEG_SSE4_FLAGS = FFMPEG_SSSE3_FLAGS | AV_CPU_FLAG_SSE4 | AV_CPU_FLAG_SSE42 | AV_CPU_FLAG_AESNI;
+static const int FFMPEG_AVX2_FLAGS = FFMPEG_SSE4_FLAGS | AV_CPU_FLAG_AVX | AV_CPU_FLAG_AVXSLOW | AV_CPU_FLAG_XOP
+                                     | AV_CPU_FLAG_FMA4 | AV_CPU_FLAG_AVX2 | AV_CPU_FLAG_FMA3 | AV_CPU_FLAG_BMI1
+                                     | AV_CPU_FLAG_BMI2 | AV_CPU_FLAG_SLOW_GATHER;
+
+static int ffmpeg_flags(libench::IsaLevel level) {
+  switch (level) {
+    case libench::IsaLevel::SCALAR:
+      return 0;
+    case libench::IsaLevel::SSE2:
+      return FFMPEG_SSE2_FLAGS;
+    case libench::IsaLevel::SSSE3:
+      return FFMPEG_SSSE3_FLAGS;
+    case libench::IsaLevel::SSE4:
+      return FFMPEG_SSE4_FLAGS;
+    case libench::IsaLevel::AVX2:
+      return FFMPEG_AVX2_FLAGS;
+    default:
+      return ~0;
+  }
+}
+
+static libench::IsaLevel ffmpeg_level(int flags) {
+  if (flags & AV_CPU_FLAG_AVX512)
+    return libench::IsaLevel::AVX512;
+  if (flags & AV_CPU_FLAG_AVX2)
+    return libench::IsaLevel::AVX2;
+  if (flags & AV_CPU_FLAG_SSE4)
+    return libench::IsaLevel::SSE4;
+  if (flags & AV_CPU_FLAG_SSSE3)
+    return libench::IsaLevel::SSSE3;
+  if (flags & AV_CPU_FLAG_SSE2)
+    return libench::IsaLevel::SSE2;
+  return libench::IsaLevel::SCALAR;
+}
+
+/* libwebp: CPUFeature of src/dsp/cpu.h */
+
+enum WebPFeature { WEBP_SSE2, WEBP_SSE3, WEBP_SLOW_SSSE3, WEBP_SSE4_1, WEBP_AVX, WEBP_AVX2 };
+
+static VP8CPUInfo webp_cpu_info = NULL;
+
+static libench::IsaLevel webp_feature_level(int feature) {
+  switch (feature) {
+    case WEBP_SSE2:
+      return libench::IsaLevel::SSE2;
+    case WEBP_SSE3:
+    case WEBP_SLOW_SSSE3:
+      return libench::IsaLevel::SSSE3;
+    case WEBP_SSE4_1:
+      return libench::IsaLevel::SSE4;
+    case WEBP_AVX:
+    case WEBP_AVX2:
+      return libench::IsaLevel::AVX2;
+    default:
+      return libench::IsaLevel::NATIVE;
+  }
+}
+
+static int capped_webp_cpu_info(int feature) {
+  if (webp_feature_level(feature) > cap_level)
+    return 0;
+
+  return webp_cpu_info ? webp_cpu_info(feature) : 0;
+}
+
+static libench::IsaLevel webp_level() {
+  if (VP8GetCPUInfo == NULL)
+    return libench::IsaLevel::SCALAR;
+
+  for (int feature : {WEBP_AVX2, WEBP_SSE4_1, WEBP_SSE3, WEBP_SSE2}) {
+    if (VP8GetCPUInfo(feature))
+      return webp_feature_level(feature);
+  }
+
+  return libench::IsaLevel::SCALAR;
+}
+
+/* dav1d: DAV1D_X86_CPU_FLAG_* of src/x86/cpu.h, SLOW_GATHER being a hint */
+
+static unsigned dav1d_mask(libench::IsaLevel level) {
+  switch (level) {
+    case libench::IsaLevel::SCALAR:
+      return 0;
+    case libench::IsaLevel::SSE2:
+      return 0x01;
+    case libench::IsaLevel::SSSE3:
+      return 0x03;
+    case libench::IsaLevel::SSE4:
+      return 0x07;
+    case libench::IsaLevel::AVX2:
+      return 0x2F;
+    default:
+      return ~0u;
+  }
+}
+
+/* aom: HAS_* of aom_ports/x86.h, read from the environment when the encoder or decoder is first created */
+
+static unsigned aom_mask(libench::IsaLevel level) {
+  switch (level) {
+    case libench::IsaLevel::SCALAR:
+      return 0;
+    case libench::IsaLevel::SSE2:
+      return 0x07;
+    case libench::IsaLevel::SSSE3:
+      return 0x1F;
+    case libench::IsaLevel::SSE4:
+      return 0x13F;
+    case libench::IsaLevel::AVX2:
+      return 0x1FF;
+    default:
+      return ~0u;
+  }
+}
+
+void libench::set_isa_level(IsaLevel level) {
+  if (level == IsaLevel::NATIVE)
+    return;
+
+#ifndef LIBENCH_ISA_X86
+  throw std::runtime_error("Instruction set levels are only supported on x86");
+#else
+  cap_level = level;
+
+  if (level < IsaLevel::AVX512)
+    hwy::DisableTargets(hwy_target(level) - 1);
+
+  av_force_cpu_flags(av_get_cpu_flags() & ffmpeg_flags(level));
+
+  webp_cpu_info = VP8GetCPUInfo;
+  VP8GetCPUInfo = capped_webp_cpu_info;
+
+  dav1d_set_cpu_flags_mask(dav1d_mask(level));
+
+  char aom_caps[16];
+  snprintf(aom_caps, sizeof(aom_caps), "0x%x", aom_mask(level));
+  setenv("AOM_SIMD_CAPS_MASK", aom_caps, 1);
+#endif
+}
+
+libench::IsaLevel libench::isa_level() {
+  return cap_level;
+}
+
+libench::IsaLevel libench::effective_isa_level(const std::string& codec_name) {
+  std::string library = codec_library(codec_name);
+
+  IsaLevel host = host_isa_level();
+
+  if (library == "ext/libjxl") {
+    int64_t targets = hwy::SupportedTargets();
+    return hwy_level(targets & -targets);
+  } else if (library == "ext/ffmpeg") {
+    return ffmpeg_level(av_get_cpu_flags());
+  } else if (library == "ext/libwebp") {
+    return webp_level();
+  } else if (library == "ext/libavif") {
+    /* neither dav1d nor aom reports the level in use */
+    return std::min(host, cap_level);
+  } else if (library == "ext/qoi" || library == "ext/lodepng" || library == "ext/charls") {
+    return IsaLevel::SCALAR;
+#ifdef LIBENCH_HAS_FPNGE
+  } else if (library == "ext/fpnge") {
+    return FPNGEEncoder::isaLevel();
+#endif
+  }
+
+  /*
+   * OpenJPH and Kakadu select the best level supported by the CPU, as does
+   * zlib-ng under libpng and libspng
+   */
+  return host;
+}
@@ -0,0 +1,44 @@
+#ifndef LIBENCH_ISA_H
+#define LIBENCH_ISA_H
+
+#include <string>
+
+namespace libench {
+
+/*
+ * x86 SIMD instruction set levels, in increasing order; NATIVE leaves each
+ * library free to use the best level supported by the CPU
+ */
+enum class IsaLevel { SCALAR, SSE2, SSSE3, SSE4, AVX2, AVX512, NATIVE };
+
+/* accepts "scalar", "sse4", "avx2", "avx512" or "native" */
+IsaLevel parse_isa_level(const std::string& name);
+
+std::string isa_level_name(IsaLevel level);
+
+/* best level supported by the CPU */
+IsaLevel host_isa_level();
+
+/*
+ * Caps the SIMD paths of the bundled libraries at the specified level through
+ * their own override mechanism: hwy::DisableTargets (libjxl),
+ * av_force_cpu_flags (FFmpeg), VP8GetCPUInfo (libwebp),
+ * dav1d_set_cpu_flags_mask (dav1d) and AOM_SIMD_CAPS_MASK (aom). OpenJPH and
+ * Kakadu have no such mechanism and are not capped; fpnge, whose level is fixed
+ * at compile time, refuses to run above the cap. Must be called before any
+ * codec is created; throws on other architectures than x86 unless level is NATIVE.
+ */
+void set_isa_level(IsaLevel level);
+
+IsaLevel isa_level();
+
+/*
+ * level that the library of the codec registered under name actually uses,
+ * as reported by the library where possible, which can exceed the cap if the
+ * library cannot go below its baseline
+ */
+IsaLevel effective_isa_level(const std::string& codec_name);
+
+}  // namespace libench
+
+#endif
@@ -0,0 +1,232 @@
+#ifdef LIBENCH_HAS_CHARLS
+
+#include "jpegls_codec.h"
+#include <stdexcept>
+#include <utility>
+
+/* frame of the single scan of an interleaved image, or of the stream of a plane */
+static charls::frame_info frame_info(uint32_t width, uint32_t height, int bits_per_sample, int component_count) {
+  charls::frame_info info;
+
+  info.width = width;
+  info.height = height;
+  info.bits_per_sample = bits_per_sample;
+  info.component_count = component_count;
+
+  return info;
+}
+
+static uint32_t plane_width(const libench::ImageContext& image, int i) {
+  return image.width / image.format.x_sub_factor[i];
+}
+
+/* streams of a planar codestream, whose sizes are recorded in the codestream state */
+static std::vector<std::pair<const uint8_t*, size_t>> planar_streams(const libench::CodestreamContext& cs) {
+  if (!cs.state || cs.state_size == 0 || cs.state_size % sizeof(uint64_t) != 0)
+    throw std::runtime_error("Bad codestream state");
+
+  std::vector<std::pair<const uint8_t*, size_t>> streams;
+  const uint64_t* sizes = static_cast<const uint64_t*>(cs.state);
+  size_t offset = 0;
+
+  for (size_t i = 0; i < cs.state_size / sizeof(uint64_t); i++) {
+    if (sizes[i] > cs.size - offset)
+      throw std::runtime_error("Bad codestream state");
+
+    streams.push_back({cs.codestream + offset, sizes[i]});
+    offset += sizes[i];
+  }
+
+  return streams;
+}
+
+/*
+ * JPEGLSEncoder
+ */
+
+libench::JPEGLSEncoder::JPEGLSEncoder(charls::interleave_mode interleave) : interleave_(interleave) {}
+
+charls::interleave_mode libench::JPEGLSEncoder::parseInterleaveMode(const std::string& name) {
+  if (name == "line") {
+    return charls::interleave_mode::line;
+  } else if (name == "sample") {
+    return charls::interleave_mode::sample;
+  }
+
+  throw std::runtime_error("Unknown JPEG-LS interleave mode: " + name);
+}
+
+libench::CodestreamContext libench::JPEGLSEncoder::encodeRGB8(const ImageContext &image) {
+  return this->encodeInto(image, this->out_);
+}
+
+libench::CodestreamContext libench::JPEGLSEncoder::encodeRGBA8(const ImageContext &image) {
+  return this->encodeInto(image, this->out_);
+}
+
+libench::CodestreamContext libench::JPEGLSEncoder::encodeYUV(const ImageContext &image) {
+  return this->encodeInto(image, this->out_);
+}
+
+libench::CodestreamContext libench::JPEGLSEncoder::encodeInto(const ImageContext &image, OutputBuffer& out) {
+  libench::CodestreamContext cs;
+
+  out.clear();
+
+  /* CharLS writes directly into out, which is sized for the worst case and then trimmed */
+
+  if (image.format == libench::ImageFormat::RGB8 || image.format == libench::ImageFormat::RGBA8) {
+    charls::jpegls_encoder encoder;
+
+    encoder.frame_info(frame_info(image.width, image.height, 8, image.format.comps.num_comps))
+        .interleave_mode(this->interleave_);
+
+    out.resize(encoder.estimated_destination_size());
+    encoder.destination(out.data(), out.size());
+    out.resize(encoder.encode(image.planes8[0], image.plane_size(0)));
+  } else if (image.format.comps == libench::ImageComponents::YUV && image.format.is_planar) {
+    this->stream_sizes_.clear();
+
+    for (int i = 0; i < image.format.num_planes(); i++) {
+      charls::jpegls_encoder encoder;
+
+      encoder.frame_info(frame_info(plane_width(image, i), image.plane_height(i), image.format.bit_depth, 1));
+
+      size_t offset = out.size();
+
+      out.resize(offset + encoder.estimated_destination_size());
+      encoder.destination(out.data() + offset, out.size() - offset);
+
+      size_t size = encoder.encode(image.planes8[i], image.plane_size(i));
+
+      out.resize(offset + size);
+      this->stream_sizes_.push_back(size);
+    }
+
+    cs.state = this->stream_sizes_.data();
+    cs.state_size = this->stream_sizes_.size() * sizeof(uint64_t);
+  } else {
+    throw std::runtime_error("Unsupported image format");
+  }
+
+  cs.codestream = out.data();
+  cs.size = out.size();
+
+  return cs;
+}
+
+/*
+ * JPEGLSDecoder
+ */
+
+libench::JPEGLSDecoder::JPEGLSDecoder() {
+}
+
+libench::ImageContext libench::JPEGLSDecoder::decodeRGB8(const CodestreamContext& cs) {
+  return this->decode(cs, libench::ImageFormat::RGB8);
+}
+
+libench::ImageContext libench::JPEGLSDecoder::decodeRGBA8(const CodestreamContext& cs) {
+  return this->decode(cs, libench::ImageFormat::RGBA8);
+}
+
+libench::ImageContext libench::JPEGLSDecoder::decodeYUV(const CodestreamContext& cs) {
+  /* the bit depth and subsampling are read from the streams of the planes */
+  auto streams = planar_streams(cs);
+
+  if (streams.size() != 3)
+    throw std::runtime_error("Bad codestream state");
+
+  charls::frame_info info[2];
+
+  for (int i = 0; i < 2; i++) {
+    charls::jpegls_decoder decoder;
+
+    decoder.source(streams[i].first, streams[i].second);
+    decoder.read_header();
+
+    info[i] = decoder.frame_info();
+  }
+
+  if (info[1].width == 0 || info[1].height == 0)
+    throw std::runtime_error("Bad codestream");
+
+  uint8_t x_sub = info[0].width / info[1].width;
+  uint8_t y_sub = info[0].height / info[1].height;
+
+  return this->decode(cs, libench::ImageFormat(info[0].bits_per_sample, libench::ImageComponents::YUV, true,
+                                               {1, x_sub, x_sub, 1}, {1, y_sub, y_sub, 1}));
+}
+
+libench::ImageContext libench::JPEGLSDecoder::decode(const CodestreamContext& cs, const ImageFormat& format) {
+  charls::jpegls_decoder decoder;
+
+  if (format.is_planar) {
+    auto streams = planar_streams(cs);
+    decoder.source(streams[0].first, streams[0].second);
+  } else {
+    decoder.source(cs.codestream, cs.size);
+  }
+
+  decoder.read_header();
+
+  libench::ImageContext image;
+
+  image.format = format;
+  image.width = decoder.frame_info().width;
+  image.height = decoder.frame_info().height;
+
+  for (int i = 0; i < format.num_planes(); i++) {
+    this->planes_[i].resize(image.plane_size(i));
+    image.planes8[i] = this->planes_[i].data();
+  }
+
+  this->decodeInto(cs, image);
+
+  return image;
+}
+
+void libench::JPEGLSDecoder::decodeInto(const CodestreamContext& cs, ImageContext& image) {
+  if (image.format == libench::ImageFormat::RGB8 || image.format == libench::ImageFormat::RGBA8) {
+    if (cs.state_size != 0)
+      throw std::runtime_error("Destination image does not match the codestream");
+
+    charls::jpegls_decoder decoder;
+
+    decoder.source(cs.codestream, cs.size);
+    decoder.read_header();
+
+    const charls::frame_info& info = decoder.frame_info();
+
+    if (info.width != image.width || info.height != image.height || info.bits_per_sample != 8
+        || info.component_count != image.format.comps.num_comps)
+      throw std::runtime_error("Destination image does not match the codestream");
+
+    /* both interleave modes are decoded to interleaved pixels */
+    decoder.decode(image.planes8[0], image.plane_size(0));
+  } else if (image.format.comps == libench::ImageComponents::YUV && image.format.is_planar) {
+    auto streams = planar_streams(cs);
+
+    if (streams.size() != image.format.num_planes())
+      throw std::runtime_error("Destination image does not match the codestream");
+
+    for (int i = 0; i < image.format.num_planes(); i++) {
+      charls::jpegls_decoder decoder;
+
+      decoder.source(streams[i].first, streams[i].second);
+      decoder.read_header();
+
+      const charls::frame_info& info = decoder.frame_info();
+
+      if (info.width != plane_width(image, i) || info.height != image.plane_height(i)
+          || info.bits_per_sample != image.format.bit_depth || info.component_count != 1)
+        throw std::runtime_error("Destination image does not match the codestream");
+
+      decoder.decode(image.planes8[i], image.plane_size(i));
+    }
+  } else {
+    throw std::runtime_error("Unsupported image format");
+  }
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef LIBENCH_JPEGLS_H
+#define LIBENCH_JPEGLS_H
+
+#include <string>
+#include <vector>
+#include "codec.h"
+
+#include "charls/charls.h"
+
+namespace libench {
+
+/*
+ * JPEG-LS codec based on CharLS. RGB8 and RGBA8 images are coded as a single
+ * line- or sample-interleaved scan. Planar images, whose planes may be
+ * subsampled, are coded as one single-component JPEG-LS stream per plane,
+ * concatenated, the size of each stream being recorded in the codestream
+ * state.
+ */
+
+class JPEGLSEncoder : public Encoder {
+ public:
+  explicit JPEGLSEncoder(charls::interleave_mode interleave = charls::interleave_mode::line);
+
+  /* accepts "line" or "sample" */
+  static charls::interleave_mode parseInterleaveMode(const std::string& name);
+
+  CodestreamContext encodeRGB8(const ImageContext &image);
+
+  CodestreamContext encodeRGBA8(const ImageContext &image);
+
+  CodestreamContext encodeYUV(const ImageContext &image);
+
+  CodestreamContext encodeInto(const ImageContext &image, OutputBuffer& out);
+
+ private:
+  charls::interleave_mode interleave_;
+  OutputBuffer out_;
+  std::vector<uint64_t> stream_sizes_;
+};
+
+class JPEGLSDecoder : public Decoder {
+ public:
+  JPEGLSDecoder();
+
+  virtual ImageContext decodeRGB8(const CodestreamContext& cs);
+
+  virtual ImageContext decodeRGBA8(const CodestreamContext& cs);
+
+  virtual ImageContext decodeYUV(const CodestreamContext& cs);
+
+  virtual void decodeInto(const CodestreamContext& cs, ImageContext& image);
+
+ private:
+  ImageContext decode(const CodestreamContext& cs, const ImageFormat& format);
+
+  std::vector<uint8_t> planes_[3];
+};
+
+}  // namespace libench
+
+#endif
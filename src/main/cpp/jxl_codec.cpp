@@ -1,7 +1,11 @@
 #include "jxl_codec.h"
+#include "allocator.h"
 #include "jxl/decode_cxx.h"
 #include "jxl/encode_cxx.h"
+#include "jxl/memory_manager.h"
 #include "jxl/types.h"
+#include "trace.h"
+#include <algorithm>
 #include <climits>
 #include <cstdlib>
 #include <inttypes.h>
@@ -10,6 +14,21 @@
 #include <stdexcept>
 #include <vector>
 
+/*
+ * the allocations of libjxl go through the selected allocator backend (see
+ * allocator.h)
+ */
+
+static void* jxl_alloc(void*, size_t size) {
+  return libench_malloc(size);
+}
+
+static void jxl_free(void*, void* address) {
+  libench_free(address);
+}
+
+static JxlMemoryManager jxl_memory_manager = {NULL, &jxl_alloc, &jxl_free};
+
 /*
  * JXLEncoder
  */
@@ -20,14 +39,17 @@ template class libench::JXLEncoder<3>;
 
 template <int E> libench::JXLEncoder<E>::JXLEncoder(){}
 
-template <int E> libench::JXLEncoder<E>::~JXLEncoder() {
-  free(this->cb_.codestream);
-}
+template <int E> libench::JXLEncoder<E>::~JXLEncoder() {}
+
+static const size_t JXL_INITIAL_OUTPUT_SIZE = 16 << 20;
 
 template <int E, bool rgba>
-static size_t JxlEncode(void *image_data, size_t width, size_t height,
-                        uint8_t **encoded) {
-  auto enc = JxlEncoderMake(/*memory_manager=*/nullptr);
+static void JxlEncode(void *image_data, size_t width, size_t height,
+                      libench::OutputBuffer &out) {
+  /* declared first, so that the arena is rewound after the encoder is destroyed */
+  libench::ArenaScope scope;
+
+  auto enc = JxlEncoderMake(&jxl_memory_manager);
 
   JxlPixelFormat pixel_format = {rgba ? 4 : 3, JXL_TYPE_UINT8,
                                  JXL_NATIVE_ENDIAN, 0};
@@ -74,44 +96,60 @@ static size_t JxlEncode(void *image_data, size_t width, size_t height,
   }
   JxlEncoderCloseInput(enc.get());
 
-  size_t size = pixel_format.num_channels * width * height;
-  *encoded = (uint8_t *)malloc(size);
-  uint8_t *next_out = *encoded;
-  size_t avail_out = size - (next_out - *encoded);
+  /* the output buffer grows as needed, starting no larger than the raw image */
+  /* the output is written directly into the buffer, whose existing capacity is used first */
+  out.reserve(std::min(pixel_format.num_channels * width * height, JXL_INITIAL_OUTPUT_SIZE));
+  out.resize(out.capacity());
+  uint8_t *next_out = out.data();
+  size_t avail_out = out.size();
   JxlEncoderStatus process_result = JXL_ENC_NEED_MORE_OUTPUT;
   while (process_result == JXL_ENC_NEED_MORE_OUTPUT) {
+    LIBENCH_TRACE_SPAN("JxlEncoderProcessOutput");
+
     process_result = JxlEncoderProcessOutput(enc.get(), &next_out, &avail_out);
     if (process_result == JXL_ENC_NEED_MORE_OUTPUT) {
-      size_t offset = next_out - *encoded;
-      size *= 2;
-      *encoded = (uint8_t *)realloc(*encoded, size);
-      next_out = *encoded + offset;
-      avail_out = size - offset;
+      size_t offset = next_out - out.data();
+      out.resize(2 * out.size());
+      next_out = out.data() + offset;
+      avail_out = out.size() - offset;
     }
   }
   if (JXL_ENC_SUCCESS != process_result) {
     throw std::runtime_error("JxlEncoderProcessOutput failed\n");
   }
 
-  return next_out - *encoded;
+  out.resize(next_out - out.data());
 }
 
 template <int E>
 libench::CodestreamContext
 libench::JXLEncoder<E>::encodeRGB8(const ImageContext &image) {
-  free(this->cb_.codestream);
-  cb_.size = JxlEncode<E, false>(image.planes8[0], image.width, image.height,
-                                 &cb_.codestream);
-  return this->cb_;
+  return this->encodeInto(image, this->out_);
 }
 
 template <int E>
 libench::CodestreamContext
 libench::JXLEncoder<E>::encodeRGBA8(const ImageContext &image) {
-  free(this->cb_.codestream);
-  cb_.size = JxlEncode<E, true>(image.planes8[0], image.width, image.height,
-                                &cb_.codestream);
-  return this->cb_;
+  return this->encodeInto(image, this->out_);
+}
+
+template <int E>
+libench::CodestreamContext
+libench::JXLEncoder<E>::encodeInto(const ImageContext &image, OutputBuffer &out) {
+  if (image.format == libench::ImageFormat::RGB8) {
+    JxlEncode<E, false>(image.planes8[0], image.width, image.height, out);
+  } else if (image.format == libench::ImageFormat::RGBA8) {
+    JxlEncode<E, true>(image.planes8[0], image.width, image.height, out);
+  } else {
+    throw std::runtime_error("Unsupported image format");
+  }
+
+  libench::CodestreamContext cs;
+
+  cs.codestream = out.data();
+  cs.size = out.size();
+
+  return cs;
 }
 
 /*
@@ -122,22 +160,40 @@ libench::JXLDecoder::JXLDecoder(){}
 
 libench::ImageContext
 libench::JXLDecoder::decodeRGB8(const CodestreamContext &cs) {
-  return this->decode8(cs, 3);
+  libench::ImageContext image;
+  image.format = libench::ImageFormat::RGB8;
+  this->decode8(cs, image, false);
+  return image;
 }
 
 libench::ImageContext
 libench::JXLDecoder::decodeRGBA8(const CodestreamContext &cs) {
-  return this->decode8(cs, 4);
+  libench::ImageContext image;
+  image.format = libench::ImageFormat::RGBA8;
+  this->decode8(cs, image, false);
+  return image;
 }
 
-libench::ImageContext libench::JXLDecoder::decode8(const CodestreamContext &cs,
-                                                   uint8_t num_comps) {
-  libench::ImageContext image;
+void libench::JXLDecoder::decodeInto(const CodestreamContext &cs,
+                                     ImageContext &image) {
+  if (!(image.format == libench::ImageFormat::RGB8 ||
+        image.format == libench::ImageFormat::RGBA8)) {
+    throw std::runtime_error("Unsupported image format");
+  }
+  this->decode8(cs, image, true);
+}
+
+/*
+ * decodes into the planes of image if is_preallocated, in which case its
+ * dimensions must match, or into pixels_ otherwise
+ */
+void libench::JXLDecoder::decode8(const CodestreamContext &cs,
+                                  ImageContext &image, bool is_preallocated) {
+  uint32_t num_comps = image.format.comps.num_comps;
 
-  image.format =
-      num_comps == 3 ? libench::ImageFormat::RGB8 : libench::ImageFormat::RGBA8;
+  libench::ArenaScope scope;
 
-  auto dec = JxlDecoderMake(nullptr);
+  auto dec = JxlDecoderMake(&jxl_memory_manager);
   if (JXL_DEC_SUCCESS !=
       JxlDecoderSubscribeEvents(dec.get(), JXL_DEC_BASIC_INFO |
                                                JXL_DEC_COLOR_ENCODING |
@@ -152,7 +208,13 @@ libench::ImageContext libench::JXLDecoder::decode8(const CodestreamContext &cs,
   JxlDecoderCloseInput(dec.get());
 
   for (;;) {
-    JxlDecoderStatus status = JxlDecoderProcessInput(dec.get());
+    JxlDecoderStatus status;
+
+    {
+      LIBENCH_TRACE_SPAN("JxlDecoderProcessInput");
+
+      status = JxlDecoderProcessInput(dec.get());
+    }
 
     if (status == JXL_DEC_ERROR) {
       throw std::runtime_error("Decoder error\n");
@@ -162,8 +224,12 @@ libench::ImageContext libench::JXLDecoder::decode8(const CodestreamContext &cs,
       if (JXL_DEC_SUCCESS != JxlDecoderGetBasicInfo(dec.get(), &info)) {
         throw std::runtime_error("JxlDecoderGetBasicInfo failed\n");
       }
-      image.width = info.xsize;
-      image.height = info.ysize;
+      if (!is_preallocated) {
+        image.width = info.xsize;
+        image.height = info.ysize;
+      } else if (image.width != info.xsize || image.height != info.ysize) {
+        throw std::runtime_error("Destination image does not match the codestream");
+      }
     } else if (status == JXL_DEC_COLOR_ENCODING) {
       // Get the ICC color profile of the pixel data (but ignore it)
       size_t icc_size;
@@ -184,15 +250,16 @@ libench::ImageContext libench::JXLDecoder::decode8(const CodestreamContext &cs,
           JxlDecoderImageOutBufferSize(dec.get(), &format, &buffer_size)) {
         throw std::runtime_error("JxlDecoderImageOutBufferSize failed\n");
       }
-      if (buffer_size != image.height * image.width * num_comps) {
+      if (buffer_size != (size_t) image.height * image.width * num_comps) {
         throw std::runtime_error("Invalid out buffer size");
       }
-      this->pixels_.resize(image.height * image.width * num_comps);
-      void *pixels_buffer = (void *)this->pixels_.data();
-      size_t pixels_buffer_size = this->pixels_.size() * sizeof(float);
+      if (!is_preallocated) {
+        this->pixels_.resize(buffer_size);
+        image.planes8[0] = this->pixels_.data();
+      }
       if (JXL_DEC_SUCCESS != JxlDecoderSetImageOutBuffer(dec.get(), &format,
-                                                         pixels_buffer,
-                                                         pixels_buffer_size)) {
+                                                         image.planes8[0],
+                                                         buffer_size)) {
         throw std::runtime_error("JxlDecoderSetImageOutBuffer failed\n");
       }
     } else if (status == JXL_DEC_FULL_IMAGE) {
@@ -208,7 +275,4 @@ libench::ImageContext libench::JXLDecoder::decode8(const CodestreamContext &cs,
     }
   }
 
-  image.planes8[0] = this->pixels_.data();
-
-  return image;
 }
@@ -16,10 +16,10 @@ class JXLEncoder : public Encoder {
 
   CodestreamContext encodeRGBA8(const ImageContext &image);
 
- private:
-  CodestreamContext encode8(const ImageContext &image, uint8_t num_comps);
+  CodestreamContext encodeInto(const ImageContext &image, OutputBuffer &out);
 
-  CodestreamContext cb_;
+ private:
+  OutputBuffer out_;
 };
 
 class JXLDecoder : public Decoder {
@@ -31,8 +31,10 @@ class JXLDecoder : public Decoder {
 
   virtual ImageContext decodeRGBA8(const CodestreamContext& cs);
 
+  virtual void decodeInto(const CodestreamContext& cs, ImageContext& image);
+
  private:
-  ImageContext decode8(const CodestreamContext& cs, uint8_t num_comps);
+  void decode8(const CodestreamContext& cs, ImageContext& image, bool is_preallocated);
 
   std::vector<uint8_t> pixels_;
 };
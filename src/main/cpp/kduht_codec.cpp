@@ -31,23 +31,33 @@ class error_message_handler : public kdu_core::kdu_message {
 
 static error_message_handler error_handler;
 
+/* bounds on the stripe heights used when streaming */
+static const int KDU_MIN_STRIPE_HEIGHT = 8;
+static const int KDU_MAX_STRIPE_HEIGHT = 1024;
+
 libench::KDUEncoder::KDUEncoder(bool isHT) : isHT_(isHT){
   kdu_core::kdu_customize_errors(&error_handler);
 }
 
 libench::CodestreamContext libench::KDUEncoder::encodeRGB8(const ImageContext &image) {
-  return this->encode(image);
+  return this->encodeInto(image, this->out_);
 }
 
 libench::CodestreamContext libench::KDUEncoder::encodeRGBA8(const ImageContext &image) {
-  return this->encode(image);
+  return this->encodeInto(image, this->out_);
 }
 
 libench::CodestreamContext libench::KDUEncoder::encodeYUV(const ImageContext &image) {
-  return this->encode(image);
+  return this->encodeInto(image, this->out_);
+}
+
+bool libench::KDUEncoder::setOutputFile(const std::string& path) {
+  this->out_path_ = path;
+
+  return true;
 }
 
-libench::CodestreamContext libench::KDUEncoder::encode(const ImageContext &image) {
+libench::CodestreamContext libench::KDUEncoder::encodeInto(const ImageContext &image, OutputBuffer& out) {
   siz_params siz;
   siz.set(Scomponents, 0, 0, image.format.comps.num_comps);
   for(uint8_t i = 0; i < image.format.num_planes(); i++) {
@@ -58,11 +68,20 @@ libench::CodestreamContext libench::KDUEncoder::encode(const ImageContext &image
   siz.set(Ssigned, 0, 0, false);
   static_cast<kdu_params&>(siz).finalize();
 
-  this->out_.close();
+  bool is_streaming = !this->out_path_.empty();
+
+  kdu_compressed_target* target = &this->mem_out_;
+
+  if (is_streaming) {
+    this->file_out_.open(this->out_path_);
+    target = &this->file_out_;
+  } else {
+    this->mem_out_.open(&out);
+  }
 
   kdu_codestream codestream;
 
-  codestream.create(&siz, &this->out_);
+  codestream.create(&siz, target);
 
   codestream.set_disabled_auto_comments(0xFFFFFFFF);
 
@@ -91,22 +110,56 @@ libench::CodestreamContext libench::KDUEncoder::encode(const ImageContext &image
 
     int precisions[4];
     bool is_signed[4];
+    kdu_int16* stripes[4];
 
     for(uint8_t i = 0; i < image.format.comps.num_comps; i++) {
       precisions[i] = (int) image.format.bit_depth;
       is_signed[i] = false;
+      stripes[i] = (kdu_int16*) image.planes16[i];
+    }
+
+    bool is_pushing = true;
+
+    while (is_pushing) {
+      if (is_streaming)
+        compressor.get_recommended_stripe_heights(KDU_MIN_STRIPE_HEIGHT, KDU_MAX_STRIPE_HEIGHT, stripe_heights, NULL);
+
+      is_pushing = compressor.push_stripe(stripes, stripe_heights, NULL, NULL, precisions, is_signed);
+
+      for(uint8_t i = 0; i < image.format.comps.num_comps; i++)
+        stripes[i] += (size_t) stripe_heights[i] * (image.width / image.format.x_sub_factor[i]);
     }
-    compressor.push_stripe((kdu_int16 **) image.planes16, stripe_heights, NULL, NULL, precisions, is_signed);
 
   } else if ((!image.format.is_planar) && (!image.is_plane16())) {
-    compressor.push_stripe((kdu_byte*)image.planes8[0], stripe_heights);
+    kdu_byte* stripe = (kdu_byte*) image.planes8[0];
+
+    bool is_pushing = true;
+
+    while (is_pushing) {
+      if (is_streaming)
+        compressor.get_recommended_stripe_heights(KDU_MIN_STRIPE_HEIGHT, KDU_MAX_STRIPE_HEIGHT, stripe_heights, NULL);
+
+      is_pushing = compressor.push_stripe(stripe, stripe_heights);
+
+      stripe += (size_t) stripe_heights[0] * image.line_size(0);
+    }
   }
   compressor.finish();
 
+  codestream.destroy();
+
   libench::CodestreamContext cb;
 
-  cb.codestream = this->out_.get_buffer().data();
-  cb.size = this->out_.get_buffer().size();
+  if (is_streaming) {
+    this->file_out_.close();
+
+    cb.size = this->file_out_.size();
+
+    return cb;
+  }
+
+  cb.codestream = out.data();
+  cb.size = out.size();
 
   return cb;
 }
@@ -118,18 +171,32 @@ libench::CodestreamContext libench::KDUEncoder::encode(const ImageContext &image
 libench::KDUDecoder::KDUDecoder(){}
 
 libench::ImageContext libench::KDUDecoder::decodeRGB8(const CodestreamContext& cs) {
-  return this->decode(cs);
+  libench::ImageContext image;
+  this->decode(cs, image, false);
+  return image;
 }
 
 libench::ImageContext libench::KDUDecoder::decodeRGBA8(const CodestreamContext& cs) {
-  return this->decode(cs);
+  libench::ImageContext image;
+  this->decode(cs, image, false);
+  return image;
 }
 
 libench::ImageContext libench::KDUDecoder::decodeYUV(const CodestreamContext& cs) {
-  return this->decode(cs);
+  libench::ImageContext image;
+  this->decode(cs, image, false);
+  return image;
+}
+
+void libench::KDUDecoder::decodeInto(const CodestreamContext& cs, ImageContext& image) {
+  this->decode(cs, image, true);
 }
 
-libench::ImageContext libench::KDUDecoder::decode(const CodestreamContext& cs) {
+/*
+ * decodes into the planes of image if is_preallocated, in which case its
+ * dimensions must match the codestream, or into planes_ otherwise
+ */
+void libench::KDUDecoder::decode(const CodestreamContext& cs, ImageContext& dest, bool is_preallocated) {
   libench::ImageContext image;
 
   kdu_compressed_source_buffered buffer((kdu_byte*)cs.codestream, cs.size);
@@ -173,6 +240,23 @@ libench::ImageContext libench::KDUDecoder::decode(const CodestreamContext& cs) {
     image.format.comps = libench::ImageComponents::RGBA;
   }
 
+  if (is_preallocated) {
+    if (dest.width != image.width || dest.height != image.height
+        || dest.format.is_planar != image.format.is_planar
+        || dest.format.num_planes() != image.format.num_planes()
+        || dest.format.bit_depth != image.format.bit_depth) {
+      throw std::runtime_error("Destination image does not match the codestream");
+    }
+
+    for(uint8_t i = 0; i < image.format.num_planes(); i++)
+      image.planes8[i] = dest.planes8[i];
+  } else {
+    for(uint8_t i = 0; i < image.format.num_planes(); i++) {
+      this->planes_[i].resize(image.plane_size(i));
+      image.planes8[i] = this->planes_[i].data();
+    }
+  }
+
   kdu_stripe_decompressor d;
 
   int stripe_heights[4] = {(int) image.height, (int) image.height, (int) image.height, (int) image.height};
@@ -185,8 +269,6 @@ libench::ImageContext libench::KDUDecoder::decode(const CodestreamContext& cs) {
     bool is_signed[4];
 
     for(int i = 0; i < num_comps; i++) {
-      this->planes_[i].resize(image.plane_size(i));
-      image.planes16[i] = (uint16_t*) this->planes_[i].data();
       precisions[i] = (int) image.format.bit_depth;
       is_signed[i] = false;
     }
@@ -195,22 +277,22 @@ libench::ImageContext libench::KDUDecoder::decode(const CodestreamContext& cs) {
       throw std::runtime_error("Only YUV 10 bits supported.");
     }
 
-    kdu_int16 *planes[3] = {(kdu_int16*) this->planes_[0].data(),
-                            (kdu_int16*) this->planes_[1].data(),
-                            (kdu_int16*) this->planes_[2].data()};
+    kdu_int16 *planes[3] = {(kdu_int16*) image.planes16[0],
+                            (kdu_int16*) image.planes16[1],
+                            (kdu_int16*) image.planes16[2]};
 
     d.pull_stripe(planes, stripe_heights, NULL, NULL, precisions, is_signed);
 
   } else {
 
-    this->planes_[0].resize(image.plane_size(0));
-    image.planes8[0] = this->planes_[0].data();
-
-    d.pull_stripe(this->planes_[0].data(), stripe_heights);
+    d.pull_stripe(image.planes8[0], stripe_heights);
 
   }
 
   d.finish();
 
-  return image;
+  c.destroy();
+
+  if (!is_preallocated)
+    dest = image;
 }
@@ -1,6 +1,8 @@
 #ifndef LIBENCH_KDUHT_H
 #define LIBENCH_KDUHT_H
 
+#include <cstdio>
+#include <string>
 #include <vector>
 #include "codec.h"
 #include "kdu_elementary.h"
@@ -13,26 +15,65 @@ using namespace kdu_supp;
 
 class mem_compressed_target : public kdu_compressed_target {
  public:
-  mem_compressed_target() {}
+  mem_compressed_target() : out_(NULL) {}
+
+  void open(OutputBuffer* out) {
+    this->out_ = out;
+    this->out_->clear();
+  }
 
   bool close() {
-    this->buf.clear();
     return true;
   }
 
   bool write(const kdu_byte* buf, int num_bytes) {
-    std::copy(buf, buf + num_bytes, std::back_inserter(this->buf));
+    this->out_->append(buf, num_bytes);
     return true;
   }
 
-  void set_target_size(kdu_long num_bytes) { this->buf.reserve(num_bytes); }
+  void set_target_size(kdu_long num_bytes) { this->out_->reserve(num_bytes); }
 
   bool prefer_large_writes() const { return false; }
 
-  std::vector<uint8_t>& get_buffer() { return this->buf; }
+ private:
+  OutputBuffer* out_;
+};
+
+class file_compressed_target : public kdu_compressed_target {
+ public:
+  file_compressed_target() : f_(NULL), size_(0) {}
+
+  ~file_compressed_target() { this->close(); }
+
+  void open(const std::string& path) {
+    this->close();
+
+    this->f_ = fopen(path.c_str(), "wb");
+    if (!this->f_)
+      throw std::runtime_error("Cannot open file: " + path);
+
+    this->size_ = 0;
+  }
+
+  bool close() {
+    if (this->f_)
+      fclose(this->f_);
+    this->f_ = NULL;
+    return true;
+  }
+
+  bool write(const kdu_byte* buf, int num_bytes) {
+    this->size_ += num_bytes;
+    return fwrite(buf, 1, num_bytes, this->f_) == (size_t) num_bytes;
+  }
+
+  bool prefer_large_writes() const { return true; }
+
+  size_t size() const { return this->size_; }
 
  private:
-  std::vector<uint8_t> buf;
+  FILE* f_;
+  size_t size_;
 };
 
 class KDUEncoder : public Encoder {
@@ -45,10 +86,16 @@ class KDUEncoder : public Encoder {
 
   virtual CodestreamContext encodeYUV(const ImageContext &image);
 
- private:
-  CodestreamContext encode(const ImageContext &image);
+  virtual CodestreamContext encodeInto(const ImageContext &image, OutputBuffer& out);
 
-  mem_compressed_target out_;
+  /* the image is pushed in stripes, instead of all at once, when writing to a file */
+  virtual bool setOutputFile(const std::string& path);
+
+ private:
+  OutputBuffer out_;
+  mem_compressed_target mem_out_;
+  file_compressed_target file_out_;
+  std::string out_path_;
   bool isHT_;
 };
 
@@ -62,10 +109,12 @@ class KDUDecoder : public Decoder {
 
   virtual ImageContext decodeYUV(const CodestreamContext& cs);
 
+  virtual void decodeInto(const CodestreamContext& cs, ImageContext& image);
+
  private:
-  ImageContext decode(const CodestreamContext& cs);
+  void decode(const CodestreamContext& cs, ImageContext& image, bool is_preallocated);
 
-  std::vector<uint8_t> planes_[3];
+  std::vector<uint8_t> planes_[4];
 };
 
 }  // namespace libench
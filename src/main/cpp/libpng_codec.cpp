@@ -0,0 +1,258 @@
+#ifdef LIBENCH_HAS_LIBPNG
+
+#include "libpng_codec.h"
+#include "allocator.h"
+#include <csetjmp>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+/*
+ * libpng reports errors by longjmp to the point set with setjmp(png_jmpbuf()),
+ * so the calls into libpng are made from functions that hold no objects with
+ * destructors and that return false on error, which the callers then throw.
+ */
+
+/* libpng allocations are served from the arena of the calling thread */
+
+static png_voidp png_malloc_fn(png_structp png, png_alloc_size_t size) {
+  return libench_malloc(size);
+}
+
+static void png_free_fn(png_structp png, png_voidp ptr) {
+  libench_free(ptr);
+}
+
+/*
+ * libpng writer that appends to an OutputBuffer; exceptions must not cross
+ * the setjmp frames of libpng, so errors are recorded and reported through
+ * png_error() instead
+ */
+
+struct WriteState {
+  libench::OutputBuffer* out;
+  bool is_out_of_memory;
+};
+
+static void write_output(png_structp png, png_bytep data, size_t size) {
+  WriteState* state = static_cast<WriteState*>(png_get_io_ptr(png));
+
+  try {
+    state->out->append(data, size);
+  } catch (const std::bad_alloc&) {
+    state->is_out_of_memory = true;
+  }
+
+  if (state->is_out_of_memory)
+    png_error(png, "Cannot allocate memory");
+}
+
+static void flush_output(png_structp png) {}
+
+/* libpng reader from a codestream in memory */
+
+struct ReadState {
+  const uint8_t* data;
+  size_t size;
+  size_t offset;
+};
+
+static void read_input(png_structp png, png_bytep data, size_t size) {
+  ReadState* state = static_cast<ReadState*>(png_get_io_ptr(png));
+
+  if (size > state->size - state->offset)
+    png_error(png, "Truncated codestream");
+
+  memcpy(data, state->data + state->offset, size);
+  state->offset += size;
+}
+
+static bool write_png(png_structp png, png_infop info, const libench::ImageContext& image, int level, png_bytep* rows) {
+  if (setjmp(png_jmpbuf(png)))
+    return false;
+
+  png_set_compression_level(png, level);
+
+  png_set_IHDR(png, info, image.width, image.height, 8,
+               image.format.comps.num_comps == 3 ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_RGB_ALPHA,
+               PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+  png_write_info(png, info);
+  png_write_image(png, rows);
+  png_write_end(png, NULL);
+
+  return true;
+}
+
+/* converts any PNG to 8-bit RGB or RGBA, as lodepng does */
+static bool read_png_info(png_structp png, png_infop info, int num_comps) {
+  if (setjmp(png_jmpbuf(png)))
+    return false;
+
+  png_read_info(png, info);
+
+  png_set_expand(png);
+  png_set_strip_16(png);
+  png_set_gray_to_rgb(png);
+
+  if (num_comps == 3) {
+    png_set_strip_alpha(png);
+  } else {
+    png_set_add_alpha(png, 0xFF, PNG_FILLER_AFTER);
+  }
+
+  png_set_interlace_handling(png);
+
+  png_read_update_info(png, info);
+
+  return true;
+}
+
+static bool read_png_image(png_structp png, png_infop info, png_bytep* rows) {
+  if (setjmp(png_jmpbuf(png)))
+    return false;
+
+  png_read_image(png, rows);
+  png_read_end(png, NULL);
+
+  return true;
+}
+
+/*
+ * LibPNGEncoder
+ */
+
+libench::LibPNGEncoder::LibPNGEncoder(int level) : level_(level) {
+  if (level < 0 || level > 9)
+    throw std::runtime_error("libpng compression level must be between 0 and 9");
+}
+
+libench::CodestreamContext libench::LibPNGEncoder::encodeRGB8(const ImageContext &image) {
+  return this->encodeInto(image, this->out_);
+}
+
+libench::CodestreamContext libench::LibPNGEncoder::encodeRGBA8(const ImageContext &image) {
+  return this->encodeInto(image, this->out_);
+}
+
+libench::CodestreamContext libench::LibPNGEncoder::encodeInto(const ImageContext &image, OutputBuffer& out) {
+  if (!(image.format == libench::ImageFormat::RGB8 || image.format == libench::ImageFormat::RGBA8))
+    throw std::runtime_error("Unsupported image format");
+
+  ArenaScope scope;
+
+  this->rows_.resize(image.height);
+  for (uint32_t y = 0; y < image.height; y++)
+    this->rows_[y] = image.planes8[0] + y * image.line_size(0);
+
+  png_structp png = png_create_write_struct_2(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL,
+                                              NULL, png_malloc_fn, png_free_fn);
+  png_infop info = png ? png_create_info_struct(png) : NULL;
+
+  if (! info) {
+    png_destroy_write_struct(&png, NULL);
+    throw std::runtime_error("PNG encode failed");
+  }
+
+  out.clear();
+
+  WriteState state = {&out, false};
+
+  png_set_write_fn(png, &state, write_output, flush_output);
+
+  bool is_written = write_png(png, info, image, this->level_, this->rows_.data());
+
+  png_destroy_write_struct(&png, &info);
+
+  if (state.is_out_of_memory)
+    throw std::bad_alloc();
+
+  if (! is_written)
+    throw std::runtime_error("PNG encode failed");
+
+  libench::CodestreamContext cs;
+
+  cs.codestream = out.data();
+  cs.size = out.size();
+
+  return cs;
+}
+
+/*
+ * LibPNGDecoder
+ */
+
+libench::LibPNGDecoder::LibPNGDecoder() {
+}
+
+libench::ImageContext libench::LibPNGDecoder::decodeRGB8(const CodestreamContext& cs) {
+  return this->decode8(cs, libench::ImageFormat::RGB8);
+}
+
+libench::ImageContext libench::LibPNGDecoder::decodeRGBA8(const CodestreamContext& cs) {
+  return this->decode8(cs, libench::ImageFormat::RGBA8);
+}
+
+libench::ImageContext libench::LibPNGDecoder::decode8(const CodestreamContext& cs, const ImageFormat& format) {
+  /* the IHDR chunk, which immediately follows the signature, starts with the width and height */
+  if (cs.size < 24 || png_sig_cmp(cs.codestream, 0, 8))
+    throw std::runtime_error("PNG decode failed");
+
+  libench::ImageContext image;
+
+  image.format = format;
+  image.width = png_get_uint_32(cs.codestream + 16);
+  image.height = png_get_uint_32(cs.codestream + 20);
+
+  this->pixels_.resize(image.plane_size(0));
+  image.planes8[0] = this->pixels_.data();
+
+  this->decodeInto(cs, image);
+
+  return image;
+}
+
+void libench::LibPNGDecoder::decodeInto(const CodestreamContext& cs, ImageContext& image) {
+  if (!(image.format == libench::ImageFormat::RGB8 || image.format == libench::ImageFormat::RGBA8))
+    throw std::runtime_error("Unsupported image format");
+
+  ArenaScope scope;
+
+  png_structp png = png_create_read_struct_2(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL,
+                                             NULL, png_malloc_fn, png_free_fn);
+  png_infop info = png ? png_create_info_struct(png) : NULL;
+
+  if (! info) {
+    png_destroy_read_struct(&png, NULL, NULL);
+    throw std::runtime_error("PNG decode failed");
+  }
+
+  ReadState state = {cs.codestream, cs.size, 0};
+
+  png_set_read_fn(png, &state, read_input);
+
+  if (! read_png_info(png, info, image.format.comps.num_comps)) {
+    png_destroy_read_struct(&png, &info, NULL);
+    throw std::runtime_error("PNG decode failed");
+  }
+
+  if (png_get_image_width(png, info) != image.width || png_get_image_height(png, info) != image.height
+      || png_get_rowbytes(png, info) != image.line_size(0)) {
+    png_destroy_read_struct(&png, &info, NULL);
+    throw std::runtime_error("Destination image does not match the codestream");
+  }
+
+  /* libpng decodes directly into the destination rows */
+  this->rows_.resize(image.height);
+  for (uint32_t y = 0; y < image.height; y++)
+    this->rows_[y] = image.planes8[0] + y * image.line_size(0);
+
+  bool is_read = read_png_image(png, info, this->rows_.data());
+
+  png_destroy_read_struct(&png, &info, NULL);
+
+  if (! is_read)
+    throw std::runtime_error("PNG decode failed");
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef LIBENCH_LIBPNG_H
+#define LIBENCH_LIBPNG_H
+
+#include <vector>
+#include "codec.h"
+
+#include "png.h"
+
+namespace libench {
+
+/* PNG codec based on libpng, built over zlib-ng */
+
+class LibPNGEncoder : public Encoder {
+ public:
+  /* level is the zlib compression level, from 0 (none) to 9 (best) */
+  explicit LibPNGEncoder(int level = 6);
+
+  CodestreamContext encodeRGB8(const ImageContext &image);
+
+  CodestreamContext encodeRGBA8(const ImageContext &image);
+
+  CodestreamContext encodeInto(const ImageContext &image, OutputBuffer& out);
+
+ private:
+  int level_;
+  OutputBuffer out_;
+  std::vector<png_bytep> rows_;
+};
+
+class LibPNGDecoder : public Decoder {
+ public:
+  LibPNGDecoder();
+
+  virtual ImageContext decodeRGB8(const CodestreamContext& cs);
+
+  virtual ImageContext decodeRGBA8(const CodestreamContext& cs);
+
+  virtual void decodeInto(const CodestreamContext& cs, ImageContext& image);
+
+  /* reported since png_fpnge also decodes with it */
+  std::string backend() const override {
+    return "libpng";
+  }
+
+ private:
+  ImageContext decode8(const CodestreamContext& cs, const ImageFormat& format);
+
+  std::vector<uint8_t> pixels_;
+  std::vector<png_bytep> rows_;
+};
+
+}  // namespace libench
+
+#endif
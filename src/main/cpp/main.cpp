@@ -1,13 +1,21 @@
 #include "cxxopts.hpp"
-#include "avif_codec.h"
-#include "ffv1_codec.h"
-#include "jxl_codec.h"
-#include "kduht_codec.h"
-#include "ojph_codec.h"
-#include "png_codec.h"
-#include "qoi_codec.h"
-#include "webp_codec.h"
+#include "allocator.h"
+#include "codec_factory.h"
+#include "cache_control.h"
+#include "codestream_archive.h"
+#include "cold_start.h"
+#include "image_io.h"
+#include "isa.h"
+#include "pipeline.h"
+#include "profiler.h"
+#include "run_record.h"
+#include "sampling.h"
+#include "serve.h"
+#include "test_context.h"
+#include "trace.h"
+#include "transcode.h"
 #include <chrono>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -15,275 +23,688 @@
 #include <stdio.h>
 #include <time.h>
 
-#define STB_IMAGE_IMPLEMENTATION
-#define STBI_ONLY_PNG
-#define STBI_NO_LINEAR
-#include "stb_image.h"
-
-struct TestContext {
-  libench::ImageContext image;
-  uint8_t image_hash[MD5_BLOCK_SIZE];
-  std::string codestream_path;
-  uint32_t image_sz;
-  uint32_t codestream_sz;
-  std::vector<std::chrono::system_clock::time_point::duration> encode_times;
-  std::vector<std::chrono::system_clock::time_point::duration> decode_times;
-};
-
-std::ostream& operator<<(std::ostream& os, const TestContext& ctx) {
-  os << "{" << std::endl;
-
-  os << "\"decodeTimes\" : [";
-  for (const auto& t : ctx.decode_times) {
-    os << std::chrono::duration<double>(t).count();
-    if (&t != &ctx.decode_times.back()) {
-      os << ", ";
-    }
+/* reads a list of paths, one per line */
+static std::vector<std::string> read_path_list(const std::string& list_path) {
+  std::ifstream list_file(list_path);
+  if (! list_file) {
+    throw std::runtime_error("Cannot open list file: " + list_path);
   }
-  os << "]," << std::endl;
 
-  os << "\"encodeTimes\" : [";
-  for (const auto& t : ctx.encode_times) {
-    os << std::chrono::duration<double>(t).count();
-    if (&t != &ctx.encode_times.back()) {
-      os << ", ";
+  std::vector<std::string> paths;
+  std::string line;
+
+  while (std::getline(list_file, line)) {
+    if (! line.empty()) {
+      paths.push_back(line);
     }
   }
-  os << "]," << std::endl;
 
-  os << "\"imageSize\" : " << ctx.image_sz << "," << std::endl;
+  return paths;
+}
 
-  os << "\"codestreamSize\" : " << ctx.codestream_sz << ","  << std::endl;
+int main(int argc, char* argv[]) {
+  /* measured by cold-start child processes, before anything else runs */
+  auto main_entry = std::chrono::steady_clock::now();
 
-  os << "\"imageWidth\" : " << ctx.image.width  << "," << std::endl;
+  cxxopts::Options options("libench", "Lossless image codec benchmark");
+
+  options.add_options()("dir", "Codestream directory path",
+                        cxxopts::value<std::string>())(
+      "r,repetitions", "Number of repetitions, or minimum number of repetitions with --precision or --time-budget",
+      cxxopts::value<int>()->default_value("5"))(
+      "precision", "Repeat until the 95% confidence interval of the mean encode and decode times is within the specified fraction of the mean, e.g. 0.02",
+      cxxopts::value<double>()->default_value("0"))(
+      "time-budget", "Repeat until the specified number of seconds has elapsed, or --precision is reached",
+      cxxopts::value<double>()->default_value("0"))(
+      "max-repetitions", "Maximum number of repetitions with --precision or --time-budget",
+      cxxopts::value<int>()->default_value("1000"))(
+      "min-sample-time", "Time consecutive calls together so that each sample lasts at least the specified number of milliseconds; defaults to 1 with --precision or --time-budget and 0 otherwise",
+      cxxopts::value<double>())(
+      "file", "Input image", cxxopts::value<std::string>())(
+      "codec", "Codec to profile", cxxopts::value<std::string>())(
+      "o,option", "Codec option of the form key=value",
+      cxxopts::value<std::vector<std::string>>())(
+      "batch", "Path of a file listing input images, one per line, that are run through a pipeline of load, encode, decode and verify threads",
+      cxxopts::value<std::string>())(
+      "queue-capacity", "Capacity of the queues between pipeline stages",
+      cxxopts::value<int>()->default_value("4"))(
+      "archive", "Path of a codestream archive to which the codestream is added, or from which it is read with --decode-only",
+      cxxopts::value<std::string>())(
+      "decode-only", "Decode the codestream of the image found in the archive instead of encoding the image")(
+      "hash-only", "Print the hash of the image at the specified path and exit",
+      cxxopts::value<std::string>())(
+      "list-codecs", "Print the names of the codecs that libench was built with, one per line, and exit")(
+      "build-info", "Print the libench version, compiler flags and submodule revisions that libench was built with, and the library of each codec, as JSON, and exit")(
+      "out-of-core", "Memory-map the raw YUV image and have the encoder stream it and write the codestream to the specified path",
+      cxxopts::value<std::string>())(
+      "into", "Encode and decode into caller-owned buffers that are reused across repetitions")(
+      "cold", "Also time each encode and decode after evicting the caches, by sweeping a buffer larger than the last-level cache (sweep) or flushing the source and codestream (clflush)",
+      cxxopts::value<std::string>()->implicit_value("sweep"))(
+      "fresh-source", "With --cold, place the source image in a fresh mapping before each cold encode")(
+      "pages", "Back the source image and, with --into, the codestream and decoded image with 4 KiB pages (4k), transparent huge pages (thp) or hugetlbfs pages (hugetlbfs) instead of malloc",
+      cxxopts::value<std::string>())(
+      "allocator", "Backend of the internal allocations of the codecs that expose an allocator hook (PNG, QOI, JPEG XL): glibc, arena, jemalloc or mimalloc",
+      cxxopts::value<std::string>()->default_value("arena"))(
+      "isa", "Cap the SIMD instruction set used by the codec libraries at scalar, sse4, avx2 or avx512, or leave them uncapped (native)",
+      cxxopts::value<std::string>()->default_value("native"))(
+      "jsonl", "Append a JSON Lines record of each run, flushed as soon as the run completes, to the specified file or, if -, write it to stdout instead of the default output",
+      cxxopts::value<std::string>())(
+      "set-name", "Name of the image set, recorded in the JSON Lines records",
+      cxxopts::value<std::string>()->default_value(""))(
+      "trace", "Write a timeline of the harness and codec phases of all threads to the specified file, in the Chrome trace event format that Perfetto loads",
+      cxxopts::value<std::string>())(
+      "profile", "Sample the call stacks of the encode and decode phases on the main thread and write them, as folded stacks that flame graph tools read, to <codec>.encode.folded and <codec>.decode.folded, and with --cold to <codec>.cold_encode.folded and <codec>.cold_decode.folded, in the specified directory",
+      cxxopts::value<std::string>())(
+      "profile-period", "With --profile, number of CPU cycles between samples",
+      cxxopts::value<uint64_t>()->default_value("100000"))(
+      "call-chain", "With --profile, unwind the call stacks using the frame pointers (fp), which requires LIBENCH_FRAME_POINTERS, or the last branch records of the CPU (lbr)",
+      cxxopts::value<std::string>()->default_value("fp"))(
+      "serve", "Path of a file listing the images, one per line, of a simulated decode service under open-loop load",
+      cxxopts::value<std::string>())(
+      "serve-encode", "With --serve, serve encode requests instead of decode requests")(
+      "workers", "With --serve or --transcode, number of worker threads",
+      cxxopts::value<int>()->default_value("1"))(
+      "rate", "With --serve, mean rate of the Poisson arrival process, in requests per second",
+      cxxopts::value<double>())(
+      "arrivals", "With --serve, path of a file of arrival times in seconds, one per line, to replay instead of a Poisson process",
+      cxxopts::value<std::string>())(
+      "requests", "With --serve and --rate, number of requests",
+      cxxopts::value<int>()->default_value("1000"))(
+      "seed", "With --serve, seed of the arrival process and of the image choices",
+      cxxopts::value<uint64_t>()->default_value("0"))(
+      "transcode", "Decode the image, encoded with the codec, and encode the decoded image with the specified target codec, as in a migration from one codec to the other",
+      cxxopts::value<std::string>())(
+      "target-option", "With --transcode, option of the target codec of the form key=value, the --option options applying to the source codec only",
+      cxxopts::value<std::vector<std::string>>())(
+      "daily-volume", "With --transcode, number of images per day the migration must sustain, to estimate the number of cores it requires",
+      cxxopts::value<double>()->default_value("0"))(
+      "cold-start", "Run the specified number of samples, each in a fresh process, and time the process startup, the codec construction and the first encode and decode separately from the steady state",
+      cxxopts::value<int>())(
+      "drop-page-cache", "With --cold-start, evict the executable and its libraries from the page cache before each sample, where permitted")(
+      "cold-start-child", "Internal: run a --cold-start sample, the value being the time of the fork",
+      cxxopts::value<int64_t>());
 
-  os << "\"imageHeight\" : " << ctx.image.height  << std::endl;
+  options.parse_positional({"codec", "file"});
 
-  os << "}" << std::endl;
+  std::unique_ptr<libench::Encoder> encoder;
+  std::unique_ptr<libench::Decoder> decoder;
 
-  return os;
-}
+  auto result = options.parse(argc, argv);
 
-libench::ImageContext load_image(const std::string& filepath) {
-  libench::ImageContext image;
+  libench::TraceSession trace_session(result.count("trace") ? result["trace"].as<std::string>() : "");
 
-  size_t start = filepath.find_last_of(".");
+  libench::set_trace_thread_name("main");
 
-  std::string file_ext = filepath.substr(start + 1);
+  if (result.count("hash-only")) {
+    libench::ImageContext image = load_image(result["hash-only"].as<std::string>());
 
-  if (file_ext == "png") {
-    int height;
-    int width;
-    int num_comps;
+    uint8_t image_hash[MD5_BLOCK_SIZE];
 
-    image.planes8[0] = stbi_load(filepath.c_str(), &width, &height, &num_comps, 0);
-    if (! image.planes8[0]) {
-      throw std::runtime_error("Cannot read image file");
-    }
+    image.md5(image_hash);
 
-    image.height = height;
-    image.width = width;
-
-    switch (num_comps) {
-    case 3:
-      image.format = libench::ImageFormat::RGB8;
-      break;
-    case 4:
-      image.format = libench::ImageFormat::RGBA8;
-      break;
-    default:
-      throw std::runtime_error("Only RGB or RGBA images are supported");
-    }
+    std::cout << "{\"imageHash\" : \"" << hex_hash(image_hash) << "\"}" << std::endl;
 
-  } else if (file_ext == "yuv") {
-    /* must be of the form XXXXXX.<width>x<height>.<pixel_fmt>.yuv */
+    free_image(image);
 
-    size_t end = start - 1;
-    start = filepath.find_last_of(".", end);
-    std::string pix_fmt = filepath.substr(start + 1, end - start);
+    return 0;
+  }
 
-    end = start - 1;
-    start = filepath.find_last_of("x", end);
-    image.height = std::stoi(filepath.substr(start + 1, end - start));
+  if (result.count("list-codecs")) {
+    for (const auto& name : libench::codec_names())
+      std::cout << name << std::endl;
 
-    end = start - 1;
-    start = filepath.find_last_of(".", end);
-    image.width = std::stoi(filepath.substr(start + 1, end - start));
+    return 0;
+  }
 
-    if (pix_fmt == "yuv422p10le") {
-      image.format = libench::ImageFormat::YUV422P10;
+  if (result.count("build-info")) {
+    libench::write_build_info(std::cout);
 
-      std::ifstream in(filepath);
+    return 0;
+  }
 
-      for(uint8_t i = 0; i < image.format.num_planes(); i++) {
+  libench::set_allocator_backend(libench::parse_allocator_backend(result["allocator"].as<std::string>()));
 
-        image.planes16[i] = (uint16_t*) malloc(image.plane_size(i));
-        if (! image.planes16[i]) {
-          throw std::runtime_error("Cannot allocate memory");
-        }
+  /* before any codec is created, since libraries select their SIMD paths when first initialized */
+  libench::set_isa_level(libench::parse_isa_level(result["isa"].as<std::string>()));
 
-        in.read((char*) image.planes16[i], image.plane_size(i));
-        if (in.bad()) {
-          throw std::runtime_error("Read failed");
-        }
+  libench::CodecOptions codec_options;
+
+  if (result.count("option")) {
+    codec_options = libench::parse_codec_options(result["option"].as<std::vector<std::string>>());
+  }
+
+  /* cold start */
+
+  if (result.count("cold-start-child")) {
+    std::chrono::steady_clock::time_point start(
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::nanoseconds(result["cold-start-child"].as<int64_t>())));
+
+    run_cold_start_child(std::cout, result["codec"].as<std::string>(), codec_options, result["file"].as<std::string>(),
+                         result["repetitions"].as<int>(), start, main_entry);
+
+    return 0;
+  }
+
+  if (result.count("cold-start")) {
+    ColdStartConfig config;
+
+    config.sample_count = result["cold-start"].as<int>();
+    config.is_page_cache_dropped = result.count("drop-page-cache") > 0;
+    config.child_args = {result["codec"].as<std::string>(), result["file"].as<std::string>(),
+                         "--repetitions", std::to_string(result["repetitions"].as<int>()),
+                         "--allocator", result["allocator"].as<std::string>(),
+                         "--isa", result["isa"].as<std::string>()};
+
+    if (result.count("option")) {
+      for (const auto& option : result["option"].as<std::vector<std::string>>()) {
+        config.child_args.push_back("--option");
+        config.child_args.push_back(option);
       }
+    }
+
+    std::cout << run_cold_start(config);
+
+    return 0;
+  }
+
+  /* serving simulation */
+
+  if (result.count("serve")) {
+    ServeConfig config;
+
+    config.codec = result["codec"].as<std::string>();
+    config.codec_options = codec_options;
+    config.is_encode = result.count("serve-encode") > 0;
+    config.worker_count = result["workers"].as<int>();
+    config.request_count = result["requests"].as<int>();
+    config.seed = result["seed"].as<uint64_t>();
 
+    if (result.count("arrivals")) {
+      config.arrivals = read_arrivals(result["arrivals"].as<std::string>());
+    } else if (result.count("rate")) {
+      config.rate = result["rate"].as<double>();
     } else {
-      throw std::runtime_error("Unknown pixel format: " + pix_fmt);
+      throw std::runtime_error("--serve requires --rate or --arrivals");
     }
 
-  } else {
-    throw std::runtime_error("Image file must be YUV or PNG");
+    std::cout << run_serve(read_path_list(result["serve"].as<std::string>()), config);
+
+    return 0;
   }
 
-  return image;
-}
+  /* migration from one codec to another */
 
-int main(int argc, char* argv[]) {
-  cxxopts::Options options("libench", "Lossless image codec benchmark");
+  if (result.count("transcode")) {
+    TranscodeConfig config;
 
-  options.add_options()("dir", "Codestream directory path",
-                        cxxopts::value<std::string>())(
-      "r,repetitions", "Codestream directory path",
-      cxxopts::value<int>()->default_value("5"))(
-      "file", "Input image", cxxopts::value<std::string>())(
-      "codec", "Codec to profile", cxxopts::value<std::string>());
+    config.source_codec = result["codec"].as<std::string>();
+    config.target_codec = result["transcode"].as<std::string>();
+    config.source_options = codec_options;
 
-  options.parse_positional({"codec", "file"});
+    if (result.count("target-option")) {
+      config.target_options = libench::parse_codec_options(result["target-option"].as<std::vector<std::string>>());
+    }
 
-  std::unique_ptr<libench::Encoder> encoder;
-  std::unique_ptr<libench::Decoder> decoder;
+    config.repetitions = result["repetitions"].as<int>();
+    config.worker_count = result["workers"].as<int>();
+    config.daily_volume = result["daily-volume"].as<double>();
 
-  auto result = options.parse(argc, argv);
+    std::cout << run_transcode(result["file"].as<std::string>(), config);
+
+    return 0;
+  }
+
+  {
+    LIBENCH_TRACE_SPAN("construct");
 
-  if (result["codec"].as<std::string>() == "j2k_ht_ojph") {
-    encoder.reset(new libench::OJPHEncoder());
-    decoder.reset(new libench::OJPHDecoder());
-  } else if (result["codec"].as<std::string>() == "avif") {
-    encoder.reset(new libench::AVIFEncoder());
-    decoder.reset(new libench::AVIFDecoder());
-  } else if (result["codec"].as<std::string>() == "qoi") {
-    encoder.reset(new libench::QOIEncoder());
-    decoder.reset(new libench::QOIDecoder());
-  } else if (result["codec"].as<std::string>() == "jxl_e3") {
-    encoder.reset(new libench::JXLEncoder<3>());
-    decoder.reset(new libench::JXLDecoder());
-  } else if (result["codec"].as<std::string>() == "jxl_e2") {
-    encoder.reset(new libench::JXLEncoder<2>());
-    decoder.reset(new libench::JXLDecoder());
-  } else if (result["codec"].as<std::string>() == "jxl") {
-    encoder.reset(new libench::JXLEncoder<1>());
-    decoder.reset(new libench::JXLDecoder());
-  } else if (result["codec"].as<std::string>() == "j2k_ht_kdu") {
-    encoder.reset(new libench::KDUEncoder(true));
-    decoder.reset(new libench::KDUDecoder());
-  } else if (result["codec"].as<std::string>() == "j2k_1_kdu") {
-    encoder.reset(new libench::KDUEncoder(false));
-    decoder.reset(new libench::KDUDecoder());
-  } else if (result["codec"].as<std::string>() == "png") {
-    encoder.reset(new libench::PNGEncoder());
-    decoder.reset(new libench::PNGDecoder());
-  } else if (result["codec"].as<std::string>() == "ffv1") {
-    encoder.reset(new libench::FFV1Encoder());
-    decoder.reset(new libench::FFV1Decoder());
-  } else if (result["codec"].as<std::string>() == "webp") {
-    encoder.reset(new libench::WEBPEncoder());
-    decoder.reset(new libench::WEBPDecoder());
-  } else {
-    throw std::runtime_error("Unknown encoder");
+    libench::make_codec(result["codec"].as<std::string>(), codec_options, encoder, decoder);
+  }
+
+  std::unique_ptr<libench::SamplingProfiler> profiler;
+
+  if (result.count("profile")) {
+    profiler.reset(new libench::SamplingProfiler(
+        result["profile"].as<std::string>(), result["profile-period"].as<uint64_t>(),
+        libench::SamplingProfiler::parseCallChain(result["call-chain"].as<std::string>())));
+  }
+
+  const std::string encode_label = result["codec"].as<std::string>() + ".encode";
+  const std::string decode_label = result["codec"].as<std::string>() + ".decode";
+  const std::string cold_encode_label = result["codec"].as<std::string>() + ".cold_encode";
+  const std::string cold_decode_label = result["codec"].as<std::string>() + ".cold_decode";
+
+  libench::PageSize pages = libench::PageSize::DEFAULT;
+
+  if (result.count("pages")) {
+    if (result.count("batch") || result.count("out-of-core")) {
+      throw std::runtime_error("--pages cannot be combined with --batch or --out-of-core");
+    }
+
+    pages = libench::parse_page_size(result["pages"].as<std::string>());
+  }
+
+  /* JSON Lines records */
+
+  std::unique_ptr<libench::RunRecordWriter> record_writer;
+  bool is_record_only = false;
+  libench::RunSettings settings;
+
+  if (result.count("jsonl")) {
+    record_writer.reset(new libench::RunRecordWriter(result["jsonl"].as<std::string>()));
+    is_record_only = result["jsonl"].as<std::string>() == "-";
+  }
+
+  settings.codec = result["codec"].as<std::string>();
+  settings.codec_options = libench::format_codec_options(codec_options);
+  settings.set_name = result["set-name"].as<std::string>();
+  settings.pages = result.count("pages") ? result["pages"].as<std::string>() : "default";
+  settings.allocator = result["allocator"].as<std::string>();
+  settings.isa = libench::isa_level_name(libench::isa_level());
+  settings.effective_isa = libench::isa_level_name(libench::effective_isa_level(settings.codec));
+  settings.encoder_backend = encoder->backend();
+  settings.decoder_backend = decoder->backend();
+  settings.cold = result.count("cold") ? result["cold"].as<std::string>() : "";
+  settings.is_into = result.count("into") > 0;
+  settings.is_decode_only = result.count("decode-only") > 0;
+  settings.is_batch = result.count("batch") > 0;
+
+  if (result.count("batch")) {
+    /* the pipeline stages run concurrently and evict each other's caches */
+    if (result.count("cold")) {
+      throw std::runtime_error("--cold cannot be combined with --batch");
+    }
+
+    if (result["precision"].as<double>() > 0 || result["time-budget"].as<double>() > 0 || result.count("min-sample-time")) {
+      throw std::runtime_error("--batch uses a fixed number of repetitions");
+    }
+
+    /* checked before the conversion to size_t, to which a negative value wraps around */
+    int queue_capacity = result["queue-capacity"].as<int>();
+
+    if (queue_capacity < 1) {
+      throw std::runtime_error("--queue-capacity must be at least 1");
+    }
+
+    std::vector<std::string> filepaths = read_path_list(result["batch"].as<std::string>());
+
+    std::function<void(const TestContext&)> on_verified;
+
+    if (record_writer) {
+      on_verified = [&](const TestContext& test) { record_writer->write(test, settings); };
+    }
+
+    PipelineReport report = run_pipeline(filepaths, *encoder, *decoder,
+                                         result["repetitions"].as<int>(),
+                                         (size_t) queue_capacity,
+                                         on_verified);
+
+    if (! is_record_only) {
+      std::cout << report;
+    }
+
+    return 0;
   }
 
   auto& filepath = result["file"].as<std::string>();
 
-  libench::ImageContext in_img = load_image(filepath);
+  /* out-of-core mode */
+
+  bool is_out_of_core = result.count("out-of-core") > 0;
+
+  libench::MappedFile mapped_image;
+  libench::MappedFile mapped_codestream;
+  std::string out_of_core_path;
+
+  if (is_out_of_core) {
+    out_of_core_path = result["out-of-core"].as<std::string>();
+
+    if (! encoder->setOutputFile(out_of_core_path)) {
+      throw std::runtime_error("Codec does not support out-of-core mode");
+    }
+  }
+
+  libench::ImageContext in_img;
+
+  {
+    LIBENCH_TRACE_SPAN("load");
+
+    in_img = is_out_of_core ? map_image(filepath, mapped_image) : load_image(filepath);
+  }
+
+  /* page-backed source */
+
+  libench::PageBuffer source_pages;
+
+  if (pages != libench::PageSize::DEFAULT) {
+    libench::ImageContext loaded_img = in_img;
 
-  int repetitions = result["repetitions"].as<int>();
+    in_img = place_image(loaded_img, source_pages, pages, true);
+
+    free_image(loaded_img);
+  }
+
+  /* planes allocated by load_image */
+  bool is_loaded = ! is_out_of_core && pages == libench::PageSize::DEFAULT;
+
+  /* sampling */
+
+  libench::AdaptiveSampler sampler(result["repetitions"].as<int>(), result["max-repetitions"].as<int>(),
+                                   result["precision"].as<double>(),
+                                   std::chrono::duration_cast<libench::Duration>(
+                                     std::chrono::duration<double>(result["time-budget"].as<double>())));
+
+  double min_sample_ms = result.count("min-sample-time") ? result["min-sample-time"].as<double>() : (sampler.isAdaptive() ? 1 : 0);
+
+  libench::Duration min_sample_time = std::chrono::duration_cast<libench::Duration>(
+    std::chrono::duration<double, std::milli>(min_sample_ms));
 
   TestContext test;
 
   test.image = in_img;
-  test.encode_times.resize(repetitions);
-  test.decode_times.resize(repetitions);
+  test.image_path = filepath;
   test.image_sz = in_img.total_bits() / 8;
 
   /* source hash */
 
   in_img.md5(test.image_hash);
 
+  libench::ArchiveKey archive_key;
+
+  memcpy(archive_key.image_hash, test.image_hash, sizeof(archive_key.image_hash));
+  archive_key.codec = result["codec"].as<std::string>();
+  archive_key.options = libench::format_codec_options(codec_options);
+
+  /* caller-owned buffers */
+
+  bool is_into = result.count("into") > 0;
+
+  /* out-of-core encoders write the codestream to a file and return no codestream to copy */
+  if (is_into && is_out_of_core) {
+    throw std::runtime_error("--into cannot be combined with --out-of-core");
+  }
+
+  libench::OutputBuffer codestream_buffer(pages);
+  libench::ImageContext decoded_img;
+  libench::PageBuffer decoded_pages;
+
+  if (is_into) {
+    decoded_img = place_image(in_img, decoded_pages, pages, false);
+  }
+
+  /* cache-cold measurements */
+
+  std::unique_ptr<libench::CacheEvictor> evictor;
+  std::unique_ptr<libench::FreshImage> fresh_image;
+
+  if (result.count("cold")) {
+    if (is_out_of_core) {
+      throw std::runtime_error("--cold cannot be combined with --out-of-core");
+    }
+
+    evictor.reset(new libench::CacheEvictor(libench::CacheEvictor::parseMethod(result["cold"].as<std::string>())));
+
+    if (result.count("fresh-source")) {
+      fresh_image.reset(new libench::FreshImage(in_img));
+    }
+  } else if (result.count("fresh-source")) {
+    throw std::runtime_error("--fresh-source requires --cold");
+  }
+
+  /* everything the decoder reads or writes that is known outside of it */
+  auto decode_regions = [&](const libench::CodestreamContext& cs) {
+    std::vector<libench::MemoryRegion> regions = {{cs.codestream, cs.size}, {cs.state, cs.state_size}};
+
+    if (is_into) {
+      for (const auto& region : libench::image_regions(decoded_img))
+        regions.push_back(region);
+    }
+
+    return regions;
+  };
+
+  /* times inner consecutive decodes as one sample and verifies the last */
+  auto decode_and_verify = [&](const libench::CodestreamContext& cs, std::vector<libench::Duration>& times, int inner, const std::string& label) {
+    libench::ImageContext out_img;
+
+    {
+      LIBENCH_TRACE_SPAN("decode");
+      libench::ProfileScope profile_scope(profiler.get(), label);
+
+      auto start = std::chrono::high_resolution_clock::now();
+
+      for (int k = 0; k < inner; k++) {
+        if (is_into) {
+          decoder->decodeInto(cs, decoded_img);
+          out_img = decoded_img;
+        } else {
+          out_img = decoder->decodeImage(cs, in_img.format);
+        }
+      }
+
+      times.push_back((std::chrono::high_resolution_clock::now() - start) / inner);
+    }
+
+    /* bit exact compare */
+
+    LIBENCH_TRACE_SPAN("verify");
+
+    uint8_t decoded_hash[MD5_BLOCK_SIZE];
+
+    out_img.md5(decoded_hash);
+
+    if (memcmp(decoded_hash, test.image_hash, MD5_BLOCK_SIZE))
+      throw std::runtime_error("Image does not match");
+  };
+
+  /*
+   * with a minimum sample time, the first sample of a series is a single call
+   * that only determines the number of calls per sample and is then discarded
+   */
+  auto calibrate = [&](std::vector<libench::Duration>& times, int& inner) {
+    if (min_sample_time <= libench::Duration::zero() || times.size() != 1 || inner != 1)
+      return;
+
+    inner = libench::inner_iterations(times.front(), min_sample_time);
+
+    if (inner > 1)
+      times.clear();
+  };
+
+  /* decode only */
+
+  if (result.count("decode-only")) {
+    if (! result.count("archive")) {
+      throw std::runtime_error("--decode-only requires --archive");
+    }
+
+    libench::CodestreamArchive archive;
+
+    archive.open(result["archive"].as<std::string>());
+
+    const libench::ArchiveEntry* entry = archive.find(archive_key);
+    if (! entry) {
+      throw std::runtime_error("Codestream not found in archive");
+    }
+
+    test.encode_times.clear();
+    test.codestream_sz = entry->cs.size + entry->cs.state_size;
+
+    test.cold_encode_times.clear();
+
+    sampler.start();
+
+    while (! sampler.isDone({&test.decode_times})) {
+      decode_and_verify(entry->cs, test.decode_times, test.decode_inner_iterations, decode_label);
+
+      calibrate(test.decode_times, test.decode_inner_iterations);
+
+      if (evictor) {
+        evictor->evict(decode_regions(entry->cs));
+
+        decode_and_verify(entry->cs, test.cold_decode_times, 1, cold_decode_label);
+      }
+    }
+
+    if (record_writer) {
+      record_writer->write(test, settings);
+    }
+
+    if (! is_record_only) {
+      std::cout << test;
+    }
+
+    if (is_loaded) {
+      free_image(in_img);
+    }
+
+    return 0;
+  }
+
+  std::vector<uint8_t> archive_codestream;
+  std::vector<uint8_t> archive_state;
+
   /* encode */
 
-  for (int i = 0; i < repetitions; i++) {
+  sampler.start();
+
+  for (int i = 0; ! sampler.isDone({&test.encode_times, &test.decode_times}); i++) {
     libench::CodestreamContext cs;
 
-    auto start = std::chrono::high_resolution_clock::now();
+    /* the codestream file is rewritten by each encode */
+    mapped_codestream.close();
 
-    if (in_img.format == libench::ImageFormat::RGB8) {
-      cs = encoder->encodeRGB8(in_img);
-    } else if (in_img.format == libench::ImageFormat::RGBA8) {
-      cs = encoder->encodeRGBA8(in_img);
-    } else if (in_img.format == libench::ImageFormat::YUV422P10) {
-      cs = encoder->encodeYUV(in_img);
-    } else {
-      throw std::runtime_error("Unsupported number of components");
+    {
+      LIBENCH_TRACE_SPAN("encode");
+      libench::ProfileScope profile_scope(profiler.get(), encode_label);
+
+      auto start = std::chrono::high_resolution_clock::now();
+
+      for (int k = 0; k < test.encode_inner_iterations; k++) {
+        cs = is_into ? encoder->encodeInto(in_img, codestream_buffer) : encoder->encodeImage(in_img);
+      }
+
+      test.encode_times.push_back((std::chrono::high_resolution_clock::now() - start) / test.encode_inner_iterations);
     }
 
-    test.encode_times[i] = std::chrono::high_resolution_clock::now() - start;
+    if (is_out_of_core) {
+      mapped_codestream.open(out_of_core_path);
+
+      if (mapped_codestream.size() != cs.size) {
+        throw std::runtime_error("Unexpected codestream file size");
+      }
+
+      cs.codestream = const_cast<uint8_t*>(mapped_codestream.data());
+    }
 
     if (i == 0) {
       test.codestream_sz = cs.size + cs.state_size;
 
       if (result.count("dir")) {
-        /* generate the codestream path */
-        std::stringstream ss;
+        LIBENCH_TRACE_SPAN("write codestream");
 
-        ss << result["dir"].as<std::string>() << "/";
-
-        for (int i = 0; i < sizeof(TestContext::image_hash); i++) {
-          ss << std::hex << std::setfill('0') << std::setw(2) << std::right
-             << (int)test.image_hash[i];
-        }
+        /* generate the codestream path */
 
-        test.codestream_path = ss.str();
+        test.codestream_path = result["dir"].as<std::string>() + "/" + hex_hash(test.image_hash);
 
-        /* write the codestream */
+        /* write the codestream and its state */
 
         std::ofstream f(test.codestream_path);
         f.write(reinterpret_cast<char*>(cs.codestream), cs.size);
         f.close();
+
+        if (cs.state_size > 0) {
+          std::ofstream state_f(test.codestream_path + ".state");
+          state_f.write(reinterpret_cast<char*>(cs.state), cs.state_size);
+          state_f.close();
+        }
+      }
+
+      if (result.count("archive")) {
+        archive_codestream.assign(cs.codestream, cs.codestream + cs.size);
+        archive_state.assign((uint8_t*)cs.state, (uint8_t*)cs.state + cs.state_size);
       }
     }
 
     /* decode */
 
-    libench::ImageContext out_img;
+    decode_and_verify(cs, test.decode_times, test.decode_inner_iterations, decode_label);
 
-    start = std::chrono::high_resolution_clock::now();
+    calibrate(test.encode_times, test.encode_inner_iterations);
+    calibrate(test.decode_times, test.decode_inner_iterations);
 
-    if (in_img.format == libench::ImageFormat::RGB8) {
-      out_img = decoder->decodeRGB8(cs);
-    } else if (in_img.format == libench::ImageFormat::RGBA8) {
-      out_img = decoder->decodeRGBA8(cs);
-    } else if (in_img.format == libench::ImageFormat::YUV422P10) {
-      out_img = decoder->decodeYUV(cs);
-    } else {
-      throw std::runtime_error("Unsupported number of components");
+    /* cold encode and decode */
+
+    if (evictor) {
+      libench::ImageContext cold_img = fresh_image ? fresh_image->remap() : in_img;
+
+      std::vector<libench::MemoryRegion> regions = libench::image_regions(cold_img);
+      regions.push_back({cs.codestream, cs.size});
+
+      evictor->evict(regions);
+
+      {
+        LIBENCH_TRACE_SPAN("cold encode");
+        libench::ProfileScope profile_scope(profiler.get(), cold_encode_label);
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        cs = is_into ? encoder->encodeInto(cold_img, codestream_buffer) : encoder->encodeImage(cold_img);
+
+        test.cold_encode_times.push_back(std::chrono::high_resolution_clock::now() - start);
+      }
+
+      evictor->evict(decode_regions(cs));
+
+      decode_and_verify(cs, test.cold_decode_times, 1, cold_decode_label);
     }
+  }
 
-    test.decode_times[i] = std::chrono::high_resolution_clock::now() - start;
+  /* add the codestream to the archive */
 
-    /* bit exact compare */
+  if (result.count("archive")) {
+    LIBENCH_TRACE_SPAN("archive");
 
-    uint8_t decoded_hash[MD5_BLOCK_SIZE];
+    const std::string& archive_path = result["archive"].as<std::string>();
 
-    out_img.md5(decoded_hash);
+    libench::CodestreamArchive archive;
+    std::vector<libench::ArchiveEntry> entries;
 
-    if (memcmp(decoded_hash, test.image_hash, MD5_BLOCK_SIZE))
-      throw std::runtime_error("Image does not match");
+    if (std::ifstream(archive_path).good()) {
+      archive.open(archive_path);
+
+      for (const auto& entry : archive.entries()) {
+        if (! (entry.key == archive_key)) {
+          entries.push_back(entry);
+        }
+      }
+    }
+
+    libench::ArchiveEntry entry;
+
+    entry.key = archive_key;
+    entry.width = in_img.width;
+    entry.height = in_img.height;
+    entry.format = in_img.format;
+    entry.cs.codestream = archive_codestream.data();
+    entry.cs.size = archive_codestream.size();
+    entry.cs.state = archive_state.empty() ? NULL : archive_state.data();
+    entry.cs.state_size = archive_state.size();
+
+    entries.push_back(entry);
+
+    libench::CodestreamArchive::write(archive_path, entries);
   }
 
-  std::cout << test;
+  if (record_writer) {
+    record_writer->write(test, settings);
+  }
+
+  if (! is_record_only) {
+    std::cout << test;
+  }
 
-  for(uint8_t i = 0; i < in_img.format.num_planes(); i++) {
-    free(in_img.planes8[i]);
+  if (is_loaded) {
+    free_image(in_img);
   }
 }
@@ -0,0 +1,52 @@
+#include "mapped_file.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdexcept>
+
+libench::MappedFile::MappedFile() : data_(NULL), size_(0) {}
+
+libench::MappedFile::MappedFile(const std::string& path) : data_(NULL), size_(0) {
+  this->open(path);
+}
+
+libench::MappedFile::~MappedFile() {
+  this->close();
+}
+
+void libench::MappedFile::open(const std::string& path) {
+  this->close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Cannot open file: " + path);
+
+  struct stat st;
+  if (fstat(fd, &st)) {
+    ::close(fd);
+    throw std::runtime_error("Cannot stat file: " + path);
+  }
+
+  if (st.st_size > 0) {
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      ::close(fd);
+      throw std::runtime_error("Cannot map file: " + path);
+    }
+
+    this->data_ = (uint8_t*)data;
+    this->size_ = st.st_size;
+  }
+
+  /* the mapping remains valid after the file is closed */
+  ::close(fd);
+}
+
+void libench::MappedFile::close() {
+  if (this->data_)
+    munmap(this->data_, this->size_);
+
+  this->data_ = NULL;
+  this->size_ = 0;
+}
@@ -0,0 +1,35 @@
+#ifndef LIBENCH_MAPPED_FILE_H
+#define LIBENCH_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace libench {
+
+/* read-only memory mapping of an entire file */
+class MappedFile {
+ public:
+  MappedFile();
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  void open(const std::string& path);
+
+  void close();
+
+  const uint8_t* data() const { return this->data_; }
+
+  size_t size() const { return this->size_; }
+
+ private:
+  uint8_t* data_;
+  size_t size_;
+};
+
+}  // namespace libench
+
+#endif
@@ -1,8 +1,10 @@
 #include "ojph_codec.h"
 #include <assert.h>
 #include <stdexcept>
+#include <vector>
 #include "ojph_mem.h"
 #include "ojph_params.h"
+#include "trace.h"
 
 /*
  * OJPHEncoder
@@ -13,17 +15,114 @@ static ojph::size IMF_PRECINCTS[] = {ojph::size(256, 256), ojph::size(256, 256),
                                      ojph::size(256, 256), ojph::size(256, 256),
                                      ojph::size(128, 128)};
 
-libench::OJPHEncoder::OJPHEncoder(){}
+libench::OJPHEncoder::OJPHEncoder(ojph::ui32 num_decomps,
+                                  const ojph::size& block_dims,
+                                  const std::vector<ojph::size>& precincts,
+                                  const std::string& progression)
+    : num_decomps_(num_decomps),
+      block_dims_(block_dims),
+      precincts_(precincts),
+      progression_(progression) {}
+
+std::vector<ojph::size> libench::OJPHEncoder::imfPrecincts(ojph::ui32 num_decomps) {
+  /* IMF_PRECINCTS is listed from the finest resolution */
+  const ojph::ui32 num_sizes = sizeof(IMF_PRECINCTS) / sizeof(IMF_PRECINCTS[0]);
+
+  if (num_decomps >= num_sizes)
+    throw std::runtime_error("Too many decomposition levels for IMF precincts");
+
+  std::vector<ojph::size> precincts;
+
+  for (ojph::ui32 i = 0; i <= num_decomps; i++)
+    precincts.push_back(IMF_PRECINCTS[num_sizes - 1 - i]);
+
+  return precincts;
+}
+
+void libench::OJPHEncoder::configure(ojph::codestream& cs) {
+  ojph::param_cod cod = cs.access_cod();
+
+  cod.set_num_decomposition(this->num_decomps_);
+  cod.set_block_dims(this->block_dims_.w, this->block_dims_.h);
+
+  if (!this->precincts_.empty())
+    cod.set_precinct_size((int)this->precincts_.size(), this->precincts_.data());
+
+  if (!this->progression_.empty())
+    cod.set_progression_order(this->progression_.c_str());
+
+  cod.set_reversible(true);
+}
+
+bool libench::OJPHEncoder::setOutputFile(const std::string& path) {
+  this->out_path_ = path;
+
+  return true;
+}
+
+ojph::outfile_base* libench::OJPHEncoder::openOutput(OutputBuffer& out) {
+  if (!this->out_path_.empty()) {
+    this->file_out_.open(this->out_path_.c_str());
+    return &this->file_out_;
+  }
+
+  this->buffer_out_.open(&out);
+
+  return &this->buffer_out_;
+}
+
+libench::CodestreamContext libench::OJPHEncoder::flush(ojph::codestream& cs, OutputBuffer& out) {
+  {
+    LIBENCH_TRACE_SPAN("ojph flush");
+
+    cs.flush();
+  }
+
+  libench::CodestreamContext cb;
+
+  if (!this->out_path_.empty()) {
+    if (this->file_out_.tell() < 0) {
+      throw std::runtime_error("File error");
+    }
+
+    cb.size = (size_t)this->file_out_.tell();
+
+    this->file_out_.close();
+
+    return cb;
+  }
+
+  /* cs is not closed since that would close the file */
+
+  cb.codestream = out.data();
+  cb.size = out.size();
+
+  return cb;
+}
 
 libench::CodestreamContext libench::OJPHEncoder::encodeRGB8(const ImageContext &image) {
-  return this->encode8(image);
+  return this->encode8(image, this->out_);
 }
 
 libench::CodestreamContext libench::OJPHEncoder::encodeRGBA8(const ImageContext &image) {
-  return this->encode8(image);
+  return this->encode8(image, this->out_);
+}
+
+libench::CodestreamContext libench::OJPHEncoder::encodeYUV(const ImageContext &image) {
+  return this->encodePlanar(image, this->out_);
+}
+
+libench::CodestreamContext libench::OJPHEncoder::encodeInto(const ImageContext &image, OutputBuffer& out) {
+  if (image.format == libench::ImageFormat::RGB8 || image.format == libench::ImageFormat::RGBA8) {
+    return this->encode8(image, out);
+  } else if (image.format.comps == libench::ImageComponents::YUV) {
+    return this->encodePlanar(image, out);
+  }
+
+  throw std::runtime_error("Unsupported image format");
 }
 
-libench::CodestreamContext libench::OJPHEncoder::encode8(const ImageContext &image) {
+libench::CodestreamContext libench::OJPHEncoder::encode8(const ImageContext &image, OutputBuffer& out) {
   ojph::codestream cs;
 
   cs.set_planar(false);
@@ -42,17 +141,13 @@ libench::CodestreamContext libench::OJPHEncoder::encode8(const ImageContext &ima
 
   /* cod */
 
-  ojph::param_cod cod = cs.access_cod();
+  this->configure(cs);
 
-  cod.set_color_transform(image.format.comps.num_comps == 3 || image.format.comps.num_comps == 4);
-  cod.set_reversible(true);
+  cs.access_cod().set_color_transform(image.format.comps.num_comps == 3 || image.format.comps.num_comps == 4);
 
   /* encode */
 
-  this->out_.close();
-  this->out_.open();
-
-  cs.write_headers(&this->out_);
+  cs.write_headers(this->openOutput(out));
 
   const uint8_t* line = image.planes8[0];
   ojph::ui32 next_comp = 0;
@@ -74,23 +169,67 @@ libench::CodestreamContext libench::OJPHEncoder::encode8(const ImageContext &ima
       cur_line = cs.exchange(cur_line, next_comp);
     }
 
-    line += image.format.comps.num_comps * image.width;
+    line += (size_t) image.format.comps.num_comps * image.width;
   }
 
-  cs.flush();
-
-  /* cs is not closed since that would close the file */
+  return this->flush(cs, out);
+}
 
-  if (this->out_.tell() < 0) {
-    throw std::runtime_error("Memory error");
+libench::CodestreamContext libench::OJPHEncoder::encodePlanar(const ImageContext &image, OutputBuffer& out) {
+  if (!image.is_plane16()) {
+    throw std::runtime_error("Only YUV 10 bits and above supported");
   }
 
-  libench::CodestreamContext cb;
+  ojph::codestream cs;
 
-  cb.codestream = (uint8_t*)this->out_.get_data();
-  cb.size = (size_t)this->out_.tell();
+  cs.set_planar(true);
 
-  return cb;
+  /* siz */
+
+  ojph::param_siz siz = cs.access_siz();
+
+  siz.set_image_extent(ojph::point(image.width, image.height));
+  siz.set_num_components(image.format.comps.num_comps);
+  for (ojph::ui32 c = 0; c < image.format.comps.num_comps; c++)
+    siz.set_component(c, ojph::point(image.format.x_sub_factor[c], image.format.y_sub_factor[c]),
+                      image.format.bit_depth, false);
+  siz.set_image_offset(ojph::point(0, 0));
+  siz.set_tile_size(ojph::size(image.width, image.height));
+  siz.set_tile_offset(ojph::point(0, 0));
+
+  /* cod */
+
+  this->configure(cs);
+
+  cs.access_cod().set_color_transform(false);
+
+  /* encode */
+
+  cs.write_headers(this->openOutput(out));
+
+  ojph::ui32 next_comp = 0;
+  ojph::line_buf* cur_line = cs.exchange(NULL, next_comp);
+
+  for (uint32_t c = 0; c < image.format.comps.num_comps; c++) {
+    const uint16_t* line = image.planes16[c];
+    uint32_t line_width = image.width / image.format.x_sub_factor[c];
+
+    for (uint32_t i = 0; i < image.plane_height(c); ++i) {
+      assert(next_comp == c);
+
+      int32_t* out = cur_line->i32;
+
+      for (uint32_t p = 0; p < line_width; p++) {
+        out[p] = line[p];
+      }
+
+      cur_line = cs.exchange(cur_line, next_comp);
+
+      line += line_width;
+    }
+  }
+
+  return this->flush(cs, out);
 }
 
 /*
@@ -100,19 +239,49 @@ libench::CodestreamContext libench::OJPHEncoder::encode8(const ImageContext &ima
 libench::OJPHDecoder::OJPHDecoder(){}
 
 libench::ImageContext libench::OJPHDecoder::decodeRGB8(const CodestreamContext& cs) {
-  return this->decode8(cs, 3);
+  libench::ImageContext image;
+  image.format = libench::ImageFormat::RGB8;
+  this->decode8(cs, image, false);
+  return image;
 }
 
 libench::ImageContext libench::OJPHDecoder::decodeRGBA8(const CodestreamContext& cs) {
-  return this->decode8(cs, 4);
+  libench::ImageContext image;
+  image.format = libench::ImageFormat::RGBA8;
+  this->decode8(cs, image, false);
+  return image;
+}
+
+libench::ImageContext libench::OJPHDecoder::decodeYUV(const CodestreamContext& cs) {
+  libench::ImageContext image;
+  this->decodePlanar(cs, image, false);
+  return image;
+}
+
+void libench::OJPHDecoder::decodeInto(const CodestreamContext& cs, ImageContext& image) {
+  if (image.format == libench::ImageFormat::RGB8 || image.format == libench::ImageFormat::RGBA8) {
+    this->decode8(cs, image, true);
+  } else if (image.format.comps == libench::ImageComponents::YUV) {
+    this->decodePlanar(cs, image, true);
+  } else {
+    throw std::runtime_error("Unsupported image format");
+  }
 }
 
-libench::ImageContext libench::OJPHDecoder::decode8(const CodestreamContext& ctx, uint8_t num_comps) {
+/*
+ * The decode methods write into the planes of image if is_preallocated, in
+ * which case its dimensions must match the codestream, or into decoder-owned
+ * memory otherwise
+ */
+
+void libench::OJPHDecoder::decode8(const CodestreamContext& ctx, ImageContext& image, bool is_preallocated) {
   ojph::codestream cs;
 
   this->in_.open(ctx.codestream, ctx.size);
   cs.read_headers(&this->in_);
 
+  uint32_t num_comps = image.format.comps.num_comps;
+
   ojph::param_siz siz = cs.access_siz();
   ojph::ui32 width = siz.get_image_extent().x - siz.get_image_offset().x;
   ojph::ui32 height = siz.get_image_extent().y - siz.get_image_offset().y;
@@ -121,14 +290,22 @@ libench::ImageContext libench::OJPHDecoder::decode8(const CodestreamContext& ctx
     throw std::runtime_error("Unexpected number of components");
   }
 
+  if (is_preallocated) {
+    if (image.width != width || image.height != height)
+      throw std::runtime_error("Destination image does not match the codestream");
+  } else {
+    image.width = width;
+    image.height = height;
+    this->pixels_.resize(image.plane_size(0));
+    image.planes8[0] = this->pixels_.data();
+  }
+
   cs.set_planar(false);
 
   cs.create();
 
-  this->pixels_.resize(width * height * num_comps);
-
   for (uint32_t i = 0; i < height; ++i) {
-    uint8_t* line = &this->pixels_.data()[width * i * num_comps];
+    uint8_t* line = image.planes8[0] + (size_t) width * i * num_comps;
 
     for (uint32_t c = 0; c < num_comps; c++) {
       ojph::ui32 next_comp = 0;
@@ -147,13 +324,73 @@ libench::ImageContext libench::OJPHDecoder::decode8(const CodestreamContext& ctx
   }
 
   this->in_.close();
+}
 
-  libench::ImageContext image;
+void libench::OJPHDecoder::decodePlanar(const CodestreamContext& ctx, ImageContext& image, bool is_preallocated) {
+  ojph::codestream cs;
 
-  image.height = (uint32_t)height;
-  image.width = (uint32_t)width;
-  image.format = num_comps == 3 ? libench::ImageFormat::RGB8 : libench::ImageFormat::RGBA8;
-  image.planes8[0] = this->pixels_.data();
+  this->in_.open(ctx.codestream, ctx.size);
+  cs.read_headers(&this->in_);
 
-  return image;
+  ojph::param_siz siz = cs.access_siz();
+
+  if (siz.get_num_components() != 3) {
+    throw std::runtime_error("Unexpected number of components");
+  }
+
+  libench::ImageContext cs_image;
+
+  cs_image.width = siz.get_image_extent().x - siz.get_image_offset().x;
+  cs_image.height = siz.get_image_extent().y - siz.get_image_offset().y;
+  cs_image.format.comps = libench::ImageComponents::YUV;
+  cs_image.format.is_planar = true;
+  cs_image.format.bit_depth = siz.get_bit_depth(0);
+  cs_image.format.x_sub_factor = {1, 1, 1, 1};
+  cs_image.format.y_sub_factor = {1, 1, 1, 1};
+
+  for (uint32_t c = 0; c < 3; c++) {
+    cs_image.format.x_sub_factor[c] = siz.get_downsampling(c).x;
+    cs_image.format.y_sub_factor[c] = siz.get_downsampling(c).y;
+  }
+
+  if (!cs_image.is_plane16()) {
+    throw std::runtime_error("Only YUV 10 bits and above supported");
+  }
+
+  if (is_preallocated) {
+    if (image.width != cs_image.width || image.height != cs_image.height || !(image.format == cs_image.format))
+      throw std::runtime_error("Destination image does not match the codestream");
+  } else {
+    image = cs_image;
+
+    for (uint32_t c = 0; c < 3; c++) {
+      this->planes_[c].resize(image.plane_size(c));
+      image.planes8[c] = this->planes_[c].data();
+    }
+  }
+
+  cs.set_planar(true);
+
+  cs.create();
+
+  for (uint32_t c = 0; c < 3; c++) {
+    uint16_t* line = image.planes16[c];
+    uint32_t line_width = image.width / image.format.x_sub_factor[c];
+
+    for (uint32_t i = 0; i < image.plane_height(c); ++i) {
+      ojph::ui32 next_comp = 0;
+      ojph::line_buf* cur_line = cs.pull(next_comp);
+      assert(next_comp == c);
+
+      int32_t* in = cur_line->i32;
+
+      for (uint32_t p = 0; p < line_width; p++) {
+        line[p] = (uint16_t)in[p];
+      }
+
+      line += line_width;
+    }
+  }
+
+  this->in_.close();
 }
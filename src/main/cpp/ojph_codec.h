@@ -1,6 +1,7 @@
 #ifndef LIBENCH_OJPH_H
 #define LIBENCH_OJPH_H
 
+#include <string>
 #include <vector>
 #include "codec.h"
 #include "ojph_arch.h"
@@ -9,18 +10,73 @@
 
 namespace libench {
 
+/* OpenJPH output that appends to an OutputBuffer */
+class buffer_outfile : public ojph::outfile_base {
+ public:
+  buffer_outfile() : out_(NULL) {}
+
+  void open(OutputBuffer* out) {
+    this->out_ = out;
+    this->out_->clear();
+  }
+
+  size_t write(const void *ptr, size_t size) {
+    this->out_->append((const uint8_t*)ptr, size);
+    return size;
+  }
+
+  ojph::si64 tell() {
+    return (ojph::si64)this->out_->size();
+  }
+
+  void close() {}
+
+ private:
+  OutputBuffer* out_;
+};
+
 class OJPHEncoder : public Encoder {
  public:
-  OJPHEncoder();
+  /* precincts are listed from the coarsest resolution; an empty list selects
+     maximal precincts and an empty progression the library default */
+  OJPHEncoder(ojph::ui32 num_decomps = 5,
+              const ojph::size& block_dims = ojph::size(64, 64),
+              const std::vector<ojph::size>& precincts = {},
+              const std::string& progression = "");
 
   CodestreamContext encodeRGB8(const ImageContext &image);
 
   CodestreamContext encodeRGBA8(const ImageContext &image);
 
+  CodestreamContext encodeYUV(const ImageContext &image);
+
+  CodestreamContext encodeInto(const ImageContext &image, OutputBuffer& out);
+
+  /* lines are pulled from the image one at a time, so only the output needs redirecting */
+  bool setOutputFile(const std::string& path);
+
+  /* precinct sizes of the IMF profiles, from the coarsest resolution */
+  static std::vector<ojph::size> imfPrecincts(ojph::ui32 num_decomps);
+
  private:
-  CodestreamContext encode8(const ImageContext &image);
+  CodestreamContext encode8(const ImageContext &image, OutputBuffer& out);
+
+  CodestreamContext encodePlanar(const ImageContext &image, OutputBuffer& out);
+
+  void configure(ojph::codestream& cs);
 
-  ojph::mem_outfile out_;
+  ojph::outfile_base* openOutput(OutputBuffer& out);
+
+  CodestreamContext flush(ojph::codestream& cs, OutputBuffer& out);
+
+  OutputBuffer out_;
+  buffer_outfile buffer_out_;
+  ojph::j2c_outfile file_out_;
+  std::string out_path_;
+  ojph::ui32 num_decomps_;
+  ojph::size block_dims_;
+  std::vector<ojph::size> precincts_;
+  std::string progression_;
 };
 
 class OJPHDecoder : public Decoder {
@@ -31,11 +87,18 @@ class OJPHDecoder : public Decoder {
 
   virtual ImageContext decodeRGBA8(const CodestreamContext& cs);
 
+  virtual ImageContext decodeYUV(const CodestreamContext& cs);
+
+  virtual void decodeInto(const CodestreamContext& cs, ImageContext& image);
+
  private:
-  ImageContext decode8(const CodestreamContext& cs, uint8_t num_comps);
+  void decode8(const CodestreamContext& cs, ImageContext& image, bool is_preallocated);
+
+  void decodePlanar(const CodestreamContext& cs, ImageContext& image, bool is_preallocated);
 
   ojph::mem_infile in_;
   std::vector<uint8_t> pixels_;
+  std::vector<uint8_t> planes_[3];
 };
 
 }  // namespace libench
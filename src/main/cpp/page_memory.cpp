@@ -0,0 +1,155 @@
+#include "page_memory.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+
+/* used when /proc/meminfo cannot be read */
+static const size_t DEFAULT_HUGE_PAGE_SIZE = 2 << 20;
+
+static size_t round_up(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+libench::PageSize libench::parse_page_size(const std::string& name) {
+  if (name == "4k") {
+    return PageSize::SMALL;
+  } else if (name == "thp") {
+    return PageSize::TRANSPARENT_HUGE;
+  } else if (name == "hugetlbfs") {
+    return PageSize::HUGETLB;
+  }
+
+  throw std::runtime_error("Unknown page size: " + name);
+}
+
+size_t libench::huge_page_size() {
+  static size_t size = 0;
+
+  if (size > 0)
+    return size;
+
+  /* e.g. "Hugepagesize:       2048 kB" */
+  std::ifstream meminfo("/proc/meminfo");
+  std::string key;
+
+  while (meminfo >> key) {
+    if (key == "Hugepagesize:") {
+      size_t value;
+      if (meminfo >> value)
+        size = value << 10;
+      break;
+    }
+    meminfo.ignore(256, '\n');
+  }
+
+  if (size == 0)
+    size = DEFAULT_HUGE_PAGE_SIZE;
+
+  return size;
+}
+
+/* length of the mapping that holds size bytes */
+static size_t mapping_size(size_t size, libench::PageSize pages) {
+  return pages == libench::PageSize::HUGETLB ? round_up(size, libench::huge_page_size()) : size;
+}
+
+void* libench::allocate_pages(size_t size, PageSize pages) {
+  if (pages == PageSize::DEFAULT)
+    return malloc(size);
+
+  if (size == 0)
+    return NULL;
+
+  size_t length = mapping_size(size, pages);
+  uint8_t* data;
+
+  if (pages == PageSize::HUGETLB) {
+    void* ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (ptr == MAP_FAILED)
+      throw std::runtime_error("Cannot map huge pages, check /proc/sys/vm/nr_hugepages");
+
+    data = (uint8_t*) ptr;
+
+  } else if (pages == PageSize::TRANSPARENT_HUGE) {
+    /* over-allocate, then trim the mapping so that it starts on a huge page boundary */
+    size_t alignment = huge_page_size();
+    size_t reserved = length + alignment;
+
+    void* ptr = mmap(NULL, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED)
+      throw std::runtime_error("Cannot map memory");
+
+    uint8_t* base = (uint8_t*) ptr;
+    data = (uint8_t*) round_up((uintptr_t) base, alignment);
+
+    if (data > base)
+      munmap(base, data - base);
+
+    size_t tail = reserved - (data - base) - length;
+    if (tail > 0)
+      munmap(data + length, tail);
+
+    if (madvise(data, length, MADV_HUGEPAGE)) {
+      munmap(data, length);
+      throw std::runtime_error("Transparent huge pages are not available");
+    }
+
+  } else {
+    void* ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED)
+      throw std::runtime_error("Cannot map memory");
+
+    data = (uint8_t*) ptr;
+
+    /* keeps the mapping on small pages even if transparent huge pages are enabled system-wide */
+    if (madvise(data, length, MADV_NOHUGEPAGE)) {
+      munmap(data, length);
+      throw std::runtime_error("Cannot disable transparent huge pages");
+    }
+  }
+
+  /* fault the pages in now rather than during the first measurement */
+  memset(data, 0, length);
+
+  return data;
+}
+
+void libench::free_pages(void* ptr, size_t size, PageSize pages) {
+  if (pages == PageSize::DEFAULT) {
+    free(ptr);
+  } else if (ptr != NULL) {
+    munmap(ptr, mapping_size(size, pages));
+  }
+}
+
+/*
+ * PageBuffer
+ */
+
+libench::PageBuffer::PageBuffer(size_t size, PageSize pages) : data_(NULL), size_(0), pages_(pages) {
+  this->allocate(size, pages);
+}
+
+libench::PageBuffer::~PageBuffer() {
+  this->release();
+}
+
+void libench::PageBuffer::release() {
+  free_pages(this->data_, this->size_, this->pages_);
+
+  this->data_ = NULL;
+  this->size_ = 0;
+}
+
+void libench::PageBuffer::allocate(size_t size, PageSize pages) {
+  this->release();
+
+  this->data_ = (uint8_t*) allocate_pages(size, pages);
+  if (size > 0 && this->data_ == NULL)
+    throw std::runtime_error("Cannot allocate memory");
+
+  this->size_ = size;
+  this->pages_ = pages;
+}
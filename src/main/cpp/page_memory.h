@@ -0,0 +1,61 @@
+#ifndef LIBENCH_PAGE_MEMORY_H
+#define LIBENCH_PAGE_MEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace libench {
+
+/*
+ * Pages backing the large buffers of the harness: DEFAULT uses malloc, SMALL
+ * maps 4 KiB pages with transparent huge pages disabled, TRANSPARENT_HUGE maps
+ * a huge-page aligned region and advises the kernel to back it with huge pages,
+ * and HUGETLB maps pages from the hugetlbfs pool, which must have been
+ * reserved, e.g. through /proc/sys/vm/nr_hugepages.
+ */
+enum class PageSize { DEFAULT, SMALL, TRANSPARENT_HUGE, HUGETLB };
+
+/* accepts "4k", "thp" or "hugetlbfs" */
+PageSize parse_page_size(const std::string& name);
+
+/* size of the default huge page, as reported by /proc/meminfo */
+size_t huge_page_size();
+
+/*
+ * allocates size bytes backed by the specified pages; the pages of mappings
+ * are touched, so that the first use of the buffer does not page fault
+ */
+void* allocate_pages(size_t size, PageSize pages);
+
+/* size and pages must be those passed to allocate_pages */
+void free_pages(void* ptr, size_t size, PageSize pages);
+
+/* fixed-size buffer backed by the specified pages */
+class PageBuffer {
+ public:
+  PageBuffer() : data_(NULL), size_(0), pages_(PageSize::DEFAULT) {}
+  PageBuffer(size_t size, PageSize pages);
+  ~PageBuffer();
+
+  PageBuffer(const PageBuffer&) = delete;
+  PageBuffer& operator=(const PageBuffer&) = delete;
+
+  /* frees the current contents, if any */
+  void allocate(size_t size, PageSize pages);
+
+  uint8_t* data() const { return this->data_; }
+
+  size_t size() const { return this->size_; }
+
+ private:
+  void release();
+
+  uint8_t* data_;
+  size_t size_;
+  PageSize pages_;
+};
+
+}  // namespace libench
+
+#endif
@@ -0,0 +1,279 @@
+#include "pipeline.h"
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include "image_io.h"
+#include "trace.h"
+
+struct PipelineItem {
+  TestContext test;
+  std::vector<uint8_t> codestream;
+  std::vector<uint8_t> state;
+  libench::ImageContext decoded;
+  std::vector<uint8_t> planes[4];
+};
+
+typedef libench::SPSCQueue<PipelineItem> PipelineQueue;
+
+PipelineReport run_pipeline(const std::vector<std::string>& filepaths,
+                            libench::Encoder& encoder, libench::Decoder& decoder,
+                            int repetitions, size_t queue_capacity,
+                            const std::function<void(const TestContext&)>& on_verified) {
+  PipelineReport report;
+
+  PipelineQueue to_encode(queue_capacity);
+  PipelineQueue to_decode(queue_capacity);
+  PipelineQueue to_verify(queue_capacity);
+
+  std::exception_ptr errors[4];
+  std::chrono::steady_clock::duration busy[4] = {};
+
+  auto cancel = [&]() {
+    to_encode.cancel();
+    to_decode.cancel();
+    to_verify.cancel();
+  };
+
+  /* load */
+
+  std::thread load_thread([&]() {
+    libench::set_trace_thread_name("load");
+
+    try {
+      for (const auto& filepath : filepaths) {
+        PipelineItem item;
+
+        {
+          LIBENCH_TRACE_SPAN("load");
+
+          auto start = std::chrono::steady_clock::now();
+
+          item.test.image_path = filepath;
+          item.test.image = load_image(filepath);
+          item.test.image_sz = item.test.image.total_bits() / 8;
+          item.test.image.md5(item.test.image_hash);
+
+          busy[0] += std::chrono::steady_clock::now() - start;
+        }
+
+        if (!to_encode.push(std::move(item)))
+          return;
+      }
+      to_encode.close();
+    } catch (...) {
+      errors[0] = std::current_exception();
+      cancel();
+    }
+  });
+
+  /* encode */
+
+  std::thread encode_thread([&]() {
+    libench::set_trace_thread_name("encode");
+
+    try {
+      PipelineItem item;
+
+      while (to_encode.pop(item)) {
+        auto start = std::chrono::steady_clock::now();
+
+        libench::CodestreamContext cs;
+
+        item.test.encode_times.resize(repetitions);
+
+        for (int i = 0; i < repetitions; i++) {
+          LIBENCH_TRACE_SPAN("encode");
+
+          auto encode_start = std::chrono::high_resolution_clock::now();
+
+          cs = encoder.encodeImage(item.test.image);
+
+          item.test.encode_times[i] = std::chrono::high_resolution_clock::now() - encode_start;
+        }
+
+        /* the codestream is only valid until the next encode */
+
+        item.test.codestream_sz = cs.size + cs.state_size;
+        item.codestream.assign(cs.codestream, cs.codestream + cs.size);
+        item.state.assign((const uint8_t*)cs.state, (const uint8_t*)cs.state + cs.state_size);
+
+        free_image(item.test.image);
+
+        busy[1] += std::chrono::steady_clock::now() - start;
+
+        if (!to_decode.push(std::move(item)))
+          return;
+      }
+      to_decode.close();
+    } catch (...) {
+      errors[1] = std::current_exception();
+      cancel();
+    }
+  });
+
+  /* decode */
+
+  std::thread decode_thread([&]() {
+    libench::set_trace_thread_name("decode");
+
+    try {
+      PipelineItem item;
+
+      while (to_decode.pop(item)) {
+        auto start = std::chrono::steady_clock::now();
+
+        libench::CodestreamContext cs;
+        cs.codestream = item.codestream.data();
+        cs.size = item.codestream.size();
+        cs.state = item.state.empty() ? NULL : item.state.data();
+        cs.state_size = item.state.size();
+
+        libench::ImageContext out_img;
+
+        item.test.decode_times.resize(repetitions);
+
+        for (int i = 0; i < repetitions; i++) {
+          LIBENCH_TRACE_SPAN("decode");
+
+          auto decode_start = std::chrono::high_resolution_clock::now();
+
+          out_img = decoder.decodeImage(cs, item.test.image.format);
+
+          item.test.decode_times[i] = std::chrono::high_resolution_clock::now() - decode_start;
+        }
+
+        /* the decoded image is only valid until the next decode */
+
+        item.decoded = out_img;
+
+        for (uint8_t p = 0; p < out_img.format.num_planes(); p++) {
+          item.planes[p].assign(out_img.planes8[p], out_img.planes8[p] + out_img.plane_size(p));
+          item.decoded.planes8[p] = item.planes[p].data();
+        }
+
+        item.codestream.clear();
+        item.state.clear();
+
+        busy[2] += std::chrono::steady_clock::now() - start;
+
+        if (!to_verify.push(std::move(item)))
+          return;
+      }
+      to_verify.close();
+    } catch (...) {
+      errors[2] = std::current_exception();
+      cancel();
+    }
+  });
+
+  /* verify */
+
+  std::thread verify_thread([&]() {
+    libench::set_trace_thread_name("verify");
+
+    try {
+      PipelineItem item;
+
+      while (to_verify.pop(item)) {
+        LIBENCH_TRACE_SPAN("verify");
+
+        auto start = std::chrono::steady_clock::now();
+
+        uint8_t decoded_hash[MD5_BLOCK_SIZE];
+
+        item.decoded.md5(decoded_hash);
+
+        if (memcmp(decoded_hash, item.test.image_hash, MD5_BLOCK_SIZE))
+          throw std::runtime_error("Image does not match: " + item.test.image_path);
+
+        if (on_verified)
+          on_verified(item.test);
+
+        report.tests.push_back(std::move(item.test));
+
+        busy[3] += std::chrono::steady_clock::now() - start;
+      }
+    } catch (...) {
+      errors[3] = std::current_exception();
+      cancel();
+    }
+  });
+
+  auto start = std::chrono::steady_clock::now();
+
+  load_thread.join();
+  encode_thread.join();
+  decode_thread.join();
+  verify_thread.join();
+
+  report.wall_time = std::chrono::steady_clock::now() - start;
+
+  for (auto& e : errors) {
+    if (e)
+      std::rethrow_exception(e);
+  }
+
+  const char* stage_names[] = {"load", "encode", "decode", "verify"};
+
+  for (int i = 0; i < 4; i++) {
+    report.stages.push_back({stage_names[i], busy[i]});
+  }
+
+  report.queues.push_back({"load->encode", to_encode.stats()});
+  report.queues.push_back({"encode->decode", to_decode.stats()});
+  report.queues.push_back({"decode->verify", to_verify.stats()});
+
+  return report;
+}
+
+std::ostream& operator<<(std::ostream& os, const PipelineReport& report) {
+  os << "{" << std::endl;
+
+  os << "\"results\" : [" << std::endl;
+  for (const auto& test : report.tests) {
+    os << test;
+    if (&test != &report.tests.back()) {
+      os << "," << std::endl;
+    }
+  }
+  os << "]," << std::endl;
+
+  double wall_time = std::chrono::duration<double>(report.wall_time).count();
+
+  os << "\"wallTime\" : " << wall_time << "," << std::endl;
+
+  os << "\"imagesPerSecond\" : " << (wall_time > 0 ? report.tests.size() / wall_time : 0) << "," << std::endl;
+
+  os << "\"stages\" : [";
+  for (const auto& stage : report.stages) {
+    os << "{\"name\" : \"" << stage.name << "\", \"busyTime\" : "
+       << std::chrono::duration<double>(stage.busy_time).count() << "}";
+    if (&stage != &report.stages.back()) {
+      os << ", ";
+    }
+  }
+  os << "]," << std::endl;
+
+  os << "\"queues\" : [" << std::endl;
+  for (const auto& queue : report.queues) {
+    os << "{\"name\" : \"" << queue.name << "\""
+       << ", \"capacity\" : " << queue.stats.capacity
+       << ", \"meanOccupancy\" : " << queue.stats.mean_occupancy()
+       << ", \"maxOccupancy\" : " << queue.stats.max_occupancy
+       << ", \"fullCount\" : " << queue.stats.full_count
+       << ", \"emptyCount\" : " << queue.stats.empty_count
+       << ", \"pushWaitTime\" : " << std::chrono::duration<double>(queue.stats.push_wait).count()
+       << ", \"popWaitTime\" : " << std::chrono::duration<double>(queue.stats.pop_wait).count()
+       << "}";
+    if (&queue != &report.queues.back()) {
+      os << ",";
+    }
+    os << std::endl;
+  }
+  os << "]" << std::endl;
+
+  os << "}" << std::endl;
+
+  return os;
+}
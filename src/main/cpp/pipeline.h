@@ -0,0 +1,45 @@
+#ifndef LIBENCH_PIPELINE_H
+#define LIBENCH_PIPELINE_H
+
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "codec.h"
+#include "spsc_queue.h"
+#include "test_context.h"
+
+struct PipelineStageStats {
+  std::string name;
+  /* time spent processing items, excluding waits on the queues */
+  std::chrono::steady_clock::duration busy_time;
+};
+
+struct PipelineQueueStats {
+  std::string name;
+  libench::QueueStats stats;
+};
+
+struct PipelineReport {
+  std::vector<TestContext> tests;
+  std::chrono::steady_clock::duration wall_time;
+  std::vector<PipelineStageStats> stages;
+  std::vector<PipelineQueueStats> queues;
+};
+
+/*
+ * Runs the images through load, encode, decode and verify stages, each on its
+ * own thread and connected by bounded queues of queue_capacity items. Encode
+ * and decode timings remain per image and per repetition; the last decoded
+ * image of each repetition series is verified against the source. on_verified,
+ * if set, is called by the verify thread as soon as each image is verified.
+ */
+PipelineReport run_pipeline(const std::vector<std::string>& filepaths,
+                            libench::Encoder& encoder, libench::Decoder& decoder,
+                            int repetitions, size_t queue_capacity,
+                            const std::function<void(const TestContext&)>& on_verified = nullptr);
+
+std::ostream& operator<<(std::ostream& os, const PipelineReport& report);
+
+#endif
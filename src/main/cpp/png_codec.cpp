@@ -1,8 +1,36 @@
 #include "png_codec.h"
+#include "allocator.h"
 #include <climits>
+#include <cstring>
 #include <memory>
 #include <stdexcept>
 
+/*
+ * lodepng is built with LODEPNG_NO_COMPILE_ALLOCATORS so that its allocations
+ * are served from the arena of the calling thread
+ */
+
+void* lodepng_malloc(size_t size) {
+  return libench_malloc(size);
+}
+
+void* lodepng_realloc(void* ptr, size_t new_size) {
+  return libench_realloc(ptr, new_size);
+}
+
+void lodepng_free(void* ptr) {
+  libench_free(ptr);
+}
+
+/* frees a buffer returned by lodepng, whichever allocator backend is selected */
+struct LodePNGDeleter {
+  void operator()(unsigned char* ptr) const {
+    lodepng_free(ptr);
+  }
+};
+
+typedef std::unique_ptr<unsigned char, LodePNGDeleter> LodePNGBuffer;
+
 /*
  * PNGEncoder
  */
@@ -10,7 +38,7 @@
 libench::PNGEncoder::PNGEncoder() {}
 
 libench::PNGEncoder::~PNGEncoder() {
-  free(this->cs_.codestream);
+  lodepng_free(this->cs_.codestream);
 }
 
 libench::CodestreamContext libench::PNGEncoder::encodeRGB8(const ImageContext &image) {
@@ -21,21 +49,53 @@ libench::CodestreamContext libench::PNGEncoder::encodeRGBA8(const ImageContext &
   return this->encode8(image);
 }
 
+/*
+ * the codestream allocated by lodepng is returned as is, so it is allocated
+ * outside of any ArenaScope and is freed on the next call
+ */
 libench::CodestreamContext libench::PNGEncoder::encode8(const ImageContext &image) {
-  int ret;
+  lodepng_free(this->cs_.codestream);
+  this->cs_.codestream = NULL;
 
-  free(this->cs_.codestream);
-
-  ret = lodepng_encode_memory(&this->cs_.codestream, &this->cs_.size, image.planes8[0],
-                              image.width, image.height,
-                              image.format.comps.num_comps == 3 ? LCT_RGB : LCT_RGBA, 8);
+  int ret = lodepng_encode_memory(&this->cs_.codestream, &this->cs_.size, image.planes8[0],
+                                  image.width, image.height,
+                                  image.format.comps.num_comps == 3 ? LCT_RGB : LCT_RGBA, 8);
 
   if (ret)
-    throw std::runtime_error("PNG decode failed");
+    throw std::runtime_error("PNG encode failed");
 
   return this->cs_;
 }
 
+libench::CodestreamContext libench::PNGEncoder::encodeInto(const ImageContext &image, OutputBuffer& out) {
+  if (!(image.format == libench::ImageFormat::RGB8 || image.format == libench::ImageFormat::RGBA8))
+    throw std::runtime_error("Unsupported image format");
+
+  ArenaScope scope;
+
+  unsigned char* codestream = NULL;
+  size_t size;
+
+  int ret = lodepng_encode_memory(&codestream, &size, image.planes8[0],
+                                  image.width, image.height,
+                                  image.format.comps.num_comps == 3 ? LCT_RGB : LCT_RGBA, 8);
+
+  LodePNGBuffer owner(codestream);
+
+  if (ret)
+    throw std::runtime_error("PNG encode failed");
+
+  out.clear();
+  out.append(codestream, size);
+
+  libench::CodestreamContext cs;
+
+  cs.codestream = out.data();
+  cs.size = out.size();
+
+  return cs;
+}
+
 /*
  * PNGDecoder
  */
@@ -44,30 +104,55 @@ libench::PNGDecoder::PNGDecoder() {
 }
 
 libench::PNGDecoder::~PNGDecoder() {
-  free(this->image_.planes8[0]);
+  lodepng_free(this->image_.planes8[0]);
 }
 
 libench::ImageContext libench::PNGDecoder::decodeRGB8(const CodestreamContext& cs) {
-  return this->decode8(cs, 3);
+  return this->decode8(cs, libench::ImageFormat::RGB8);
 }
 
 libench::ImageContext libench::PNGDecoder::decodeRGBA8(const CodestreamContext& cs) {
-  return this->decode8(cs, 4);
+  return this->decode8(cs, libench::ImageFormat::RGBA8);
 }
 
-libench::ImageContext libench::PNGDecoder::decode8(const CodestreamContext& cs, uint8_t num_comps) {
-  int ret;
-
-  free(this->image_.planes8[0]);
+/* as in PNGEncoder::encode8(), the pixels allocated by lodepng are returned as is */
+libench::ImageContext libench::PNGDecoder::decode8(const CodestreamContext& cs, const ImageFormat& format) {
+  lodepng_free(this->image_.planes8[0]);
+  this->image_.planes8[0] = NULL;
 
-  this->image_.format = num_comps == 3 ? libench::ImageFormat::RGB8 : libench::ImageFormat::RGBA8;
+  this->image_.format = format;
 
-  ret = lodepng_decode_memory(&this->image_.planes8[0], &this->image_.width,
-                              &this->image_.height, cs.codestream, cs.size,
-                              num_comps == 3 ? LCT_RGB : LCT_RGBA, 8);
+  int ret = lodepng_decode_memory(&this->image_.planes8[0], &this->image_.width,
+                                  &this->image_.height, cs.codestream, cs.size,
+                                  format.comps.num_comps == 3 ? LCT_RGB : LCT_RGBA, 8);
 
   if (ret)
     throw std::runtime_error("PNG decode failed");
 
   return this->image_;
 }
+
+void libench::PNGDecoder::decodeInto(const CodestreamContext& cs, ImageContext& image) {
+  if (!(image.format == libench::ImageFormat::RGB8 || image.format == libench::ImageFormat::RGBA8))
+    throw std::runtime_error("Unsupported image format");
+
+  ArenaScope scope;
+
+  unsigned char* pixels = NULL;
+  unsigned width;
+  unsigned height;
+
+  int ret = lodepng_decode_memory(&pixels, &width, &height, cs.codestream, cs.size,
+                                  image.format.comps.num_comps == 3 ? LCT_RGB : LCT_RGBA, 8);
+
+  LodePNGBuffer owner(pixels);
+
+  if (ret)
+    throw std::runtime_error("PNG decode failed");
+
+  if (width != image.width || height != image.height)
+    throw std::runtime_error("Destination image does not match the codestream");
+
+  /* lodepng has no decode-into API, so its output is copied, then freed */
+  memcpy(image.planes8[0], pixels, image.plane_size(0));
+}
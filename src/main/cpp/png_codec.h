@@ -17,6 +17,8 @@ class PNGEncoder : public Encoder {
 
   CodestreamContext encodeRGBA8(const ImageContext &image);
 
+  CodestreamContext encodeInto(const ImageContext &image, OutputBuffer& out);
+
  private:
   CodestreamContext encode8(const ImageContext &image);
 
@@ -32,12 +34,14 @@ class PNGDecoder : public Decoder {
 
   virtual ImageContext decodeRGBA8(const CodestreamContext& cs);
 
+  virtual void decodeInto(const CodestreamContext& cs, ImageContext& image);
+
  private:
-  ImageContext decode8(const CodestreamContext& cs, uint8_t num_comps);
+  ImageContext decode8(const CodestreamContext& cs, const ImageFormat& format);
 
   ImageContext image_;
 };
 
 }  // namespace libench
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,350 @@
+#include "profiler.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <link.h>
+#include <linux/perf_event.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * data pages of the ring buffer, a power of 2; at the default period, frame
+ * pointer samples fill 2 MB in about 100 ms, so the ring is drained by a
+ * reader thread that is woken once it is half full
+ */
+static const size_t RING_PAGE_COUNT = 512;
+
+/* the reader thread also wakes up periodically to check whether it should stop */
+static const int READER_POLL_TIMEOUT_MS = 50;
+
+static int perf_event_open(perf_event_attr* attr) {
+  return (int) syscall(SYS_perf_event_open, attr, 0 /* calling thread */, -1 /* any CPU */, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+static std::string demangle(const char* name) {
+  int status;
+  char* demangled = abi::__cxa_demangle(name, NULL, NULL, &status);
+
+  if (status != 0)
+    return name;
+
+  std::string result(demangled);
+  free(demangled);
+
+  return result;
+}
+
+static int main_program_bias(struct dl_phdr_info* info, size_t size, void* data) {
+  /* the main program is reported first */
+  *static_cast<ElfW(Addr)*>(data) = info->dlpi_addr;
+  return 1;
+}
+
+libench::SamplingProfiler::CallChain libench::SamplingProfiler::parseCallChain(const std::string& name) {
+  if (name == "fp") {
+    return CallChain::FP;
+  } else if (name == "lbr") {
+    return CallChain::LBR;
+  }
+
+  throw std::runtime_error("Unknown call chain: " + name);
+}
+
+libench::SamplingProfiler::SamplingProfiler(const std::string& dir, uint64_t period, CallChain call_chain)
+    : dir_(dir), call_chain_(call_chain), fd_(-1), ring_(NULL), ring_size_(0), lost_count_(0), is_stopping_(false) {
+  size_t page_size = sysconf(_SC_PAGESIZE);
+
+  perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_CPU_CYCLES;
+  attr.sample_period = period;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.watermark = 1;
+  attr.wakeup_watermark = RING_PAGE_COUNT * page_size / 2;
+
+  if (call_chain == CallChain::FP) {
+    attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_CALLCHAIN;
+    attr.exclude_callchain_kernel = 1;
+  } else {
+    attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_BRANCH_STACK;
+    attr.branch_sample_type = PERF_SAMPLE_BRANCH_USER | PERF_SAMPLE_BRANCH_CALL_STACK;
+  }
+
+  this->fd_ = perf_event_open(&attr);
+
+  /* e.g. in virtual machines without a PMU, LBR being unavailable there as well */
+  if (this->fd_ < 0 && call_chain == CallChain::FP) {
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_TASK_CLOCK;
+
+    this->fd_ = perf_event_open(&attr);
+  }
+
+  if (this->fd_ < 0)
+    throw std::runtime_error(std::string("perf_event_open failed, see /proc/sys/kernel/perf_event_paranoid: ") + strerror(errno));
+
+  this->ring_size_ = (RING_PAGE_COUNT + 1) * page_size;
+
+  void* ring = mmap(NULL, this->ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED, this->fd_, 0);
+
+  if (ring == MAP_FAILED) {
+    close(this->fd_);
+    throw std::runtime_error("Cannot map the perf ring buffer");
+  }
+
+  this->ring_ = static_cast<uint8_t*>(ring);
+
+  this->loadSymbols();
+
+  this->reader_ = std::thread(&SamplingProfiler::runReader, this);
+}
+
+/* function symbols of the executable */
+void libench::SamplingProfiler::loadSymbols() {
+  ElfW(Addr) bias = 0;
+
+  dl_iterate_phdr(main_program_bias, &bias);
+
+  std::ifstream exe("/proc/self/exe", std::ios::binary);
+  std::vector<char> image((std::istreambuf_iterator<char>(exe)), std::istreambuf_iterator<char>());
+
+  if (image.size() < sizeof(Elf64_Ehdr) || memcmp(image.data(), ELFMAG, SELFMAG) || image[EI_CLASS] != ELFCLASS64)
+    return;
+
+  const Elf64_Ehdr* ehdr = reinterpret_cast<const Elf64_Ehdr*>(image.data());
+
+  if (ehdr->e_shoff + (uint64_t) ehdr->e_shnum * sizeof(Elf64_Shdr) > image.size())
+    return;
+
+  const Elf64_Shdr* shdrs = reinterpret_cast<const Elf64_Shdr*>(image.data() + ehdr->e_shoff);
+
+  /* the full symbol table if the executable is not stripped, else the dynamic symbols */
+  const Elf64_Shdr* symtab = NULL;
+
+  for (int i = 0; i < ehdr->e_shnum; i++) {
+    if (shdrs[i].sh_type == SHT_SYMTAB || (shdrs[i].sh_type == SHT_DYNSYM && symtab == NULL))
+      symtab = &shdrs[i];
+  }
+
+  if (symtab == NULL || symtab->sh_link >= ehdr->e_shnum)
+    return;
+
+  const Elf64_Shdr* strtab = &shdrs[symtab->sh_link];
+
+  if (symtab->sh_offset + symtab->sh_size > image.size() || strtab->sh_offset + strtab->sh_size > image.size())
+    return;
+
+  const Elf64_Sym* syms = reinterpret_cast<const Elf64_Sym*>(image.data() + symtab->sh_offset);
+  const char* names = image.data() + strtab->sh_offset;
+
+  for (size_t i = 0; i < symtab->sh_size / sizeof(Elf64_Sym); i++) {
+    if (ELF64_ST_TYPE(syms[i].st_info) != STT_FUNC || syms[i].st_value == 0 || syms[i].st_name >= strtab->sh_size)
+      continue;
+
+    this->elf_symbols_.push_back(Symbol{syms[i].st_value + bias, syms[i].st_size, demangle(names + syms[i].st_name)});
+  }
+
+  std::sort(this->elf_symbols_.begin(), this->elf_symbols_.end());
+}
+
+libench::SamplingProfiler::~SamplingProfiler() {
+  this->is_stopping_ = true;
+  this->reader_.join();
+
+  /* destructors must not throw */
+  try {
+    this->write();
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  }
+
+  munmap(this->ring_, this->ring_size_);
+  close(this->fd_);
+}
+
+void libench::SamplingProfiler::begin(const std::string& label) {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+
+    this->label_ = label;
+  }
+
+  ioctl(this->fd_, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+void libench::SamplingProfiler::end() {
+  ioctl(this->fd_, PERF_EVENT_IOC_DISABLE, 0);
+
+  /* the remaining samples of the phase are drained before the label changes */
+  std::lock_guard<std::mutex> lock(this->mutex_);
+
+  this->drain();
+}
+
+void libench::SamplingProfiler::runReader() {
+  pollfd fds = {this->fd_, POLLIN, 0};
+
+  while (! this->is_stopping_) {
+    poll(&fds, 1, READER_POLL_TIMEOUT_MS);
+
+    std::lock_guard<std::mutex> lock(this->mutex_);
+
+    this->drain();
+  }
+}
+
+/*
+ * drains the ring, with mutex_ held; samples that did not fit in the ring are
+ * reported by the kernel as lost
+ */
+void libench::SamplingProfiler::drain() {
+  perf_event_mmap_page* meta = reinterpret_cast<perf_event_mmap_page*>(this->ring_);
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  const uint8_t* data = this->ring_ + page_size;
+  size_t data_size = this->ring_size_ - page_size;
+
+  uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+  uint64_t tail = meta->data_tail;
+
+  std::vector<uint8_t> record;
+
+  /* copies bytes from the ring, which wraps around */
+  auto read = [&](uint64_t offset, size_t size) {
+    record.resize(size);
+    for (size_t i = 0; i < size; i++)
+      record[i] = data[(offset + i) % data_size];
+  };
+
+  std::map<std::vector<uint64_t>, uint64_t>& stacks = this->stacks_[this->label_];
+
+  while (tail < head) {
+    read(tail, sizeof(perf_event_header));
+
+    perf_event_header header;
+    memcpy(&header, record.data(), sizeof(header));
+
+    if (header.size < sizeof(header))
+      break;
+
+    read(tail, header.size);
+
+    const uint64_t* fields = reinterpret_cast<const uint64_t*>(record.data() + sizeof(header));
+    size_t field_count = (header.size - sizeof(header)) / sizeof(uint64_t);
+
+    if (header.type == PERF_RECORD_SAMPLE && field_count >= 2) {
+      /* leaf first; caller addresses are moved into the call instruction */
+      std::vector<uint64_t> chain = {fields[0]};
+      uint64_t count = std::min<uint64_t>(fields[1], field_count - 2);
+
+      if (this->call_chain_ == CallChain::FP) {
+        /* the chain starts with a context marker and the sampled instruction itself */
+        bool is_leaf = true;
+
+        for (uint64_t i = 0; i < count; i++) {
+          if (fields[2 + i] >= (uint64_t) PERF_CONTEXT_MAX)
+            continue;
+
+          if (! is_leaf)
+            chain.push_back(fields[2 + i] - 1);
+
+          is_leaf = false;
+        }
+      } else {
+        /* each entry is a perf_branch_entry, whose first field is the address of the call */
+        count = std::min<uint64_t>(fields[1], (field_count - 2) / 3);
+
+        for (uint64_t i = 0; i < count; i++)
+          chain.push_back(fields[2 + 3 * i]);
+      }
+
+      stacks[chain]++;
+    } else if (header.type == PERF_RECORD_LOST && field_count >= 2) {
+      this->lost_count_ += fields[1];
+    }
+
+    tail += header.size;
+  }
+
+  __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+std::string libench::SamplingProfiler::symbolize(uint64_t address) {
+  auto cached = this->symbols_.find(address);
+
+  if (cached != this->symbols_.end())
+    return cached->second;
+
+  std::string name;
+
+  auto it = std::upper_bound(this->elf_symbols_.begin(), this->elf_symbols_.end(), Symbol{address, 0, ""});
+
+  Dl_info info;
+
+  if (it != this->elf_symbols_.begin() && address < (it - 1)->address + std::max<uint64_t>((it - 1)->size, 1)) {
+    name = (it - 1)->name;
+  } else if (dladdr(reinterpret_cast<void*>(address), &info) && info.dli_sname) {
+    name = demangle(info.dli_sname);
+  } else if (dladdr(reinterpret_cast<void*>(address), &info) && info.dli_fname) {
+    const char* base = strrchr(info.dli_fname, '/');
+    name = std::string("[") + (base ? base + 1 : info.dli_fname) + "]";
+  } else {
+    name = "[unknown]";
+  }
+
+  /* semicolons separate the frames of folded stacks */
+  std::replace(name.begin(), name.end(), ';', ':');
+
+  this->symbols_[address] = name;
+
+  return name;
+}
+
+void libench::SamplingProfiler::write() {
+  if (mkdir(this->dir_.c_str(), 0755) && errno != EEXIST)
+    throw std::runtime_error("Cannot create profile directory: " + this->dir_);
+
+  for (const auto& label : this->stacks_) {
+    if (label.second.empty())
+      continue;
+
+    std::string path = this->dir_ + "/" + label.first + ".folded";
+    std::ofstream f(path);
+
+    if (! f)
+      throw std::runtime_error("Cannot open profile file: " + path);
+
+    /* stacks that differ only by addresses within the same functions are merged */
+    std::map<std::string, uint64_t> folded;
+
+    for (const auto& stack : label.second) {
+      std::string line;
+
+      for (auto it = stack.first.rbegin(); it != stack.first.rend(); it++)
+        line += (line.empty() ? "" : ";") + this->symbolize(*it);
+
+      folded[line] += stack.second;
+    }
+
+    for (const auto& stack : folded)
+      f << stack.first << " " << stack.second << std::endl;
+  }
+
+  if (this->lost_count_ > 0)
+    std::cerr << "Profiler: " << this->lost_count_ << " samples lost, consider a longer sampling period" << std::endl;
+}
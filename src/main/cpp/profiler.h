@@ -0,0 +1,106 @@
+#ifndef LIBENCH_PROFILER_H
+#define LIBENCH_PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace libench {
+
+/*
+ * Sampling profiler of the calling thread, based on perf_event_open; threads
+ * created by the codecs are not sampled. Samples are only taken between
+ * begin() and end(), and are attributed to the label passed to begin(), e.g.
+ * jxl.encode. The call chains are read from the frame pointers, which requires
+ * the codec libraries to be built with -fno-omit-frame-pointer (see
+ * LIBENCH_FRAME_POINTERS), or from the last branch records (LBR) of the CPU.
+ */
+class SamplingProfiler {
+ public:
+  enum class CallChain { FP, LBR };
+
+  /* accepts "fp" or "lbr" */
+  static CallChain parseCallChain(const std::string& name);
+
+  /*
+   * samples every period CPU cycles, or, where hardware counters are not
+   * available, every period nanoseconds of CPU time; the folded stacks of each
+   * label are written to <dir>/<label>.folded when the profiler is destroyed
+   */
+  SamplingProfiler(const std::string& dir, uint64_t period, CallChain call_chain);
+  ~SamplingProfiler();
+
+  SamplingProfiler(const SamplingProfiler&) = delete;
+  SamplingProfiler& operator=(const SamplingProfiler&) = delete;
+
+  void begin(const std::string& label);
+
+  void end();
+
+ private:
+  void loadSymbols();
+
+  /* body of the reader thread, which drains the ring as it fills */
+  void runReader();
+
+  void drain();
+
+  /* writes the folded stacks, one line per distinct stack of the form root;...;leaf count */
+  void write();
+
+  std::string symbolize(uint64_t address);
+
+  std::string dir_;
+  CallChain call_chain_;
+  int fd_;
+  uint8_t* ring_;
+  size_t ring_size_;
+  std::string label_;
+  uint64_t lost_count_;
+  std::atomic<bool> is_stopping_;
+  /* guards label_, lost_count_, stacks_ and the tail of the ring */
+  std::mutex mutex_;
+  std::thread reader_;
+  /* per label, number of samples of each call chain, leaf first */
+  std::map<std::string, std::map<std::vector<uint64_t>, uint64_t>> stacks_;
+  std::map<uint64_t, std::string> symbols_;
+
+  struct Symbol {
+    uint64_t address;
+    uint64_t size;
+    std::string name;
+
+    bool operator<(const Symbol& other) const { return this->address < other.address; }
+  };
+
+  /* function symbols of the executable, which links the codec libraries statically, at their run-time address */
+  std::vector<Symbol> elf_symbols_;
+};
+
+/* profiles a phase, if profiler is not NULL, for the duration of the scope */
+class ProfileScope {
+ public:
+  ProfileScope(SamplingProfiler* profiler, const std::string& label) : profiler_(profiler) {
+    if (this->profiler_)
+      this->profiler_->begin(label);
+  }
+
+  ~ProfileScope() {
+    if (this->profiler_)
+      this->profiler_->end();
+  }
+
+  ProfileScope(const ProfileScope&) = delete;
+  ProfileScope& operator=(const ProfileScope&) = delete;
+
+ private:
+  SamplingProfiler* profiler_;
+};
+
+}  // namespace libench
+
+#endif
@@ -1,10 +1,25 @@
 #include "qoi_codec.h"
+#include "allocator.h"
 #include <climits>
+#include <cstring>
 #include <memory>
+#include <stdexcept>
 
+/* QOI allocations are served from the arena of the calling thread */
+#define QOI_MALLOC(sz) libench_malloc(sz)
+#define QOI_FREE(p) libench_free(p)
 #define QOI_IMPLEMENTATION
 #include "qoi.h"
 
+/* frees a buffer returned by QOI, whichever allocator backend is selected */
+struct QOIDeleter {
+  void operator()(uint8_t* ptr) const {
+    QOI_FREE(ptr);
+  }
+};
+
+typedef std::unique_ptr<uint8_t, QOIDeleter> QOIBuffer;
+
 /*
  * QOIEncoder
  */
@@ -12,7 +27,7 @@
 libench::QOIEncoder::QOIEncoder() {}
 
 libench::QOIEncoder::~QOIEncoder() {
-  free(this->cs_.codestream);
+  QOI_FREE(this->cs_.codestream);
 }
 
 libench::CodestreamContext libench::QOIEncoder::encodeRGB8(const ImageContext &image) {
@@ -23,8 +38,12 @@ libench::CodestreamContext libench::QOIEncoder::encodeRGBA8(const ImageContext &
   return this->encode8(image);
 }
 
+/*
+ * the codestream allocated by QOI is returned as is, so it is allocated
+ * outside of any ArenaScope and is freed on the next call
+ */
 libench::CodestreamContext libench::QOIEncoder::encode8(const ImageContext &image) {
-  free(this->cs_.codestream);
+  QOI_FREE(this->cs_.codestream);
 
   qoi_desc desc = {.width = image.width,
                    .height = image.height,
@@ -35,11 +54,45 @@ libench::CodestreamContext libench::QOIEncoder::encode8(const ImageContext &imag
 
   this->cs_.codestream = (uint8_t*)qoi_encode(image.planes8[0], &desc, &codestream_size);
 
+  if (!this->cs_.codestream)
+    throw std::runtime_error("QOI encode failed");
+
   this->cs_.size = codestream_size;
 
   return this->cs_;
 }
 
+libench::CodestreamContext libench::QOIEncoder::encodeInto(const ImageContext &image, OutputBuffer& out) {
+  if (!(image.format == libench::ImageFormat::RGB8 || image.format == libench::ImageFormat::RGBA8))
+    throw std::runtime_error("Unsupported image format");
+
+  ArenaScope scope;
+
+  qoi_desc desc = {.width = image.width,
+                   .height = image.height,
+                   .channels = image.format.comps.num_comps,
+                   .colorspace = QOI_SRGB};
+
+  int codestream_size;
+
+  uint8_t* codestream = (uint8_t*)qoi_encode(image.planes8[0], &desc, &codestream_size);
+
+  QOIBuffer owner(codestream);
+
+  if (!codestream)
+    throw std::runtime_error("QOI encode failed");
+
+  out.clear();
+  out.append(codestream, codestream_size);
+
+  libench::CodestreamContext cs;
+
+  cs.codestream = out.data();
+  cs.size = out.size();
+
+  return cs;
+}
+
 /*
  * QOIDecoder
  */
@@ -48,7 +101,7 @@ libench::QOIDecoder::QOIDecoder() {
 }
 
 libench::QOIDecoder::~QOIDecoder() {
-  free(this->image_.planes8[0]);
+  QOI_FREE(this->image_.planes8[0]);
 }
 
 libench::ImageContext libench::QOIDecoder::decodeRGB8(const CodestreamContext& cs) {
@@ -59,15 +112,39 @@ libench::ImageContext libench::QOIDecoder::decodeRGBA8(const CodestreamContext&
   return this->decode8(cs);
 }
 
+/* as in QOIEncoder::encode8(), the pixels allocated by QOI are returned as is */
 libench::ImageContext libench::QOIDecoder::decode8(const CodestreamContext& cs) {
   qoi_desc desc;
 
-  free(this->image_.planes8[0]);
+  QOI_FREE(this->image_.planes8[0]);
 
   this->image_.planes8[0] = (uint8_t*)qoi_decode(cs.codestream, cs.size, &desc, 0);
+
+  if (!this->image_.planes8[0])
+    throw std::runtime_error("QOI decode failed");
+
   this->image_.width = desc.width;
   this->image_.height = desc.height;
   this->image_.format = desc.channels == 3 ? libench::ImageFormat::RGB8 : libench::ImageFormat::RGBA8;
 
   return this->image_;
 }
+
+void libench::QOIDecoder::decodeInto(const CodestreamContext& cs, ImageContext& image) {
+  ArenaScope scope;
+
+  qoi_desc desc;
+
+  uint8_t* pixels = (uint8_t*)qoi_decode(cs.codestream, cs.size, &desc, 0);
+
+  QOIBuffer owner(pixels);
+
+  if (!pixels)
+    throw std::runtime_error("QOI decode failed");
+
+  if (desc.width != image.width || desc.height != image.height || desc.channels != image.format.comps.num_comps)
+    throw std::runtime_error("Destination image does not match the codestream");
+
+  /* QOI has no decode-into API, so its output is copied, then freed */
+  memcpy(image.planes8[0], pixels, image.plane_size(0));
+}
@@ -17,6 +17,8 @@ class QOIEncoder : public Encoder {
 
   CodestreamContext encodeRGBA8(const ImageContext &image);
 
+  CodestreamContext encodeInto(const ImageContext &image, OutputBuffer& out);
+
  private:
   CodestreamContext encode8(const ImageContext &image);
 
@@ -32,6 +34,8 @@ class QOIDecoder : public Decoder {
 
   virtual ImageContext decodeRGBA8(const CodestreamContext& cs);
 
+  virtual void decodeInto(const CodestreamContext& cs, ImageContext& image);
+
  private:
   ImageContext decode8(const CodestreamContext& cs);
 
@@ -40,4 +44,4 @@ class QOIDecoder : public Decoder {
 
 }  // namespace libench
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,285 @@
+#include "run_record.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#if defined(__aarch64__) && defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+#include "build_info.h"
+#include "codec_factory.h"
+#include "sampling.h"
+
+struct Submodule {
+  const char* path;
+  const char* sha;
+};
+
+static const Submodule SUBMODULES[] = {LIBENCH_SUBMODULES};
+
+static std::string submodule_sha(const std::string& path) {
+  for (const Submodule* s = SUBMODULES; s->path != NULL; s++) {
+    if (path == s->path)
+      return s->sha;
+  }
+
+  return "unknown";
+}
+
+static std::string json_string(const std::string& s) {
+  std::string out = "\"";
+
+  for (char c : s) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      if ((unsigned char) c < 0x20) {
+        char escaped[7];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        out += escaped;
+      } else {
+        out += c;
+      }
+    }
+  }
+
+  return out + "\"";
+}
+
+static std::string cpu_model() {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+
+  while (std::getline(cpuinfo, line)) {
+    if (line.compare(0, 10, "model name") == 0) {
+      size_t sep = line.find(':');
+      if (sep != std::string::npos && sep + 2 <= line.size())
+        return line.substr(sep + 2);
+    }
+  }
+
+  return "unknown";
+}
+
+std::string libench::image_format_name(const ImageFormat& format) {
+  if (! format.is_planar)
+    return format.comps.name + std::to_string(format.bit_depth);
+
+  std::string sampling = "444";
+
+  if (format.x_sub_factor[1] == 2) {
+    sampling = format.y_sub_factor[1] == 2 ? "420" : "422";
+  }
+
+  return format.comps.name + sampling + "P" + std::to_string(format.bit_depth);
+}
+
+std::vector<std::string> libench::cpu_features() {
+  std::vector<std::string> features;
+
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+
+  /* __builtin_cpu_supports() only accepts string literals */
+#define LIBENCH_X86_FEATURE(name) if (__builtin_cpu_supports(name)) features.push_back(name);
+  LIBENCH_X86_FEATURE("sse2")
+  LIBENCH_X86_FEATURE("ssse3")
+  LIBENCH_X86_FEATURE("sse4.1")
+  LIBENCH_X86_FEATURE("sse4.2")
+  LIBENCH_X86_FEATURE("avx")
+  LIBENCH_X86_FEATURE("avx2")
+  LIBENCH_X86_FEATURE("fma")
+  LIBENCH_X86_FEATURE("bmi2")
+  LIBENCH_X86_FEATURE("avx512f")
+  LIBENCH_X86_FEATURE("avx512bw")
+  LIBENCH_X86_FEATURE("avx512vl")
+#undef LIBENCH_X86_FEATURE
+#elif defined(__aarch64__) && defined(__linux__)
+  unsigned long hwcap = getauxval(AT_HWCAP);
+
+  if (hwcap & HWCAP_ASIMD)
+    features.push_back("neon");
+#ifdef HWCAP_SVE
+  if (hwcap & HWCAP_SVE)
+    features.push_back("sve");
+#endif
+#endif
+
+  return features;
+}
+
+static void write_times(std::ostream& os, const char* name,
+                        const std::vector<std::chrono::system_clock::time_point::duration>& times) {
+  double sum = 0;
+
+  os << ", \"" << name << "Times\" : [";
+  for (size_t i = 0; i < times.size(); i++) {
+    double t = std::chrono::duration<double>(times[i]).count();
+    sum += t;
+    os << (i ? ", " : "") << t;
+  }
+  os << "]";
+
+  /* mean and its precision, so that the record can be loaded as columns without post-processing */
+  os << ", \"" << name << "Time\" : ";
+  if (times.empty()) {
+    os << "null";
+  } else {
+    os << sum / times.size();
+  }
+
+  double precision = libench::relative_ci_half_width(times);
+
+  os << ", \"" << name << "Precision\" : ";
+  if (precision < 0) {
+    os << "null";
+  } else {
+    os << precision;
+  }
+}
+
+/* fields that identify the build, the first preceded by sep */
+static void write_build_fields(std::ostream& os, const char* sep) {
+  os << sep << "\"libenchVersion\" : " << json_string(LIBENCH_VERSION);
+  os << ", \"compiler\" : " << json_string(LIBENCH_COMPILER);
+  os << ", \"buildType\" : " << json_string(LIBENCH_BUILD_TYPE);
+  os << ", \"cxxFlags\" : " << json_string(LIBENCH_CXX_FLAGS);
+
+  os << ", \"submodules\" : {";
+  for (const Submodule* s = SUBMODULES; s->path != NULL; s++) {
+    os << (s != SUBMODULES ? ", " : "") << json_string(s->path) << " : " << json_string(s->sha);
+  }
+  os << "}";
+}
+
+void libench::write_run_record(std::ostream& os, const TestContext& test, const RunSettings& settings) {
+  std::string library = codec_library(settings.codec);
+
+  time_t now = time(NULL);
+  char timestamp[32];
+  strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+  const char* omp_num_threads = getenv("OMP_NUM_THREADS");
+
+  os << "{\"schemaVersion\" : " << RUN_RECORD_SCHEMA_VERSION;
+  os << ", \"timestamp\" : " << json_string(timestamp);
+
+  /* run */
+
+  os << ", \"codec\" : " << json_string(settings.codec);
+  os << ", \"codecOptions\" : " << json_string(settings.codec_options);
+  os << ", \"codecLibrary\" : " << json_string(library);
+  os << ", \"codecVersion\" : " << json_string(library.empty() ? "unknown" : submodule_sha(library));
+  os << ", \"setName\" : " << json_string(settings.set_name);
+  os << ", \"pages\" : " << json_string(settings.pages);
+  os << ", \"allocator\" : " << json_string(settings.allocator);
+  os << ", \"isa\" : " << json_string(settings.isa);
+  os << ", \"effectiveIsa\" : " << json_string(settings.effective_isa);
+  os << ", \"encoderBackend\" : " << (settings.encoder_backend.empty() ? "null" : json_string(settings.encoder_backend));
+  os << ", \"decoderBackend\" : " << (settings.decoder_backend.empty() ? "null" : json_string(settings.decoder_backend));
+  os << ", \"cold\" : " << (settings.cold.empty() ? "null" : json_string(settings.cold));
+  os << ", \"into\" : " << (settings.is_into ? "true" : "false");
+  os << ", \"decodeOnly\" : " << (settings.is_decode_only ? "true" : "false");
+  os << ", \"batch\" : " << (settings.is_batch ? "true" : "false");
+
+  /* image */
+
+  os << ", \"imagePath\" : " << json_string(test.image_path);
+  os << ", \"imageHash\" : " << json_string(hex_hash(test.image_hash));
+  os << ", \"imageFormat\" : " << json_string(image_format_name(test.image.format));
+  os << ", \"imageWidth\" : " << test.image.width;
+  os << ", \"imageHeight\" : " << test.image.height;
+  os << ", \"imageSize\" : " << test.image_sz;
+
+  /* measurements */
+
+  os << ", \"codestreamSize\" : " << test.codestream_sz;
+  os << ", \"repetitions\" : " << std::max(test.encode_times.size(), test.decode_times.size());
+  os << ", \"encodeInnerIterations\" : " << test.encode_inner_iterations;
+  os << ", \"decodeInnerIterations\" : " << test.decode_inner_iterations;
+  write_times(os, "encode", test.encode_times);
+  write_times(os, "decode", test.decode_times);
+  if (! settings.cold.empty()) {
+    write_times(os, "coldEncode", test.cold_encode_times);
+    write_times(os, "coldDecode", test.cold_decode_times);
+  }
+
+  /* build */
+
+  write_build_fields(os, ", ");
+
+  /* machine */
+
+  os << ", \"cpuModel\" : " << json_string(cpu_model());
+
+  std::vector<std::string> features = cpu_features();
+  os << ", \"cpuFeatures\" : [";
+  for (size_t i = 0; i < features.size(); i++) {
+    os << (i ? ", " : "") << json_string(features[i]);
+  }
+  os << "]";
+
+  os << ", \"hardwareThreads\" : " << std::thread::hardware_concurrency();
+  os << ", \"ompNumThreads\" : " << (omp_num_threads ? json_string(omp_num_threads) : "null");
+
+  os << "}" << std::endl;
+}
+
+void libench::write_build_info(std::ostream& os) {
+  os << "{";
+  write_build_fields(os, "");
+
+  std::vector<std::string> names = codec_names();
+  os << ", \"codecLibraries\" : {";
+  for (size_t i = 0; i < names.size(); i++) {
+    os << (i ? ", " : "") << json_string(names[i]) << " : " << json_string(codec_library(names[i]));
+  }
+  os << "}";
+
+  os << "}" << std::endl;
+}
+
+/*
+ * RunRecordWriter
+ */
+
+libench::RunRecordWriter::RunRecordWriter(const std::string& path) : os_(&std::cout) {
+  if (path != "-") {
+    this->file_.open(path, std::ios::app);
+    if (! this->file_)
+      throw std::runtime_error("Cannot open record file: " + path);
+
+    this->os_ = &this->file_;
+  }
+}
+
+void libench::RunRecordWriter::write(const TestContext& test, const RunSettings& settings) {
+  /* the record is written at once, so that records appended by concurrent processes do not interleave */
+  std::ostringstream record;
+
+  write_run_record(record, test, settings);
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+
+  *this->os_ << record.str() << std::flush;
+
+  if (! *this->os_)
+    throw std::runtime_error("Cannot write record");
+}
@@ -0,0 +1,84 @@
+#ifndef LIBENCH_RUN_RECORD_H
+#define LIBENCH_RUN_RECORD_H
+
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "codec.h"
+#include "test_context.h"
+
+namespace libench {
+
+/* incremented whenever a field of the record is renamed, removed or changes meaning */
+const int RUN_RECORD_SCHEMA_VERSION = 1;
+
+/* how the run was performed, in addition to what TestContext records */
+struct RunSettings {
+  std::string codec;
+  /* canonical form, see format_codec_options() */
+  std::string codec_options;
+  std::string set_name;
+  std::string pages;
+  std::string allocator;
+  /* requested SIMD instruction set level, see isa.h */
+  std::string isa;
+  /* level actually used by the codec library */
+  std::string effective_isa;
+  /* see Encoder::backend() */
+  std::string encoder_backend;
+  std::string decoder_backend;
+  /* cache eviction method, empty unless --cold */
+  std::string cold;
+  bool is_into;
+  bool is_decode_only;
+  bool is_batch;
+
+  RunSettings() : is_into(false), is_decode_only(false), is_batch(false) {}
+};
+
+/* e.g. RGB8, RGBA8 or YUV422P10 */
+std::string image_format_name(const ImageFormat& format);
+
+/* instruction set extensions supported by the CPU, e.g. avx2 */
+std::vector<std::string> cpu_features();
+
+/*
+ * Writes a run as a single-line JSON object that carries, in addition to the
+ * measurements, the versions of libench and of the codec library, the build
+ * flags and the CPU, so that records from different runs can be concatenated
+ * and loaded as columns.
+ */
+void write_run_record(std::ostream& os, const TestContext& test, const RunSettings& settings);
+
+/*
+ * Writes the build fields of the run records, i.e. the libench version, the
+ * compiler and its flags and the submodule revisions, followed by the library
+ * of each codec, see codec_library(), as a single-line JSON object
+ */
+void write_build_info(std::ostream& os);
+
+/*
+ * Appends records to a JSON Lines file, or to stdout if the path is "-". Each
+ * record is flushed as soon as it is written, so that the records of the runs
+ * completed before a crash are kept. write() may be called from any thread.
+ */
+class RunRecordWriter {
+ public:
+  explicit RunRecordWriter(const std::string& path);
+
+  RunRecordWriter(const RunRecordWriter&) = delete;
+  RunRecordWriter& operator=(const RunRecordWriter&) = delete;
+
+  void write(const TestContext& test, const RunSettings& settings);
+
+ private:
+  std::ofstream file_;
+  std::ostream* os_;
+  std::mutex mutex_;
+};
+
+}  // namespace libench
+
+#endif
@@ -0,0 +1,96 @@
+#include "sampling.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+/* two-sided 97.5% quantiles of Student's t distribution for 1 to 30 degrees of freedom */
+static const double T_QUANTILES[] = {
+  12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+  2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+  2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+/* normal approximation beyond 30 degrees of freedom */
+static const double Z_QUANTILE = 1.960;
+
+double libench::relative_ci_half_width(const std::vector<Duration>& samples) {
+  size_t n = samples.size();
+
+  if (n < 2)
+    return -1;
+
+  double sum = 0;
+  for (const auto& s : samples)
+    sum += std::chrono::duration<double>(s).count();
+
+  double mean = sum / n;
+
+  if (mean <= 0)
+    return -1;
+
+  double sq_sum = 0;
+  for (const auto& s : samples) {
+    double d = std::chrono::duration<double>(s).count() - mean;
+    sq_sum += d * d;
+  }
+
+  double sd = std::sqrt(sq_sum / (n - 1));
+  double t = n - 1 <= 30 ? T_QUANTILES[n - 2] : Z_QUANTILE;
+
+  return t * sd / std::sqrt((double) n) / mean;
+}
+
+int libench::inner_iterations(Duration single_call, Duration min_sample_time) {
+  if (single_call >= min_sample_time)
+    return 1;
+
+  /* a call too short to be measured is treated as lasting 1 ns */
+  auto call_ns = std::max<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(single_call).count(), 1);
+  auto min_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(min_sample_time).count();
+
+  return (int) std::min<int64_t>((min_ns + call_ns - 1) / call_ns, 1 << 20);
+}
+
+/*
+ * AdaptiveSampler
+ */
+
+libench::AdaptiveSampler::AdaptiveSampler(int min_count, int max_count, double target_precision, Duration time_budget)
+    : min_count_(min_count), max_count_(max_count), target_precision_(target_precision), time_budget_(time_budget) {
+  if (min_count < 1)
+    throw std::runtime_error("At least one repetition is required");
+
+  this->start();
+}
+
+void libench::AdaptiveSampler::start() {
+  this->start_ = std::chrono::steady_clock::now();
+}
+
+bool libench::AdaptiveSampler::isDone(const std::vector<const std::vector<Duration>*>& series) const {
+  size_t count = 0;
+
+  for (const auto* s : series)
+    count = std::max(count, s->size());
+
+  if (count < (size_t) this->min_count_)
+    return false;
+
+  if (! this->isAdaptive() || count >= (size_t) this->max_count_)
+    return true;
+
+  if (this->time_budget_ > Duration::zero() && std::chrono::steady_clock::now() - this->start_ >= this->time_budget_)
+    return true;
+
+  if (this->target_precision_ <= 0)
+    return false;
+
+  for (const auto* s : series) {
+    double precision = relative_ci_half_width(*s);
+
+    if (precision < 0 || precision > this->target_precision_)
+      return false;
+  }
+
+  return true;
+}
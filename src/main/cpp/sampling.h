@@ -0,0 +1,54 @@
+#ifndef LIBENCH_SAMPLING_H
+#define LIBENCH_SAMPLING_H
+
+#include <chrono>
+#include <vector>
+
+namespace libench {
+
+typedef std::chrono::system_clock::time_point::duration Duration;
+
+/*
+ * half-width of the 95% confidence interval of the mean of the samples,
+ * relative to the mean, or a negative value if there are fewer than two samples
+ */
+double relative_ci_half_width(const std::vector<Duration>& samples);
+
+/*
+ * number of consecutive calls to time as a single sample so that the sample
+ * lasts at least min_sample_time, given the duration of a single call
+ */
+int inner_iterations(Duration single_call, Duration min_sample_time);
+
+/*
+ * Decides when to stop repeating a measurement: once at least min_count
+ * samples have been taken, sampling stops as soon as the relative confidence
+ * interval of every series is below the target precision, the time budget is
+ * exhausted or max_count samples have been taken. A zero target precision or
+ * time budget disables the corresponding criterion; if both are disabled,
+ * exactly min_count samples are taken.
+ */
+class AdaptiveSampler {
+ public:
+  AdaptiveSampler(int min_count, int max_count, double target_precision, Duration time_budget);
+
+  /* starts the time budget */
+  void start();
+
+  bool isDone(const std::vector<const std::vector<Duration>*>& series) const;
+
+  bool isAdaptive() const {
+    return this->target_precision_ > 0 || this->time_budget_ > Duration::zero();
+  }
+
+ private:
+  int min_count_;
+  int max_count_;
+  double target_precision_;
+  Duration time_budget_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace libench
+
+#endif
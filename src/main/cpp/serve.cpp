@@ -0,0 +1,336 @@
+#include "serve.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include "image_io.h"
+#include "trace.h"
+
+/* delay between the end of the setup and the first arrival */
+static const std::chrono::milliseconds SERVE_START_DELAY(10);
+
+struct ServeItem {
+  libench::ImageContext image;
+  std::vector<uint8_t> codestream;
+  std::vector<uint8_t> state;
+
+  libench::CodestreamContext cs() const {
+    libench::CodestreamContext cs;
+
+    cs.codestream = const_cast<uint8_t*>(this->codestream.data());
+    cs.size = this->codestream.size();
+    cs.state = this->state.empty() ? NULL : const_cast<uint8_t*>(this->state.data());
+    cs.state_size = this->state.size();
+
+    return cs;
+  }
+};
+
+struct ServeJob {
+  size_t item;
+  std::chrono::steady_clock::time_point arrival;
+};
+
+/* unbounded multi-consumer queue: an open-loop service does not push back on its clients */
+class ServeQueue {
+ public:
+  ServeQueue() : closed_(false) {}
+
+  void push(const ServeJob& job) {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      this->jobs_.push_back(job);
+    }
+    this->cv_.notify_one();
+  }
+
+  /* returns false once the queue is closed and drained */
+  bool pop(ServeJob& job) {
+    std::unique_lock<std::mutex> lock(this->mutex_);
+
+    this->cv_.wait(lock, [this]() { return ! this->jobs_.empty() || this->closed_; });
+
+    if (this->jobs_.empty())
+      return false;
+
+    job = this->jobs_.front();
+    this->jobs_.pop_front();
+
+    return true;
+  }
+
+  void close() {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      this->closed_ = true;
+    }
+    this->cv_.notify_all();
+  }
+
+ private:
+  std::deque<ServeJob> jobs_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool closed_;
+};
+
+std::vector<double> read_arrivals(const std::string& path) {
+  std::ifstream f(path);
+  if (! f)
+    throw std::runtime_error("Cannot open arrivals file");
+
+  std::vector<double> arrivals;
+  double t;
+
+  while (f >> t)
+    arrivals.push_back(t);
+
+  if (arrivals.empty())
+    throw std::runtime_error("Arrivals file is empty");
+
+  std::sort(arrivals.begin(), arrivals.end());
+
+  double first = arrivals.front();
+  for (auto& a : arrivals)
+    a -= first;
+
+  return arrivals;
+}
+
+double ServeReport::latency_quantile(double q) const {
+  if (this->latencies.empty())
+    return 0;
+
+  /* nearest rank: the smallest latency that at least q of the requests do not exceed */
+  double rank = std::ceil(q * this->latencies.size()) - 1;
+  size_t i = (size_t) std::min(std::max(rank, 0.0), (double) (this->latencies.size() - 1));
+
+  return std::chrono::duration<double>(this->latencies[i]).count();
+}
+
+ServeReport run_serve(const std::vector<std::string>& filepaths, const ServeConfig& config) {
+  if (filepaths.empty())
+    throw std::runtime_error("The corpus is empty");
+
+  if (config.worker_count < 1)
+    throw std::runtime_error("At least one worker is required");
+
+  if (config.arrivals.empty() && config.rate <= 0)
+    throw std::runtime_error("Either an arrival rate or replayed arrivals is required");
+
+  /* setup: load the corpus and, for decode requests, encode it and check the round trip */
+
+  std::unique_ptr<libench::Encoder> setup_encoder;
+  std::unique_ptr<libench::Decoder> setup_decoder;
+
+  libench::make_codec(config.codec, config.codec_options, setup_encoder, setup_decoder);
+
+  std::vector<ServeItem> items(filepaths.size());
+
+  for (size_t i = 0; i < filepaths.size(); i++) {
+    items[i].image = load_image(filepaths[i]);
+
+    if (config.is_encode)
+      continue;
+
+    libench::CodestreamContext cs = setup_encoder->encodeImage(items[i].image);
+
+    items[i].codestream.assign(cs.codestream, cs.codestream + cs.size);
+    items[i].state.assign((const uint8_t*) cs.state, (const uint8_t*) cs.state + cs.state_size);
+
+    uint8_t image_hash[MD5_BLOCK_SIZE];
+    uint8_t decoded_hash[MD5_BLOCK_SIZE];
+
+    items[i].image.md5(image_hash);
+    setup_decoder->decodeImage(items[i].cs(), items[i].image.format).md5(decoded_hash);
+
+    if (memcmp(image_hash, decoded_hash, MD5_BLOCK_SIZE))
+      throw std::runtime_error("Image does not match: " + filepaths[i]);
+  }
+
+  /* arrival schedule, in seconds from the start */
+
+  std::mt19937_64 rng(config.seed);
+  std::vector<double> arrivals = config.arrivals;
+
+  if (arrivals.empty()) {
+    std::exponential_distribution<double> interval(config.rate);
+    double t = 0;
+
+    for (int i = 0; i < config.request_count; i++) {
+      arrivals.push_back(t);
+      t += interval(rng);
+    }
+  }
+
+  std::uniform_int_distribution<size_t> pick(0, items.size() - 1);
+  std::vector<size_t> picks(arrivals.size());
+
+  for (auto& p : picks)
+    p = pick(rng);
+
+  /* workers */
+
+  ServeQueue queue;
+
+  std::vector<std::vector<std::chrono::steady_clock::duration>> latencies(config.worker_count);
+  std::vector<std::vector<std::chrono::steady_clock::duration>> service_times(config.worker_count);
+  std::vector<std::chrono::steady_clock::time_point> last_completions(config.worker_count);
+  std::vector<std::exception_ptr> errors(config.worker_count);
+  std::vector<std::thread> workers;
+  /* number of workers that are ready to serve, or have failed */
+  std::atomic<int> ready_count(0);
+
+  for (int w = 0; w < config.worker_count; w++) {
+    workers.emplace_back([&, w]() {
+      libench::set_trace_thread_name("worker " + std::to_string(w));
+
+      try {
+        std::unique_ptr<libench::Encoder> encoder;
+        std::unique_ptr<libench::Decoder> decoder;
+
+        libench::make_codec(config.codec, config.codec_options, encoder, decoder);
+
+        auto serve = [&](const ServeItem& item) {
+          LIBENCH_TRACE_SPAN("serve");
+
+          if (config.is_encode) {
+            encoder->encodeImage(item.image);
+          } else {
+            decoder->decodeImage(item.cs(), item.image.format);
+          }
+        };
+
+        /* warm up the codec instance of the worker */
+        serve(items.front());
+
+        ready_count++;
+
+        ServeJob job;
+
+        while (queue.pop(job)) {
+          auto start = std::chrono::steady_clock::now();
+
+          serve(items[job.item]);
+
+          auto end = std::chrono::steady_clock::now();
+
+          service_times[w].push_back(end - start);
+          latencies[w].push_back(end - job.arrival);
+          last_completions[w] = end;
+        }
+      } catch (...) {
+        errors[w] = std::current_exception();
+        ready_count++;
+        /* the remaining workers keep draining the queue */
+      }
+    });
+  }
+
+  /* open-loop arrivals */
+
+  ServeReport report;
+
+  report.max_submit_lag = std::chrono::steady_clock::duration::zero();
+
+  while (ready_count.load() < config.worker_count)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  auto start = std::chrono::steady_clock::now() + SERVE_START_DELAY;
+
+  for (size_t i = 0; i < arrivals.size(); i++) {
+    auto arrival = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(arrivals[i]));
+
+    std::this_thread::sleep_until(arrival);
+
+    report.max_submit_lag = std::max(report.max_submit_lag, std::chrono::steady_clock::now() - arrival);
+
+    queue.push(ServeJob{picks[i], arrival});
+  }
+
+  queue.close();
+
+  for (auto& worker : workers)
+    worker.join();
+
+  for (auto& e : errors) {
+    if (e)
+      std::rethrow_exception(e);
+  }
+
+  for (auto& item : items)
+    free_image(item.image);
+
+  /* report */
+
+  report.operation = config.is_encode ? "encode" : "decode";
+  report.worker_count = config.worker_count;
+  report.request_count = arrivals.size();
+
+  for (int w = 0; w < config.worker_count; w++) {
+    report.latencies.insert(report.latencies.end(), latencies[w].begin(), latencies[w].end());
+    report.service_times.insert(report.service_times.end(), service_times[w].begin(), service_times[w].end());
+  }
+
+  std::sort(report.latencies.begin(), report.latencies.end());
+
+  double span = arrivals.back();
+  report.offered_load = arrivals.size() > 1 && span > 0 ? (arrivals.size() - 1) / span : config.rate;
+
+  double elapsed = std::chrono::duration<double>(
+    *std::max_element(last_completions.begin(), last_completions.end()) - start).count();
+  report.throughput = elapsed > 0 ? report.request_count / elapsed : 0;
+
+  return report;
+}
+
+std::ostream& operator<<(std::ostream& os, const ServeReport& report) {
+  double service_time = 0;
+
+  for (const auto& t : report.service_times)
+    service_time += std::chrono::duration<double>(t).count();
+
+  if (! report.service_times.empty())
+    service_time /= report.service_times.size();
+
+  os << "{" << std::endl;
+
+  os << "\"operation\" : \"" << report.operation << "\"," << std::endl;
+
+  os << "\"workers\" : " << report.worker_count << "," << std::endl;
+
+  os << "\"requests\" : " << report.request_count << "," << std::endl;
+
+  os << "\"offeredLoad\" : " << report.offered_load << "," << std::endl;
+
+  os << "\"throughput\" : " << report.throughput << "," << std::endl;
+
+  /* the load at which the workers would be busy all the time */
+  os << "\"capacity\" : " << (service_time > 0 ? report.worker_count / service_time : 0) << "," << std::endl;
+
+  os << "\"meanServiceTime\" : " << service_time << "," << std::endl;
+
+  os << "\"latencyP50\" : " << report.latency_quantile(0.5) << "," << std::endl;
+
+  os << "\"latencyP99\" : " << report.latency_quantile(0.99) << "," << std::endl;
+
+  os << "\"latencyP999\" : " << report.latency_quantile(0.999) << "," << std::endl;
+
+  os << "\"latencyMax\" : " << (report.latencies.empty() ? 0 : std::chrono::duration<double>(report.latencies.back()).count()) << "," << std::endl;
+
+  os << "\"maxSubmitLag\" : " << std::chrono::duration<double>(report.max_submit_lag).count() << std::endl;
+
+  os << "}" << std::endl;
+
+  return os;
+}
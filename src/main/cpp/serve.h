@@ -0,0 +1,61 @@
+#ifndef LIBENCH_SERVE_H
+#define LIBENCH_SERVE_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "codec_factory.h"
+
+struct ServeConfig {
+  std::string codec;
+  libench::CodecOptions codec_options;
+  /* encode the images instead of decoding their codestreams */
+  bool is_encode;
+  int worker_count;
+  /* mean arrival rate of the Poisson process, in requests per second */
+  double rate;
+  /* if not empty, replayed arrival times in seconds, used instead of the Poisson process */
+  std::vector<double> arrivals;
+  /* number of requests, ignored when arrivals are replayed */
+  int request_count;
+  uint64_t seed;
+
+  ServeConfig() : is_encode(false), worker_count(1), rate(0), request_count(1000), seed(0) {}
+};
+
+struct ServeReport {
+  std::string operation;
+  int worker_count;
+  size_t request_count;
+  double offered_load;
+  double throughput;
+  /* end-to-end latencies, from the scheduled arrival to completion, sorted */
+  std::vector<std::chrono::steady_clock::duration> latencies;
+  /* time spent by the worker on each request */
+  std::vector<std::chrono::steady_clock::duration> service_times;
+  /* largest delay between the scheduled and the actual submission of a request */
+  std::chrono::steady_clock::duration max_submit_lag;
+
+  /* nearest-rank quantile of the sorted latencies, in seconds */
+  double latency_quantile(double q) const;
+};
+
+/*
+ * Simulates a service that encodes or decodes images on demand. Requests
+ * arrive open-loop, i.e. independently of completions, according to a Poisson
+ * process or replayed arrival times, each picking an image of the corpus at
+ * random. A pool of worker threads, each with its own encoder and decoder,
+ * serves the requests in arrival order. Latencies are measured from the
+ * scheduled arrival, so that they include queueing and do not hide
+ * submission delays.
+ */
+ServeReport run_serve(const std::vector<std::string>& filepaths, const ServeConfig& config);
+
+/* reads arrival times in seconds, one per line, and makes them relative to the first */
+std::vector<double> read_arrivals(const std::string& path);
+
+std::ostream& operator<<(std::ostream& os, const ServeReport& report);
+
+#endif
@@ -0,0 +1,179 @@
+#ifdef LIBENCH_HAS_SPNG
+
+#include "spng_codec.h"
+#include "allocator.h"
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include "spng.h"
+
+/* libspng allocations are served from the arena of the calling thread */
+
+static void* arena_calloc(size_t count, size_t size) {
+  void* ptr = libench_malloc(count * size);
+
+  if (ptr)
+    memset(ptr, 0, count * size);
+
+  return ptr;
+}
+
+static spng_alloc SPNG_ALLOCATOR = {libench_malloc, libench_realloc, arena_calloc, libench_free};
+
+/*
+ * libspng writer that appends to an OutputBuffer; allocation failures are
+ * reported to libspng, since exceptions must not cross its C frames
+ */
+static int write_output(spng_ctx* ctx, void* user, void* data, size_t size) {
+  try {
+    static_cast<libench::OutputBuffer*>(user)->append(static_cast<const uint8_t*>(data), size);
+  } catch (const std::bad_alloc&) {
+    return SPNG_IO_ERROR;
+  }
+
+  return 0;
+}
+
+/* frees the context when the scope ends, including on error */
+class SPNGContext {
+ public:
+  explicit SPNGContext(int flags) : ctx_(spng_ctx_new2(&SPNG_ALLOCATOR, flags)) {
+    if (! this->ctx_)
+      throw std::runtime_error("Cannot create libspng context");
+  }
+
+  ~SPNGContext() { spng_ctx_free(this->ctx_); }
+
+  SPNGContext(const SPNGContext&) = delete;
+  SPNGContext& operator=(const SPNGContext&) = delete;
+
+  spng_ctx* get() const { return this->ctx_; }
+
+ private:
+  spng_ctx* ctx_;
+};
+
+static void check(int ret, const char* what) {
+  if (ret)
+    throw std::runtime_error(std::string(what) + ": " + spng_strerror(ret));
+}
+
+/*
+ * SPNGEncoder
+ */
+
+libench::SPNGEncoder::SPNGEncoder(int level) : level_(level) {
+  if (level < 0 || level > 9)
+    throw std::runtime_error("libspng compression level must be between 0 and 9");
+}
+
+libench::CodestreamContext libench::SPNGEncoder::encodeRGB8(const ImageContext &image) {
+  return this->encodeInto(image, this->out_);
+}
+
+libench::CodestreamContext libench::SPNGEncoder::encodeRGBA8(const ImageContext &image) {
+  return this->encodeInto(image, this->out_);
+}
+
+libench::CodestreamContext libench::SPNGEncoder::encodeInto(const ImageContext &image, OutputBuffer& out) {
+  if (!(image.format == libench::ImageFormat::RGB8 || image.format == libench::ImageFormat::RGBA8))
+    throw std::runtime_error("Unsupported image format");
+
+  ArenaScope scope;
+
+  SPNGContext ctx(SPNG_CTX_ENCODER);
+
+  out.clear();
+
+  check(spng_set_png_stream(ctx.get(), write_output, &out), "PNG encode failed");
+
+  check(spng_set_option(ctx.get(), SPNG_IMG_COMPRESSION_LEVEL, this->level_), "PNG encode failed");
+
+  spng_ihdr ihdr;
+
+  memset(&ihdr, 0, sizeof(ihdr));
+  ihdr.width = image.width;
+  ihdr.height = image.height;
+  ihdr.bit_depth = 8;
+  ihdr.color_type = image.format.comps.num_comps == 3 ? SPNG_COLOR_TYPE_TRUECOLOR : SPNG_COLOR_TYPE_TRUECOLOR_ALPHA;
+
+  check(spng_set_ihdr(ctx.get(), &ihdr), "PNG encode failed");
+
+  check(spng_encode_image(ctx.get(), image.planes8[0], image.plane_size(0), SPNG_FMT_PNG, SPNG_ENCODE_FINALIZE),
+        "PNG encode failed");
+
+  libench::CodestreamContext cs;
+
+  cs.codestream = out.data();
+  cs.size = out.size();
+
+  return cs;
+}
+
+/*
+ * SPNGDecoder
+ */
+
+libench::SPNGDecoder::SPNGDecoder() {
+}
+
+libench::ImageContext libench::SPNGDecoder::decodeRGB8(const CodestreamContext& cs) {
+  return this->decode8(cs, libench::ImageFormat::RGB8);
+}
+
+libench::ImageContext libench::SPNGDecoder::decodeRGBA8(const CodestreamContext& cs) {
+  return this->decode8(cs, libench::ImageFormat::RGBA8);
+}
+
+/* any PNG is converted to 8-bit RGB or RGBA, as lodepng does, directly into the destination */
+static void decode_png(spng_ctx* ctx, libench::ImageContext& image) {
+  bool is_rgb = image.format.comps.num_comps == 3;
+
+  check(spng_decode_image(ctx, image.planes8[0], image.plane_size(0),
+                          is_rgb ? SPNG_FMT_RGB8 : SPNG_FMT_RGBA8, is_rgb ? 0 : SPNG_DECODE_TRNS),
+        "PNG decode failed");
+}
+
+libench::ImageContext libench::SPNGDecoder::decode8(const CodestreamContext& cs, const ImageFormat& format) {
+  ArenaScope scope;
+
+  SPNGContext ctx(0);
+  spng_ihdr ihdr;
+
+  check(spng_set_png_buffer(ctx.get(), cs.codestream, cs.size), "PNG decode failed");
+  check(spng_get_ihdr(ctx.get(), &ihdr), "PNG decode failed");
+
+  libench::ImageContext image;
+
+  image.width = ihdr.width;
+  image.height = ihdr.height;
+  image.format = format;
+
+  this->pixels_.resize(image.plane_size(0));
+  image.planes8[0] = this->pixels_.data();
+
+  decode_png(ctx.get(), image);
+
+  return image;
+}
+
+void libench::SPNGDecoder::decodeInto(const CodestreamContext& cs, ImageContext& image) {
+  if (!(image.format == libench::ImageFormat::RGB8 || image.format == libench::ImageFormat::RGBA8))
+    throw std::runtime_error("Unsupported image format");
+
+  ArenaScope scope;
+
+  SPNGContext ctx(0);
+  spng_ihdr ihdr;
+
+  check(spng_set_png_buffer(ctx.get(), cs.codestream, cs.size), "PNG decode failed");
+  check(spng_get_ihdr(ctx.get(), &ihdr), "PNG decode failed");
+
+  if (ihdr.width != image.width || ihdr.height != image.height)
+    throw std::runtime_error("Destination image does not match the codestream");
+
+  decode_png(ctx.get(), image);
+}
+
+#endif
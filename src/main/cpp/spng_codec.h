@@ -0,0 +1,50 @@
+#ifndef LIBENCH_SPNG_H
+#define LIBENCH_SPNG_H
+
+#include <vector>
+#include "codec.h"
+
+namespace libench {
+
+/* PNG codec based on libspng, built over zlib-ng */
+
+class SPNGEncoder : public Encoder {
+ public:
+  /* level is the zlib compression level, from 0 (none) to 9 (best) */
+  explicit SPNGEncoder(int level = 6);
+
+  CodestreamContext encodeRGB8(const ImageContext &image);
+
+  CodestreamContext encodeRGBA8(const ImageContext &image);
+
+  CodestreamContext encodeInto(const ImageContext &image, OutputBuffer& out);
+
+ private:
+  int level_;
+  OutputBuffer out_;
+};
+
+class SPNGDecoder : public Decoder {
+ public:
+  SPNGDecoder();
+
+  virtual ImageContext decodeRGB8(const CodestreamContext& cs);
+
+  virtual ImageContext decodeRGBA8(const CodestreamContext& cs);
+
+  virtual void decodeInto(const CodestreamContext& cs, ImageContext& image);
+
+  /* reported since png_fpnge also decodes with it */
+  std::string backend() const override {
+    return "spng";
+  }
+
+ private:
+  ImageContext decode8(const CodestreamContext& cs, const ImageFormat& format);
+
+  std::vector<uint8_t> pixels_;
+};
+
+}  // namespace libench
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef LIBENCH_SPSC_QUEUE_H
+#define LIBENCH_SPSC_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace libench {
+
+struct QueueStats {
+  size_t capacity;
+  uint64_t push_count;
+  /* sum of the number of items already queued at each push */
+  uint64_t occupancy_sum;
+  size_t max_occupancy;
+  /* number of pushes that found the queue full, i.e. back-pressure events */
+  uint64_t full_count;
+  /* number of pops that found the queue empty */
+  uint64_t empty_count;
+  std::chrono::steady_clock::duration push_wait;
+  std::chrono::steady_clock::duration pop_wait;
+
+  double mean_occupancy() const {
+    return this->push_count ? (double)this->occupancy_sum / this->push_count : 0;
+  }
+};
+
+/*
+ * Bounded lock-free queue with a single producer thread and a single consumer
+ * thread. push() blocks while the queue is full and pop() while it is empty.
+ * Statistics are maintained by the thread that owns them and must only be
+ * read once both threads are done.
+ */
+template <typename T>
+class SPSCQueue {
+ public:
+  explicit SPSCQueue(size_t capacity) : slots_(capacity + 1), head_(0), tail_(0), closed_(false), cancelled_(false) {
+    if (capacity == 0)
+      throw std::runtime_error("Queue capacity must be at least 1");
+
+    this->stats_ = QueueStats();
+    this->stats_.capacity = capacity;
+  }
+
+  /* returns false if the queue was cancelled */
+  bool push(T&& item) {
+    size_t tail = this->tail_.load(std::memory_order_relaxed);
+    size_t next = (tail + 1) % this->slots_.size();
+    size_t head = this->head_.load(std::memory_order_acquire);
+
+    if (next == head) {
+      this->stats_.full_count++;
+
+      auto start = std::chrono::steady_clock::now();
+
+      for (unsigned spins = 0; next == (head = this->head_.load(std::memory_order_acquire)); spins++) {
+        if (this->cancelled_.load(std::memory_order_relaxed))
+          return false;
+        backoff(spins);
+      }
+
+      this->stats_.push_wait += std::chrono::steady_clock::now() - start;
+    }
+
+    size_t occupancy = (tail + this->slots_.size() - head) % this->slots_.size();
+
+    this->stats_.push_count++;
+    this->stats_.occupancy_sum += occupancy;
+    if (occupancy > this->stats_.max_occupancy)
+      this->stats_.max_occupancy = occupancy;
+
+    this->slots_[tail] = std::move(item);
+    this->tail_.store(next, std::memory_order_release);
+
+    return true;
+  }
+
+  /* returns false once the queue is closed and drained, or cancelled */
+  bool pop(T& item) {
+    size_t head = this->head_.load(std::memory_order_relaxed);
+
+    if (head == this->tail_.load(std::memory_order_acquire)) {
+      this->pop_stats_.empty_count++;
+
+      auto start = std::chrono::steady_clock::now();
+
+      for (unsigned spins = 0; head == this->tail_.load(std::memory_order_acquire); spins++) {
+        if (this->cancelled_.load(std::memory_order_relaxed))
+          return false;
+        /* the producer closes the queue after its last push */
+        if (this->closed_.load(std::memory_order_acquire) && head == this->tail_.load(std::memory_order_acquire))
+          return false;
+        backoff(spins);
+      }
+
+      this->pop_stats_.pop_wait += std::chrono::steady_clock::now() - start;
+    }
+
+    item = std::move(this->slots_[head]);
+    this->head_.store((head + 1) % this->slots_.size(), std::memory_order_release);
+
+    return true;
+  }
+
+  /* called by the producer after its last push */
+  void close() {
+    this->closed_.store(true, std::memory_order_release);
+  }
+
+  /* unblocks both threads, e.g. when a stage fails */
+  void cancel() {
+    this->cancelled_.store(true, std::memory_order_relaxed);
+  }
+
+  QueueStats stats() const {
+    QueueStats stats = this->stats_;
+
+    stats.empty_count = this->pop_stats_.empty_count;
+    stats.pop_wait = this->pop_stats_.pop_wait;
+
+    return stats;
+  }
+
+ private:
+  struct PopStats {
+    uint64_t empty_count = 0;
+    std::chrono::steady_clock::duration pop_wait = std::chrono::steady_clock::duration::zero();
+  };
+
+  static void backoff(unsigned spins) {
+    if (spins < 64) {
+      /* busy wait */
+    } else if (spins < 128) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+
+  std::vector<T> slots_;
+  alignas(64) std::atomic<size_t> head_;
+  alignas(64) std::atomic<size_t> tail_;
+  std::atomic<bool> closed_;
+  std::atomic<bool> cancelled_;
+
+  /* producer-owned */
+  alignas(64) QueueStats stats_;
+
+  /* consumer-owned */
+  alignas(64) PopStats pop_stats_;
+};
+
+}  // namespace libench
+
+#endif
@@ -0,0 +1,326 @@
+#include "synth_image.h"
+#include "image_io.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+const std::string SYNTH_PREFIX = "synth:";
+
+/* stateless hash so that every sample can be generated independently */
+uint64_t mix(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+uint64_t hash(uint64_t seed, uint32_t c, uint32_t x, uint32_t y) {
+  return mix(mix(mix(seed ^ c) ^ x) ^ y);
+}
+
+double unit(uint64_t h) {
+  return (h >> 11) * (1.0 / 9007199254740992.0);
+}
+
+class Pattern {
+ public:
+  Pattern(uint32_t width, uint32_t height, uint32_t max_value) : width_(width), height_(height), max_value_(max_value) {}
+
+  /* returns the value of component c at (x, y), in full resolution coordinates */
+  virtual uint32_t sample(uint8_t c, uint32_t x, uint32_t y) const = 0;
+
+  virtual ~Pattern() {}
+
+ protected:
+  uint32_t quantize(double v) const {
+    return (uint32_t) std::lround(std::min(std::max(v, 0.0), 1.0) * this->max_value_);
+  }
+
+  uint32_t width_;
+  uint32_t height_;
+  uint32_t max_value_;
+};
+
+class FlatPattern : public Pattern {
+ public:
+  FlatPattern(uint32_t width, uint32_t height, uint32_t max_value, double level) :
+    Pattern(width, height, max_value), value_(quantize(level)) {}
+
+  uint32_t sample(uint8_t c, uint32_t x, uint32_t y) const override {
+    return this->value_;
+  }
+
+ private:
+  uint32_t value_;
+};
+
+class GradientPattern : public Pattern {
+ public:
+  using Pattern::Pattern;
+
+  uint32_t sample(uint8_t c, uint32_t x, uint32_t y) const override {
+    double u = this->width_ > 1 ? (double) x / (this->width_ - 1) : 0;
+    double v = this->height_ > 1 ? (double) y / (this->height_ - 1) : 0;
+
+    switch (c % 3) {
+    case 0:
+      return quantize(u);
+    case 1:
+      return quantize(v);
+    default:
+      return quantize((u + 1 - v) / 2);
+    }
+  }
+};
+
+class NoisePattern : public Pattern {
+ public:
+  NoisePattern(uint32_t width, uint32_t height, uint32_t max_value, uint32_t bits) :
+    Pattern(width, height, max_value), mask_((1u << bits) - 1) {
+    /* centre the noise within the full scale */
+    this->offset_ = (max_value - this->mask_) / 2;
+  }
+
+  uint32_t sample(uint8_t c, uint32_t x, uint32_t y) const override {
+    return this->offset_ + (uint32_t) (hash(0, c, x, y) & this->mask_);
+  }
+
+ private:
+  uint32_t mask_;
+  uint32_t offset_;
+};
+
+class ScreenPattern : public Pattern {
+ public:
+  using Pattern::Pattern;
+
+  uint32_t sample(uint8_t c, uint32_t x, uint32_t y) const override {
+    const uint32_t WINDOW_SIZE = 256;
+    const uint32_t GLYPH_WIDTH = 8;
+    const uint32_t GLYPH_HEIGHT = 16;
+    const uint32_t TITLE_HEIGHT = 24;
+    const uint32_t GLYPH_COUNT = 96;
+
+    uint32_t wx = x / WINDOW_SIZE;
+    uint32_t wy = y / WINDOW_SIZE;
+    uint32_t lx = x % WINDOW_SIZE;
+    uint32_t ly = y % WINDOW_SIZE;
+
+    uint64_t window = hash(1, 0, wx, wy);
+
+    /* window frame */
+    if (lx < 2 || ly < 2)
+      return palette(c, 0);
+
+    /* title bar */
+    if (ly < TITLE_HEIGHT)
+      return palette(c, 1 + window % 3);
+
+    /* lines of text separated by blank lines, with ragged line ends */
+    uint32_t line = (ly - TITLE_HEIGHT) / GLYPH_HEIGHT;
+    uint32_t column = lx / GLYPH_WIDTH;
+    uint32_t line_length = hash(2, 0, (uint32_t) window, line) % (WINDOW_SIZE / GLYPH_WIDTH);
+
+    if (line % 3 == 2 || column >= line_length || column == 0)
+      return palette(c, 4);
+
+    /* each glyph is a fixed random bitmap drawn from a small set */
+    uint32_t glyph = hash(3, 0, wx * WINDOW_SIZE + column, wy * WINDOW_SIZE + line) % GLYPH_COUNT;
+    uint32_t gx = lx % GLYPH_WIDTH;
+    uint32_t gy = (ly - TITLE_HEIGHT) % GLYPH_HEIGHT;
+
+    if (gx == 0 || gy < 3 || gy > 12)
+      return palette(c, 4);
+
+    return (hash(4, 0, glyph, gy * GLYPH_WIDTH + gx) & 3) == 0 ? palette(c, 5) : palette(c, 4);
+  }
+
+ private:
+  uint32_t palette(uint8_t c, uint32_t index) const {
+    static const double PALETTE[6][4] = {
+      {0.25, 0.25, 0.25, 1},
+      {0.20, 0.40, 0.80, 1},
+      {0.80, 0.30, 0.20, 1},
+      {0.30, 0.70, 0.30, 1},
+      {0.95, 0.95, 0.95, 1},
+      {0.05, 0.05, 0.10, 1}
+    };
+
+    return quantize(PALETTE[index][c]);
+  }
+};
+
+class NaturalPattern : public Pattern {
+ public:
+  NaturalPattern(uint32_t width, uint32_t height, uint32_t max_value, uint64_t seed, bool is_yuv) :
+    Pattern(width, height, max_value), seed_(seed), is_yuv_(is_yuv) {}
+
+  uint32_t sample(uint8_t c, uint32_t x, uint32_t y) const override {
+    /* alpha is mostly opaque */
+    if (c == 3)
+      return quantize(0.8 + 0.2 * fractal(7, x, y));
+
+    double base = fractal(0, x, y);
+    double detail = fractal(1 + c, x, y);
+
+    if (this->is_yuv_ && c > 0)
+      return quantize(0.5 + 0.25 * (detail - 0.5));
+
+    return quantize(0.8 * base + 0.2 * detail);
+  }
+
+ private:
+  /* sum of octaves of value noise, the amplitude of each being proportional to its period */
+  double fractal(uint32_t layer, uint32_t x, uint32_t y) const {
+    double sum = 0;
+    double norm = 0;
+
+    for (uint32_t period = 256; period >= 2; period /= 2) {
+      sum += period * value_noise(layer * 16 + period, x, y, period);
+      norm += period;
+    }
+
+    return sum / norm;
+  }
+
+  double value_noise(uint32_t layer, uint32_t x, uint32_t y, uint32_t period) const {
+    uint32_t ix = x / period;
+    uint32_t iy = y / period;
+    double fx = smoothstep((double) (x % period) / period);
+    double fy = smoothstep((double) (y % period) / period);
+
+    double v00 = unit(hash(this->seed_, layer, ix, iy));
+    double v10 = unit(hash(this->seed_, layer, ix + 1, iy));
+    double v01 = unit(hash(this->seed_, layer, ix, iy + 1));
+    double v11 = unit(hash(this->seed_, layer, ix + 1, iy + 1));
+
+    return (v00 * (1 - fx) + v10 * fx) * (1 - fy) + (v01 * (1 - fx) + v11 * fx) * fy;
+  }
+
+  static double smoothstep(double t) {
+    return t * t * (3 - 2 * t);
+  }
+
+  uint64_t seed_;
+  bool is_yuv_;
+};
+
+std::vector<std::string> split(const std::string& s, char sep) {
+  std::vector<std::string> fields;
+  std::istringstream ss(s);
+  std::string field;
+
+  while (std::getline(ss, field, sep)) {
+    fields.push_back(field);
+  }
+
+  return fields;
+}
+
+}  // namespace
+
+bool is_synth_image(const std::string& path) {
+  return path.compare(0, SYNTH_PREFIX.size(), SYNTH_PREFIX) == 0;
+}
+
+libench::ImageContext generate_image(const std::string& spec) {
+  std::vector<std::string> fields = split(spec, ':');
+
+  if (fields.size() < 4 || fields.size() > 5 || fields[0] + ":" != SYNTH_PREFIX)
+    throw std::runtime_error("Synthetic image must be of the form synth:<pattern>:<width>x<height>:<pixel_fmt>[:<param>]");
+
+  const std::string& pattern_name = fields[1];
+
+  size_t x_pos = fields[2].find('x');
+  if (x_pos == std::string::npos)
+    throw std::runtime_error("Synthetic image size must be of the form <width>x<height>");
+
+  libench::ImageContext image;
+
+  image.width = std::stoul(fields[2].substr(0, x_pos));
+  image.height = std::stoul(fields[2].substr(x_pos + 1));
+  image.format = parse_pixel_format(fields[3]);
+
+  const libench::ImageFormat& format = image.format;
+
+  if (image.width == 0 || image.height == 0)
+    throw std::runtime_error("Synthetic image must not be empty");
+
+  for (uint8_t i = 0; i < format.num_planes(); i++) {
+    if (image.width % format.x_sub_factor[i] || image.height % format.y_sub_factor[i])
+      throw std::runtime_error("Synthetic image size must be a multiple of the subsampling factors");
+  }
+
+  uint32_t max_value = (1u << format.bit_depth) - 1;
+  bool has_param = fields.size() == 5;
+
+  std::unique_ptr<Pattern> pattern;
+
+  if (pattern_name == "flat") {
+    pattern.reset(new FlatPattern(image.width, image.height, max_value, has_param ? std::stod(fields[4]) : 0.5));
+  } else if (pattern_name == "gradient") {
+    pattern.reset(new GradientPattern(image.width, image.height, max_value));
+  } else if (pattern_name == "noise") {
+    uint32_t bits = has_param ? std::stoul(fields[4]) : format.bit_depth;
+    if (bits > format.bit_depth)
+      throw std::runtime_error("Noise entropy cannot exceed the bit depth");
+    pattern.reset(new NoisePattern(image.width, image.height, max_value, bits));
+  } else if (pattern_name == "screen") {
+    pattern.reset(new ScreenPattern(image.width, image.height, max_value));
+  } else if (pattern_name == "natural") {
+    pattern.reset(new NaturalPattern(image.width, image.height, max_value, has_param ? std::stoull(fields[4]) : 0,
+                                     format.comps == libench::ImageComponents::YUV));
+  } else {
+    throw std::runtime_error("Unknown synthetic pattern: " + pattern_name);
+  }
+
+  for (uint8_t i = 0; i < format.num_planes(); i++) {
+    image.planes8[i] = (uint8_t*) malloc(image.plane_size(i));
+    if (! image.planes8[i]) {
+      throw std::runtime_error("Cannot allocate memory");
+    }
+  }
+
+  if (format.is_planar) {
+    for (uint8_t i = 0; i < format.num_planes(); i++) {
+      uint32_t plane_width = image.width / format.x_sub_factor[i];
+
+      for (uint32_t y = 0; y < image.plane_height(i); y++) {
+        for (uint32_t x = 0; x < plane_width; x++) {
+          size_t offset = (size_t) y * plane_width + x;
+          uint32_t v = pattern->sample(i, x * format.x_sub_factor[i], y * format.y_sub_factor[i]);
+
+          if (image.is_plane16()) {
+            image.planes16[i][offset] = (uint16_t) v;
+          } else {
+            image.planes8[i][offset] = (uint8_t) v;
+          }
+        }
+      }
+    }
+  } else {
+    uint8_t num_comps = format.comps.num_comps;
+
+    for (uint32_t y = 0; y < image.height; y++) {
+      for (uint32_t x = 0; x < image.width; x++) {
+        for (uint8_t c = 0; c < num_comps; c++) {
+          size_t offset = ((size_t) y * image.width + x) * num_comps + c;
+          uint32_t v = pattern->sample(c, x, y);
+
+          if (image.is_plane16()) {
+            image.planes16[0][offset] = (uint16_t) v;
+          } else {
+            image.planes8[0][offset] = (uint8_t) v;
+          }
+        }
+      }
+    }
+  }
+
+  return image;
+}
@@ -0,0 +1,31 @@
+#ifndef LIBENCH_SYNTH_IMAGE_H
+#define LIBENCH_SYNTH_IMAGE_H
+
+#include <string>
+#include "codec.h"
+
+/*
+ * Synthetic images are specified in place of an image path as
+ *
+ *   synth:<pattern>:<width>x<height>:<pixel_fmt>[:<param>]
+ *
+ * where <pixel_fmt> is one of the formats accepted by parse_pixel_format() and
+ * <pattern> is one of:
+ *
+ *   flat      constant samples at <param> (0 to 1) of the full scale, 0.5 by default
+ *   gradient  horizontal, vertical and diagonal ramps
+ *   noise     uniform noise with an entropy of <param> bits per sample, the bit
+ *             depth by default
+ *   screen    flat windows and glyph-like text on a small palette
+ *   natural   fractal noise with a 1/f amplitude spectrum and correlated
+ *             components, seeded with <param>
+ *
+ * The content is a deterministic function of the specification.
+ */
+
+bool is_synth_image(const std::string& path);
+
+/* the image must be freed using free_image() */
+libench::ImageContext generate_image(const std::string& spec);
+
+#endif
@@ -0,0 +1,84 @@
+#include "test_context.h"
+#include "sampling.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+std::string hex_hash(const uint8_t hash[MD5_BLOCK_SIZE]) {
+  std::stringstream ss;
+
+  for (int i = 0; i < MD5_BLOCK_SIZE; i++) {
+    ss << std::hex << std::setfill('0') << std::setw(2) << std::right
+       << (int)hash[i];
+  }
+
+  return ss.str();
+}
+
+static void print_times(std::ostream& os, const char* name,
+                        const std::vector<std::chrono::system_clock::time_point::duration>& times) {
+  os << "\"" << name << "\" : [";
+  for (const auto& t : times) {
+    os << std::chrono::duration<double>(t).count();
+    if (&t != &times.back()) {
+      os << ", ";
+    }
+  }
+  os << "]," << std::endl;
+}
+
+/* relative half-width of the 95% confidence interval of the mean */
+static void print_precision(std::ostream& os, const char* name,
+                            const std::vector<std::chrono::system_clock::time_point::duration>& times) {
+  double precision = libench::relative_ci_half_width(times);
+
+  os << "\"" << name << "\" : ";
+  if (precision < 0) {
+    os << "null";
+  } else {
+    os << precision;
+  }
+  os << "," << std::endl;
+}
+
+std::ostream& operator<<(std::ostream& os, const TestContext& ctx) {
+  os << "{" << std::endl;
+
+  os << "\"imagePath\" : \"" << ctx.image_path << "\"," << std::endl;
+
+  os << "\"imageHash\" : \"" << hex_hash(ctx.image_hash) << "\"," << std::endl;
+
+  print_times(os, "decodeTimes", ctx.decode_times);
+
+  print_times(os, "encodeTimes", ctx.encode_times);
+
+  if (! ctx.cold_decode_times.empty()) {
+    print_times(os, "coldDecodeTimes", ctx.cold_decode_times);
+  }
+
+  if (! ctx.cold_encode_times.empty()) {
+    print_times(os, "coldEncodeTimes", ctx.cold_encode_times);
+  }
+
+  os << "\"repetitions\" : " << std::max(ctx.encode_times.size(), ctx.decode_times.size()) << "," << std::endl;
+
+  os << "\"encodeInnerIterations\" : " << ctx.encode_inner_iterations << "," << std::endl;
+
+  os << "\"decodeInnerIterations\" : " << ctx.decode_inner_iterations << "," << std::endl;
+
+  print_precision(os, "encodePrecision", ctx.encode_times);
+
+  print_precision(os, "decodePrecision", ctx.decode_times);
+
+  os << "\"imageSize\" : " << ctx.image_sz << "," << std::endl;
+
+  os << "\"codestreamSize\" : " << ctx.codestream_sz << ","  << std::endl;
+
+  os << "\"imageWidth\" : " << ctx.image.width  << "," << std::endl;
+
+  os << "\"imageHeight\" : " << ctx.image.height  << std::endl;
+
+  os << "}" << std::endl;
+
+  return os;
+}
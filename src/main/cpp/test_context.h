@@ -0,0 +1,32 @@
+#ifndef LIBENCH_TEST_CONTEXT_H
+#define LIBENCH_TEST_CONTEXT_H
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "codec.h"
+
+struct TestContext {
+  libench::ImageContext image;
+  uint8_t image_hash[MD5_BLOCK_SIZE];
+  std::string codestream_path;
+  uint64_t image_sz;
+  uint64_t codestream_sz;
+  std::string image_path;
+  std::vector<std::chrono::system_clock::time_point::duration> encode_times;
+  std::vector<std::chrono::system_clock::time_point::duration> decode_times;
+  /* measured after evicting the caches, only with --cold */
+  std::vector<std::chrono::system_clock::time_point::duration> cold_encode_times;
+  std::vector<std::chrono::system_clock::time_point::duration> cold_decode_times;
+  /* number of consecutive calls timed as a single sample */
+  int encode_inner_iterations = 1;
+  int decode_inner_iterations = 1;
+};
+
+std::ostream& operator<<(std::ostream& os, const TestContext& ctx);
+
+/* lowercase hexadecimal form of an image hash */
+std::string hex_hash(const uint8_t hash[MD5_BLOCK_SIZE]);
+
+#endif
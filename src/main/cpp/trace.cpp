@@ -0,0 +1,118 @@
+#include "trace.h"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+bool libench::is_tracing_enabled = false;
+
+struct TraceEvent {
+  const char* name;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point end;
+};
+
+struct ThreadTrace {
+  uint32_t tid;
+  std::string name;
+  std::vector<TraceEvent> events;
+};
+
+/* initial capacity of the buffer of each thread, so that recording rarely allocates */
+static const size_t TRACE_BUFFER_CAPACITY = 1 << 14;
+
+static std::chrono::steady_clock::time_point trace_origin;
+
+/* buffers of all threads, kept after the threads exit; only locked when a thread records its first span */
+static std::mutex registry_mutex;
+static std::vector<std::unique_ptr<ThreadTrace>> registry;
+
+static ThreadTrace& local_trace() {
+  thread_local ThreadTrace* trace = NULL;
+
+  if (! trace) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    registry.emplace_back(new ThreadTrace());
+    trace = registry.back().get();
+    trace->tid = (uint32_t) registry.size();
+    trace->events.reserve(TRACE_BUFFER_CAPACITY);
+  }
+
+  return *trace;
+}
+
+void libench::enable_tracing() {
+  trace_origin = std::chrono::steady_clock::now();
+  is_tracing_enabled = true;
+}
+
+void libench::set_trace_thread_name(const std::string& name) {
+  if (is_tracing_enabled)
+    local_trace().name = name;
+}
+
+void libench::TraceSpan::record() {
+  local_trace().events.push_back(TraceEvent{this->name_, this->start_, std::chrono::steady_clock::now()});
+}
+
+static double microseconds(std::chrono::steady_clock::duration d) {
+  return std::chrono::duration<double, std::micro>(d).count();
+}
+
+void libench::write_trace(const std::string& path) {
+  std::ofstream f(path);
+  if (! f)
+    throw std::runtime_error("Cannot open trace file: " + path);
+
+  std::lock_guard<std::mutex> lock(registry_mutex);
+
+  f << std::fixed << std::setprecision(3);
+
+  f << "{\"displayTimeUnit\" : \"ns\", \"traceEvents\" : [" << std::endl;
+
+  bool is_first = true;
+
+  for (const auto& trace : registry) {
+    if (! trace->name.empty()) {
+      f << (is_first ? "" : ",\n") << "{\"name\" : \"thread_name\", \"ph\" : \"M\", \"pid\" : 1, \"tid\" : " << trace->tid
+        << ", \"args\" : {\"name\" : \"" << trace->name << "\"}}";
+      is_first = false;
+    }
+
+    for (const auto& e : trace->events) {
+      f << (is_first ? "" : ",\n") << "{\"name\" : \"" << e.name << "\", \"cat\" : \"libench\", \"ph\" : \"X\", \"pid\" : 1, \"tid\" : "
+        << trace->tid << ", \"ts\" : " << microseconds(e.start - trace_origin) << ", \"dur\" : " << microseconds(e.end - e.start) << "}";
+      is_first = false;
+    }
+  }
+
+  f << std::endl << "]}" << std::endl;
+
+  if (! f)
+    throw std::runtime_error("Cannot write trace file: " + path);
+}
+
+/*
+ * TraceSession
+ */
+
+libench::TraceSession::TraceSession(const std::string& path) : path_(path) {
+  if (! path.empty())
+    enable_tracing();
+}
+
+libench::TraceSession::~TraceSession() {
+  if (this->path_.empty())
+    return;
+
+  /* destructors must not throw */
+  try {
+    write_trace(this->path_);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  }
+}
@@ -0,0 +1,74 @@
+#ifndef LIBENCH_TRACE_H
+#define LIBENCH_TRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace libench {
+
+/*
+ * Timeline of the phases of the harness and the codecs, exported in the
+ * Chrome trace event format, which Perfetto and chrome://tracing load. Each
+ * thread records its spans into a buffer of its own, so that recording takes
+ * no lock; when tracing is disabled, a span costs a single branch.
+ */
+
+/* must be called before any span is recorded */
+void enable_tracing();
+
+extern bool is_tracing_enabled;
+
+/* name under which the spans of the calling thread are displayed */
+void set_trace_thread_name(const std::string& name);
+
+/* writes the spans recorded by all threads; must be called once the threads have stopped recording */
+void write_trace(const std::string& path);
+
+/* enables tracing if path is not empty, and writes the trace to path when destroyed */
+class TraceSession {
+ public:
+  explicit TraceSession(const std::string& path);
+  ~TraceSession();
+
+  TraceSession(const TraceSession&) = delete;
+  TraceSession& operator=(const TraceSession&) = delete;
+
+ private:
+  std::string path_;
+};
+
+class TraceSpan {
+ public:
+  /* name must be a string literal, or otherwise outlive the trace */
+  explicit TraceSpan(const char* name) : name_(NULL) {
+    if (is_tracing_enabled) {
+      this->name_ = name;
+      this->start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~TraceSpan() {
+    if (this->name_)
+      this->record();
+  }
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+ private:
+  void record();
+
+  const char* name_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace libench
+
+#define LIBENCH_TRACE_CONCAT_(a, b) a##b
+#define LIBENCH_TRACE_CONCAT(a, b) LIBENCH_TRACE_CONCAT_(a, b)
+
+/* records a span from this statement to the end of the enclosing scope */
+#define LIBENCH_TRACE_SPAN(name) libench::TraceSpan LIBENCH_TRACE_CONCAT(trace_span_, __LINE__)(name)
+
+#endif
@@ -0,0 +1,324 @@
+#include "transcode.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "image_io.h"
+#include "trace.h"
+
+/*
+ * converts interleaved 8-bit RGB to RGBA and back, which are the only
+ * conversions that do not lose information; RGBA is only converted to RGB if
+ * it is opaque
+ */
+static bool convert_image(const libench::ImageContext& src, const libench::ImageFormat& format,
+                          std::vector<uint8_t>& buffer, libench::ImageContext& dst) {
+  /* dst may be src */
+  uint32_t width = src.width;
+  uint32_t height = src.height;
+  size_t pixel_count = (size_t) width * height;
+
+  if (src.format == libench::ImageFormat::RGB8 && format == libench::ImageFormat::RGBA8) {
+    buffer.resize(pixel_count * 4);
+
+    const uint8_t* in = src.planes8[0];
+    uint8_t* out = buffer.data();
+
+    for (size_t i = 0; i < pixel_count; i++, in += 3, out += 4) {
+      out[0] = in[0];
+      out[1] = in[1];
+      out[2] = in[2];
+      out[3] = 0xFF;
+    }
+  } else if (src.format == libench::ImageFormat::RGBA8 && format == libench::ImageFormat::RGB8) {
+    buffer.resize(pixel_count * 3);
+
+    const uint8_t* in = src.planes8[0];
+    uint8_t* out = buffer.data();
+
+    for (size_t i = 0; i < pixel_count; i++, in += 4, out += 3) {
+      if (in[3] != 0xFF)
+        return false;
+
+      out[0] = in[0];
+      out[1] = in[1];
+      out[2] = in[2];
+    }
+  } else {
+    return false;
+  }
+
+  dst.width = width;
+  dst.height = height;
+  dst.format = format;
+  dst.planes8[0] = buffer.data();
+  dst.planes8[1] = dst.planes8[2] = dst.planes8[3] = NULL;
+
+  return true;
+}
+
+static std::string format_name(const libench::ImageFormat& format) {
+  return format == libench::ImageFormat::RGBA8 ? "RGBA8" : "RGB8";
+}
+
+TranscodeReport run_transcode(const std::string& filepath, const TranscodeConfig& config) {
+  if (config.worker_count < 1)
+    throw std::runtime_error("At least one worker is required");
+
+  if (config.repetitions < 1)
+    throw std::runtime_error("At least one repetition is required");
+
+  TranscodeReport report;
+
+  report.source_codec = config.source_codec;
+  report.target_codec = config.target_codec;
+  report.worker_count = config.worker_count;
+  report.daily_volume = config.daily_volume;
+
+  /* setup: encode the image with the source codec */
+
+  libench::ImageContext image = load_image(filepath);
+
+  report.image_sz = image.total_bits() / 8;
+
+  std::unique_ptr<libench::Encoder> source_encoder;
+  std::unique_ptr<libench::Decoder> source_decoder;
+
+  libench::make_codec(config.source_codec, config.source_options, source_encoder, source_decoder);
+
+  std::vector<uint8_t> codestream;
+  std::vector<uint8_t> state;
+
+  {
+    libench::CodestreamContext cs = source_encoder->encodeImage(image);
+
+    codestream.assign(cs.codestream, cs.codestream + cs.size);
+    state.assign((const uint8_t*) cs.state, (const uint8_t*) cs.state + cs.state_size);
+  }
+
+  libench::CodestreamContext source_cs;
+
+  source_cs.codestream = codestream.data();
+  source_cs.size = codestream.size();
+  source_cs.state = state.empty() ? NULL : state.data();
+  source_cs.state_size = state.size();
+
+  report.source_sz = source_cs.size + source_cs.state_size;
+
+  /* setup: find the format accepted by the target codec and check the round trip */
+
+  std::unique_ptr<libench::Encoder> target_encoder;
+  std::unique_ptr<libench::Decoder> target_decoder;
+
+  libench::make_codec(config.target_codec, config.target_options, target_encoder, target_decoder);
+
+  libench::ImageFormat target_format = image.format;
+  std::vector<uint8_t> converted_buffer;
+  libench::ImageContext target_image;
+  libench::CodestreamContext target_cs;
+
+  if (libench::codec_accepts_format(config.target_codec, image.format)) {
+    /* the decoded image is fed to the target as in the workers */
+    target_cs = target_encoder->encodeImage(source_decoder->decodeImage(source_cs, image.format));
+    target_image = image;
+  } else {
+    if (image.format == libench::ImageFormat::RGB8) {
+      target_format = libench::ImageFormat::RGBA8;
+    } else if (image.format == libench::ImageFormat::RGBA8) {
+      target_format = libench::ImageFormat::RGB8;
+    } else {
+      throw std::runtime_error("Target codec does not accept the image format");
+    }
+
+    if (! libench::codec_accepts_format(config.target_codec, target_format))
+      throw std::runtime_error("Target codec does not accept the image format");
+
+    if (! convert_image(image, target_format, converted_buffer, target_image))
+      throw std::runtime_error("RGBA image is not opaque and cannot be converted to RGB");
+
+    target_cs = target_encoder->encodeImage(target_image);
+
+    report.conversion = format_name(image.format) + "->" + format_name(target_format);
+  }
+
+  report.target_sz = target_cs.size + target_cs.state_size;
+
+  uint8_t image_hash[MD5_BLOCK_SIZE];
+  uint8_t decoded_hash[MD5_BLOCK_SIZE];
+
+  target_image.md5(image_hash);
+  target_decoder->decodeImage(target_cs, target_format).md5(decoded_hash);
+
+  if (memcmp(image_hash, decoded_hash, MD5_BLOCK_SIZE))
+    throw std::runtime_error("Image does not match: " + filepath);
+
+  bool is_converted = ! report.conversion.empty();
+
+  /* workers, each with its own codec instances */
+
+  std::vector<std::chrono::steady_clock::duration> decode_times(config.worker_count);
+  std::vector<std::chrono::steady_clock::duration> convert_times(config.worker_count);
+  std::vector<std::chrono::steady_clock::duration> encode_times(config.worker_count);
+  std::vector<std::exception_ptr> errors(config.worker_count);
+  std::vector<std::thread> workers;
+  /* number of workers that are ready to transcode, or have failed */
+  std::atomic<int> ready_count(0);
+  std::atomic<bool> is_started(false);
+
+  for (int w = 0; w < config.worker_count; w++) {
+    workers.emplace_back([&, w]() {
+      libench::set_trace_thread_name("worker " + std::to_string(w));
+
+      try {
+        std::unique_ptr<libench::Encoder> encoder;
+        std::unique_ptr<libench::Decoder> decoder;
+        std::unique_ptr<libench::Encoder> unused_encoder;
+        std::unique_ptr<libench::Decoder> unused_decoder;
+
+        libench::make_codec(config.source_codec, config.source_options, unused_encoder, decoder);
+        libench::make_codec(config.target_codec, config.target_options, encoder, unused_decoder);
+
+        std::vector<uint8_t> buffer;
+
+        auto transcode = [&](bool is_timed) {
+          LIBENCH_TRACE_SPAN("transcode");
+
+          auto start = std::chrono::steady_clock::now();
+
+          libench::ImageContext decoded = decoder->decodeImage(source_cs, image.format);
+
+          auto decoded_at = std::chrono::steady_clock::now();
+
+          if (is_converted)
+            convert_image(decoded, target_format, buffer, decoded);
+
+          auto converted_at = std::chrono::steady_clock::now();
+
+          encoder->encodeImage(decoded);
+
+          auto end = std::chrono::steady_clock::now();
+
+          if (is_timed) {
+            decode_times[w] += decoded_at - start;
+            convert_times[w] += converted_at - decoded_at;
+            encode_times[w] += end - converted_at;
+          }
+        };
+
+        /* warm up the codec instances of the worker */
+        transcode(false);
+
+        ready_count++;
+
+        while (! is_started.load())
+          std::this_thread::yield();
+
+        for (int i = 0; i < config.repetitions; i++)
+          transcode(true);
+      } catch (...) {
+        errors[w] = std::current_exception();
+        ready_count++;
+      }
+    });
+  }
+
+  while (ready_count.load() < config.worker_count)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  auto start = std::chrono::steady_clock::now();
+
+  is_started = true;
+
+  for (auto& worker : workers)
+    worker.join();
+
+  report.wall_time = std::chrono::steady_clock::now() - start;
+
+  for (auto& e : errors) {
+    if (e)
+      std::rethrow_exception(e);
+  }
+
+  free_image(image);
+
+  /* report */
+
+  report.image_count = (uint64_t) config.repetitions * config.worker_count;
+
+  report.decode_time = std::chrono::steady_clock::duration::zero();
+  report.convert_time = std::chrono::steady_clock::duration::zero();
+  report.encode_time = std::chrono::steady_clock::duration::zero();
+
+  for (int w = 0; w < config.worker_count; w++) {
+    report.decode_time += decode_times[w] / report.image_count;
+    report.convert_time += convert_times[w] / report.image_count;
+    report.encode_time += encode_times[w] / report.image_count;
+  }
+
+  return report;
+}
+
+std::ostream& operator<<(std::ostream& os, const TranscodeReport& report) {
+  double decode_time = std::chrono::duration<double>(report.decode_time).count();
+  double convert_time = std::chrono::duration<double>(report.convert_time).count();
+  double encode_time = std::chrono::duration<double>(report.encode_time).count();
+  double transcode_time = decode_time + convert_time + encode_time;
+  double wall_time = std::chrono::duration<double>(report.wall_time).count();
+
+  /* images per second of the workers together */
+  double throughput = wall_time > 0 ? report.image_count / wall_time : 0;
+  /* images per second of a single core, under the contention of the other workers */
+  double core_throughput = throughput / report.worker_count;
+
+  os << "{" << std::endl;
+
+  os << "\"sourceCodec\" : \"" << report.source_codec << "\"," << std::endl;
+
+  os << "\"targetCodec\" : \"" << report.target_codec << "\"," << std::endl;
+
+  os << "\"conversion\" : \"" << report.conversion << "\"," << std::endl;
+
+  os << "\"workers\" : " << report.worker_count << "," << std::endl;
+
+  os << "\"images\" : " << report.image_count << "," << std::endl;
+
+  os << "\"imageSize\" : " << report.image_sz << "," << std::endl;
+
+  os << "\"sourceSize\" : " << report.source_sz << "," << std::endl;
+
+  os << "\"targetSize\" : " << report.target_sz << "," << std::endl;
+
+  os << "\"bytesSaved\" : " << ((int64_t) report.source_sz - (int64_t) report.target_sz) << "," << std::endl;
+
+  os << "\"decodeTime\" : " << decode_time << "," << std::endl;
+
+  os << "\"convertTime\" : " << convert_time << "," << std::endl;
+
+  os << "\"encodeTime\" : " << encode_time << "," << std::endl;
+
+  os << "\"transcodeTime\" : " << transcode_time << "," << std::endl;
+
+  os << "\"decodeThroughput\" : " << (decode_time > 0 ? 1 / decode_time : 0) << "," << std::endl;
+
+  os << "\"encodeThroughput\" : " << (encode_time > 0 ? 1 / encode_time : 0) << "," << std::endl;
+
+  os << "\"throughput\" : " << throughput << "," << std::endl;
+
+  os << "\"byteThroughput\" : " << throughput * report.image_sz << "," << std::endl;
+
+  os << "\"coreThroughput\" : " << core_throughput << "," << std::endl;
+
+  os << "\"dailyVolume\" : " << report.daily_volume << "," << std::endl;
+
+  os << "\"coresRequired\" : " << (core_throughput > 0 ? report.daily_volume / (86400 * core_throughput) : 0) << "," << std::endl;
+
+  os << "\"dailyBytesSaved\" : " << report.daily_volume * ((double) report.source_sz - (double) report.target_sz) << std::endl;
+
+  os << "}" << std::endl;
+
+  return os;
+}
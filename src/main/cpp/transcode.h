@@ -0,0 +1,53 @@
+#ifndef LIBENCH_TRANSCODE_H
+#define LIBENCH_TRANSCODE_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "codec_factory.h"
+
+struct TranscodeConfig {
+  std::string source_codec;
+  std::string target_codec;
+  libench::CodecOptions source_options;
+  libench::CodecOptions target_options;
+  /* transcodes per worker */
+  int repetitions;
+  int worker_count;
+  /* images per day the migration must sustain, or 0 */
+  double daily_volume;
+
+  TranscodeConfig() : repetitions(5), worker_count(1), daily_volume(0) {}
+};
+
+struct TranscodeReport {
+  std::string source_codec;
+  std::string target_codec;
+  /* e.g. RGB8->RGBA8, or empty if the target accepts the decoded image as is */
+  std::string conversion;
+  int worker_count;
+  uint64_t image_count;
+  uint64_t image_sz;
+  uint64_t source_sz;
+  uint64_t target_sz;
+  /* per image, summed over all workers */
+  std::chrono::steady_clock::duration decode_time;
+  std::chrono::steady_clock::duration convert_time;
+  std::chrono::steady_clock::duration encode_time;
+  std::chrono::steady_clock::duration wall_time;
+  double daily_volume;
+};
+
+/*
+ * Migrates the image from one codec to another: the image is first encoded
+ * with the source codec, then each worker repeatedly decodes the source
+ * codestream and feeds the decoded image directly to the encoder of the
+ * target codec, converting it only if the target does not accept its format.
+ * The target codestream is checked to decode to the source image once.
+ */
+TranscodeReport run_transcode(const std::string& filepath, const TranscodeConfig& config);
+
+std::ostream& operator<<(std::ostream& os, const TranscodeReport& report);
+
+#endif
@@ -2,36 +2,30 @@
 #include "webp/decode.h"
 #include "webp/encode.h"
 #include <cstdint>
+#include <new>
 #include <stdexcept>
 
 /*
- * WEBPEncoder
+ * WebP writer that appends to an OutputBuffer; allocation failures are
+ * reported to libwebp, since exceptions must not cross its C frames
  */
+static int write_output(const uint8_t* data, size_t data_size, const WebPPicture* picture) {
+  try {
+    static_cast<libench::OutputBuffer*>(picture->custom_ptr)->append(data, data_size);
+  } catch (const std::bad_alloc&) {
+    return 0;
+  }
 
-libench::WEBPEncoder::WEBPEncoder() {
-  WebPMemoryWriterInit(&this->writer_);
-};
-
-libench::WEBPEncoder::~WEBPEncoder() {
-  WebPMemoryWriterClear(&this->writer_);
-};
-
-libench::CodestreamContext libench::WEBPEncoder::encodeRGB8(const ImageContext &image) {
-  return this->encode8(image);
-}
-
-libench::CodestreamContext libench::WEBPEncoder::encodeRGBA8(const ImageContext &image) {
-  return this->encode8(image);
+  return 1;
 }
 
-libench::CodestreamContext libench::WEBPEncoder::encode8(const ImageContext &image) {
-  WebPMemoryWriterClear(&this->writer_);
-
+/* encodes the image losslessly through the specified writer */
+static bool encode_webp(const libench::ImageContext &image, WebPWriterFunction writer, void* custom_ptr) {
   WebPConfig config;
   WebPPicture pic;
   const int level = 6;  // 0 (faster) - 9 (slower)
   if (!WebPConfigInit(&config) || !WebPConfigLosslessPreset(&config, level) || !WebPPictureInit(&pic))
-    throw std::runtime_error("WEBP encode failed");
+    return false;
 
   const int num_comps = image.format.comps.num_comps;
   const int rgb_stride = image.width * num_comps;
@@ -43,18 +37,47 @@ libench::CodestreamContext libench::WEBPEncoder::encode8(const ImageContext &ima
       WebPPictureImportRGBA(&pic, image.planes8[0], rgb_stride);
   if (!ret) {
     WebPPictureFree(&pic);
-    throw std::runtime_error("WEBP encode failed");
+    return false;
   }
 
   // Retain pixel values in fully transparent areas. The default will modify
   // the (invisible) pixels to improve compression.
   config.exact = 1;
 
-  pic.writer = WebPMemoryWrite;
-  pic.custom_ptr = &this->writer_;
+  pic.writer = writer;
+  pic.custom_ptr = custom_ptr;
 
-  if (!WebPEncode(&config, &pic)) {
-    WebPPictureFree(&pic);
+  ret = WebPEncode(&config, &pic);
+
+  WebPPictureFree(&pic);
+
+  return ret;
+}
+
+/*
+ * WEBPEncoder
+ */
+
+libench::WEBPEncoder::WEBPEncoder() {
+  WebPMemoryWriterInit(&this->writer_);
+};
+
+libench::WEBPEncoder::~WEBPEncoder() {
+  WebPMemoryWriterClear(&this->writer_);
+};
+
+libench::CodestreamContext libench::WEBPEncoder::encodeRGB8(const ImageContext &image) {
+  return this->encode8(image);
+}
+
+libench::CodestreamContext libench::WEBPEncoder::encodeRGBA8(const ImageContext &image) {
+  return this->encode8(image);
+}
+
+libench::CodestreamContext libench::WEBPEncoder::encode8(const ImageContext &image) {
+  WebPMemoryWriterClear(&this->writer_);
+
+  if (!encode_webp(image, WebPMemoryWrite, &this->writer_)) {
     WebPMemoryWriterClear(&this->writer_);
     throw std::runtime_error("WEBP encode failed");
   }
@@ -65,6 +88,21 @@ libench::CodestreamContext libench::WEBPEncoder::encode8(const ImageContext &ima
   return cs;
 }
 
+libench::CodestreamContext libench::WEBPEncoder::encodeInto(const ImageContext &image, OutputBuffer& out) {
+  if (!(image.format == libench::ImageFormat::RGB8 || image.format == libench::ImageFormat::RGBA8))
+    throw std::runtime_error("Unsupported image format");
+
+  out.clear();
+
+  if (!encode_webp(image, write_output, &out))
+    throw std::runtime_error("WEBP encode failed");
+
+  CodestreamContext cs;
+  cs.codestream = out.data();
+  cs.size = out.size();
+  return cs;
+}
+
 /*
  * WEBPDecoder
  */
@@ -77,20 +115,20 @@ libench::WEBPDecoder::~WEBPDecoder() {
 };
 
 libench::ImageContext libench::WEBPDecoder::decodeRGB8(const CodestreamContext& cs) {
-  return this->decode8(cs, 3);
+  return this->decode8(cs, libench::ImageFormat::RGB8);
 }
 
 libench::ImageContext libench::WEBPDecoder::decodeRGBA8(const CodestreamContext& cs) {
-  return this->decode8(cs, 4);
+  return this->decode8(cs, libench::ImageFormat::RGBA8);
 }
 
-libench::ImageContext libench::WEBPDecoder::decode8(const CodestreamContext& cs, uint8_t num_comps) {
+libench::ImageContext libench::WEBPDecoder::decode8(const CodestreamContext& cs, const ImageFormat& format) {
   WebPFree(this->image_.planes8[0]);
 
-  this->image_.format = num_comps == 3 ? libench::ImageFormat::RGB8 : libench::ImageFormat::RGBA8;
+  this->image_.format = format;
 
   int width, height;
-  this->image_.planes8[0] = num_comps == 3 ?
+  this->image_.planes8[0] = format.comps.num_comps == 3 ?
       WebPDecodeRGB(cs.codestream, cs.size, &width, &height) :
       WebPDecodeRGBA(cs.codestream, cs.size, &width, &height);
 
@@ -102,3 +140,23 @@ libench::ImageContext libench::WEBPDecoder::decode8(const CodestreamContext& cs,
 
   return this->image_;
 }
+
+void libench::WEBPDecoder::decodeInto(const CodestreamContext& cs, ImageContext& image) {
+  if (!(image.format == libench::ImageFormat::RGB8 || image.format == libench::ImageFormat::RGBA8))
+    throw std::runtime_error("Unsupported image format");
+
+  int width, height;
+
+  if (!WebPGetInfo(cs.codestream, cs.size, &width, &height))
+    throw std::runtime_error("WEBP decode failed");
+
+  if (static_cast<uint32_t>(width) != image.width || static_cast<uint32_t>(height) != image.height)
+    throw std::runtime_error("Destination image does not match the codestream");
+
+  uint8_t* pixels = image.format.comps.num_comps == 3 ?
+      WebPDecodeRGBInto(cs.codestream, cs.size, image.planes8[0], image.plane_size(0), image.line_size(0)) :
+      WebPDecodeRGBAInto(cs.codestream, cs.size, image.planes8[0], image.plane_size(0), image.line_size(0));
+
+  if (!pixels)
+    throw std::runtime_error("WEBP decode failed");
+}
@@ -1,6 +1,7 @@
 #ifndef LIBENCH_WEBP_H
 #define LIBENCH_WEBP_H
 
+#include <vector>
 #include "codec.h"
 #include "webp/encode.h"
 
@@ -15,6 +16,8 @@ class WEBPEncoder : public Encoder {
 
   CodestreamContext encodeRGBA8(const ImageContext &image) override;
 
+  CodestreamContext encodeInto(const ImageContext &image, OutputBuffer& out) override;
+
  private:
   CodestreamContext encode8(const ImageContext &image);
 
@@ -30,8 +33,10 @@ class WEBPDecoder : public Decoder {
 
   ImageContext decodeRGBA8(const CodestreamContext& cs) override;
 
+  void decodeInto(const CodestreamContext& cs, ImageContext& image) override;
+
  private:
-  ImageContext decode8(const CodestreamContext& cs, uint8_t num_comps);
+  ImageContext decode8(const CodestreamContext& cs, const ImageFormat& format);
 
   ImageContext image_;
 };
@@ -0,0 +1,81 @@
+import argparse
+import dataclasses
+import os
+import typing
+
+import sweep_common
+
+
+@dataclasses.dataclass
+class BandsResult:
+  """Result of a single band count"""
+  band_count: int
+  encode_time: float
+  decode_time: float
+  coded_size: int
+  encode_speedup: float
+  decode_speedup: float
+  size_penalty: float
+
+
+def _run(bin_path: str, codec_name: str, image_path: str, run_count: int) -> typing.Tuple[float, float, int]:
+  record = sweep_common.run_libench(bin_path, ["--repetitions", str(run_count), codec_name, image_path])
+
+  return (*sweep_common.best_times(record), record["codestreamSize"])
+
+
+def band_counts(max_band_count: int) -> typing.List[int]:
+  """Powers of two up to and including max_band_count"""
+  counts = []
+  k = 1
+  while k < max_band_count:
+    counts.append(k)
+    k *= 2
+  counts.append(max_band_count)
+  return counts
+
+
+def run_sweep(bin_path: str, codec_name: str, image_path: str, run_count: int, max_band_count: int) -> typing.List[BandsResult]:
+  """Compares the codec against bands<K>:<codec> for increasing K"""
+  base_encode_time, base_decode_time, base_size = _run(bin_path, codec_name, image_path, run_count)
+
+  results = []
+
+  for k in band_counts(max_band_count):
+    encode_time, decode_time, coded_size = _run(bin_path, f"bands{k}:{codec_name}", image_path, run_count)
+
+    results.append(BandsResult(
+      band_count=k,
+      encode_time=encode_time,
+      decode_time=decode_time,
+      coded_size=coded_size,
+      encode_speedup=base_encode_time / encode_time,
+      decode_speedup=base_decode_time / decode_time,
+      size_penalty=(coded_size - base_size) / base_size
+    ))
+
+  return results
+
+
+def _main():
+  parser = argparse.ArgumentParser(description="Measure the speedup and compression penalty of band-parallel coding.")
+  parser.add_argument("codec_name", type=str, help="Inner codec, e.g. png")
+  parser.add_argument("image_path", type=str, help="Path of the image")
+  parser.add_argument("--bin_path", type=str, default="./build/libench", help="Path of the libench executable")
+  parser.add_argument("--repetitions", type=int, default=5, help="Number of repetitions per band count")
+  parser.add_argument("--max_bands", type=int, default=os.cpu_count(), help="Largest band count, defaults to all cores")
+  parser.add_argument("--csv_path", type=str, default=None, help="Optional path of a CSV file to write the results to")
+  args = parser.parse_args()
+
+  results = run_sweep(args.bin_path, args.codec_name, args.image_path, args.repetitions, args.max_bands)
+
+  print(f"{'bands':>5} {'encode (s)':>12} {'decode (s)':>12} {'enc. speedup':>12} {'dec. speedup':>12} {'size penalty':>12}")
+  for r in results:
+    print(f"{r.band_count:>5} {r.encode_time:>12.6f} {r.decode_time:>12.6f} {r.encode_speedup:>12.2f} {r.decode_speedup:>12.2f} {r.size_penalty:>12.2%}")
+
+  if args.csv_path is not None:
+    sweep_common.write_csv(args.csv_path, BandsResult, results)
+
+
+if __name__ == "__main__":
+  _main()
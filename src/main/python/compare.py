@@ -0,0 +1,170 @@
+import argparse
+import dataclasses
+import json
+import sys
+import typing
+import numpy as np
+
+METRICS = {
+  "encode": "encodeTimes",
+  "decode": "decodeTimes",
+  "size": "codestreamSize"
+}
+
+# settings of a run that change what is measured, with the value libench records when the setting is not used;
+# records are only compared to records of the same settings
+RUN_SETTINGS = {
+  "pages": "default",
+  "allocator": "arena",
+  "isa": "native",
+  "cold": None,
+  "into": False,
+  "decodeOnly": False,
+  "batch": False
+}
+
+
+@dataclasses.dataclass
+class Comparison:
+  """Change of a metric between the baseline and the candidate over a group of images"""
+  codec_name: str
+  set_name: str
+  metric: str
+  image_count: int
+  # geometric mean over the images of candidate / baseline, e.g. 1.1 if 10% slower or larger
+  ratio: float
+  ratio_low: float
+  ratio_high: float
+  is_regression: bool
+
+
+def run_settings(record: dict) -> str:
+  """Run settings of the record that differ from the defaults, e.g. "pages=thp,into=True", or "" if none do"""
+  return ",".join(f"{k}={record[k]}" for k, default in RUN_SETTINGS.items() if record.get(k, default) != default)
+
+
+def load_records(path: str) -> typing.Dict[typing.Tuple[str, str, str, str], dict]:
+  """Reads libench JSON Lines records, keyed by image hash, codec, codec options and run settings; later records win"""
+  records = {}
+
+  with open(path, "r", encoding="utf-8") as f:
+    for line in f:
+      if not line.strip():
+        continue
+      r = json.loads(line)
+      records[(r["imageHash"], r["codec"], r.get("codecOptions", ""), run_settings(r))] = r
+
+  return records
+
+
+def _samples(record: dict, metric: str) -> np.ndarray:
+  value = record[METRICS[metric]]
+  return np.asarray(value if isinstance(value, list) else [value], dtype=float)
+
+
+def paired_bootstrap(pairs: typing.List[typing.Tuple[np.ndarray, np.ndarray]], confidence: float,
+                     resample_count: int, rng: np.random.Generator) -> typing.Tuple[float, float, float]:
+  """Returns the geometric mean of candidate / baseline and its confidence interval
+
+  Each pair holds the repetitions of one image in the baseline and the
+  candidate. Each bootstrap resample draws the images with replacement, keeping
+  the baseline and candidate of an image paired, and draws the repetitions of
+  each image with replacement, so that both the variation across images and the
+  timing noise within an image contribute to the interval.
+  """
+  point = np.exp(np.mean([np.log(b.mean()) - np.log(a.mean()) for a, b in pairs]))
+
+  # log ratio of each image, for each resample of its repetitions
+  log_ratios = np.empty((len(pairs), resample_count))
+  for i, (a, b) in enumerate(pairs):
+    a_means = rng.choice(a, size=(resample_count, len(a))).mean(axis=1)
+    b_means = rng.choice(b, size=(resample_count, len(b))).mean(axis=1)
+    log_ratios[i] = np.log(b_means) - np.log(a_means)
+
+  images = rng.integers(0, len(pairs), size=(resample_count, len(pairs)))
+  estimates = np.exp(log_ratios[images, np.arange(resample_count)[:, None]].mean(axis=1))
+
+  alpha = (1 - confidence) / 2
+
+  return point, np.quantile(estimates, alpha), np.quantile(estimates, 1 - alpha)
+
+
+def compare(baseline: dict, candidate: dict, metrics: typing.List[str], thresholds: typing.Dict[str, float],
+            confidence: float = 0.95, resample_count: int = 5000, seed: int = 0) -> typing.List[Comparison]:
+  """Compares the records found in both result sets, per codec and per (codec, image set)
+
+  Records are matched on their image, codec, codec options and run settings, so
+  that e.g. a run with --into is never compared to one without.
+
+  A change is a regression if the whole confidence interval lies above 1 and
+  the point estimate exceeds 1 + the threshold of the metric.
+  """
+  rng = np.random.default_rng(seed)
+
+  groups = {}
+  for key in sorted(baseline.keys() & candidate.keys()):
+    codec_name = key[1] if key[2] == "" else f"{key[1]} ({key[2]})"
+    if key[3] != "":
+      codec_name += f" [{key[3]}]"
+    set_name = baseline[key].get("setName", "")
+    for group in ((codec_name, "*"), (codec_name, set_name)):
+      groups.setdefault(group, []).append(key)
+
+  comparisons = []
+
+  for (codec_name, set_name), keys in sorted(groups.items()):
+    for metric in metrics:
+      pairs = [(_samples(baseline[k], metric), _samples(candidate[k], metric)) for k in keys]
+
+      if any(len(a) == 0 or len(b) == 0 for a, b in pairs):
+        continue
+
+      ratio, ratio_low, ratio_high = paired_bootstrap(pairs, confidence, resample_count, rng)
+
+      comparisons.append(Comparison(
+        codec_name=codec_name,
+        set_name=set_name,
+        metric=metric,
+        image_count=len(keys),
+        ratio=ratio,
+        ratio_low=ratio_low,
+        ratio_high=ratio_high,
+        is_regression=bool(ratio_low > 1 and ratio > 1 + thresholds[metric])
+      ))
+
+  return comparisons
+
+
+def _main(argv: typing.Optional[typing.List[str]] = None) -> int:
+  parser = argparse.ArgumentParser(description="Compare two libench result sets and fail on performance regressions.")
+  parser.add_argument("baseline_path", type=str, help="Path of the baseline JSON Lines records")
+  parser.add_argument("candidate_path", type=str, help="Path of the candidate JSON Lines records")
+  parser.add_argument("--metrics", type=str, nargs="+", default=list(METRICS.keys()), choices=list(METRICS.keys()), help="Metrics to compare")
+  parser.add_argument("--threshold", type=float, default=0.05, help="Relative slowdown above which a significant change is a regression")
+  parser.add_argument("--size_threshold", type=float, default=0.0, help="Relative size increase above which a significant change is a regression")
+  parser.add_argument("--confidence", type=float, default=0.95, help="Confidence level of the intervals")
+  parser.add_argument("--resamples", type=int, default=5000, help="Number of bootstrap resamples")
+  parser.add_argument("--seed", type=int, default=0, help="Seed of the bootstrap")
+  args = parser.parse_args(argv)
+
+  baseline = load_records(args.baseline_path)
+  candidate = load_records(args.candidate_path)
+
+  matched = len(baseline.keys() & candidate.keys())
+  print(f"Matched {matched} records ({len(baseline) - matched} only in baseline, {len(candidate) - matched} only in candidate)")
+
+  thresholds = {"encode": args.threshold, "decode": args.threshold, "size": args.size_threshold}
+
+  comparisons = compare(baseline, candidate, args.metrics, thresholds, args.confidence, args.resamples, args.seed)
+
+  print(f"{'codec':<24} {'set':<24} {'metric':>6} {'images':>6} {'change':>8} {'CI':>19}")
+  for c in comparisons:
+    verdict = "REGRESSION" if c.is_regression else ""
+    print(f"{c.codec_name:<24} {c.set_name:<24} {c.metric:>6} {c.image_count:>6} {c.ratio - 1:>+8.2%} "
+          f"[{c.ratio_low - 1:>+8.2%}, {c.ratio_high - 1:>+8.2%}] {verdict}")
+
+  return 1 if any(c.is_regression for c in comparisons) else 0
+
+
+if __name__ == "__main__":
+  sys.exit(_main())
@@ -0,0 +1,67 @@
+import argparse
+import dataclasses
+import typing
+
+import sweep_common
+
+ISA_LEVELS = ["scalar", "sse4", "avx2", "avx512"]
+
+
+@dataclasses.dataclass
+class IsaResult:
+  """Result of a codec with its SIMD paths capped at a single level"""
+  codec_name: str
+  isa: str
+  # level actually used by the codec library, which can differ from the cap
+  effective_isa: str
+  encode_time: float
+  decode_time: float
+  encode_speedup: float
+  decode_speedup: float
+
+
+def _run(bin_path: str, codec_name: str, image_path: str, run_count: int, isa: str) -> dict:
+  return sweep_common.run_libench(bin_path, ["--repetitions", str(run_count), "--isa", isa, "--jsonl", "-", codec_name, image_path])
+
+
+def run_sweep(bin_path: str, codec_name: str, image_path: str, run_count: int) -> typing.List[IsaResult]:
+  """Measures the codec at each instruction set level, relative to scalar code"""
+  records = {isa: _run(bin_path, codec_name, image_path, run_count, isa) for isa in ISA_LEVELS}
+
+  base = records["scalar"]
+
+  return [IsaResult(
+      codec_name=codec_name,
+      isa=isa,
+      effective_isa=record["effectiveIsa"],
+      encode_time=min(record["encodeTimes"]),
+      decode_time=min(record["decodeTimes"]),
+      encode_speedup=min(base["encodeTimes"]) / min(record["encodeTimes"]),
+      decode_speedup=min(base["decodeTimes"]) / min(record["decodeTimes"])
+    ) for isa, record in records.items()]
+
+
+def _main():
+  parser = argparse.ArgumentParser(description="Measure the speedup of codecs at each SIMD instruction set level.")
+  parser.add_argument("image_path", type=str, help="Path of the image")
+  parser.add_argument("codec_names", type=str, nargs="+", help="Codecs, e.g. jxl ffv1")
+  parser.add_argument("--bin_path", type=str, default="./build/libench", help="Path of the libench executable")
+  parser.add_argument("--repetitions", type=int, default=5, help="Number of repetitions per level")
+  parser.add_argument("--csv_path", type=str, default=None, help="Optional path of a CSV file to write the results to")
+  args = parser.parse_args()
+
+  print(f"{'codec':>12} {'isa':>8} {'effective':>10} {'encode (s)':>12} {'decode (s)':>12} {'enc. speedup':>12} {'dec. speedup':>12}")
+
+  results = []
+  for codec_name in args.codec_names:
+    for r in run_sweep(args.bin_path, codec_name, args.image_path, args.repetitions):
+      print(f"{r.codec_name:>12} {r.isa:>8} {r.effective_isa:>10} {r.encode_time:>12.6f} {r.decode_time:>12.6f} "
+            f"{r.encode_speedup:>12.2f} {r.decode_speedup:>12.2f}")
+      results.append(r)
+
+  if args.csv_path is not None:
+    sweep_common.write_csv(args.csv_path, IsaResult, results)
+
+
+if __name__ == "__main__":
+  _main()
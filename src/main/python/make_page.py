@@ -7,27 +7,34 @@ import argparse
 import json
 import typing
 import dataclasses
-import csv
+import tempfile
 import matplotlib.pyplot as plt
 import chevron
 import png
 import pandas as pd
+from results_store import ResultsStore
+import sharded_runner
 
 
-@dataclasses.dataclass
-class Result:
-  """Single result"""
-  codec_name: str
-  encode_time: float
-  decode_time: float
-  coded_size: float
-  image_path: str
-  image_width: int
-  image_height: int
-  image_format: str
-  image_size: int
-  set_name: str
-  run_count: int
+# version of the libench JSON Lines records, RUN_RECORD_SCHEMA_VERSION of run_record.h
+RECORD_SCHEMA_VERSION = 1
+
+# options passed to each codec, in the canonical key=value,... form that libench records as codecOptions
+CODEC_OPTIONS = ""
+
+# run settings of the pipelined runs, which have a fixed number of repetitions
+PIPELINE_SETTINGS = "--batch"
+
+# columns of the libench JSON Lines records used by the analysis
+RECORD_COLUMNS = {
+  "codec": "codec_name",
+  "setName": "set_name",
+  "imageFormat": "image_format",
+  "imageSize": "image_size",
+  "codestreamSize": "coded_size",
+  "encodeTime": "encode_time",
+  "decodeTime": "decode_time"
+}
 
 @dataclasses.dataclass
 class CodecInfo:
@@ -38,17 +45,36 @@ class CodecInfo:
 
 # colors from http://www.sussex.ac.uk/tel/resource/tel_website/accessiblecontrast
 CODEC_PREFS = {
-    "j2k_ht_ojph": CodecInfo(color="#41b6e6", marker="o", formats=["RGBA8", "RGB8"]),
+    "j2k_ht_ojph": CodecInfo(color="#41b6e6", marker="o", formats=["RGBA8", "RGB8", "YUV"]),
+    "j2k_ht_ojph_imf": CodecInfo(color="#41b6e6", marker="D", formats=["YUV"]),
     "j2k_1_kdu": CodecInfo(color="#41b6e6", marker="v", formats=["RGBA8", "RGB8", "YUV"]),
     "j2k_ht_kdu": CodecInfo(color="#41b6e6", marker="s", formats=["RGBA8", "RGB8", "YUV"]),
     "jxl": CodecInfo(color="#e56db1", marker="o", formats=["RGBA8", "RGB8"]),
     "qoi": CodecInfo(color="#dc582a", marker="o", formats=["RGBA8", "RGB8"]),
     "png": CodecInfo(color="#f2c75c", marker="o", formats=["RGBA8", "RGB8"]),
+    "png_libpng": CodecInfo(color="#f2c75c", marker="s", formats=["RGBA8", "RGB8"]),
+    "png_spng": CodecInfo(color="#f2c75c", marker="D", formats=["RGBA8", "RGB8"]),
+    "png_fpnge": CodecInfo(color="#f2c75c", marker="v", formats=["RGBA8", "RGB8"]),
     "ffv1": CodecInfo(color="#94a596", marker="o", formats=["RGBA8", "RGB8", "YUV"]),
-    "avif": CodecInfo(color="#5d3754", marker="o", formats=["RGBA8", "RGB8"]),
-    "webp": CodecInfo(color="#007a78", marker="o", formats=["RGBA8", "RGB8"])
+    "ffvhuff": CodecInfo(color="#5b7f5e", marker="o", formats=["RGBA8", "RGB8", "YUV"]),
+    "huffyuv": CodecInfo(color="#3d5a40", marker="o", formats=["RGBA8", "RGB8"]),
+    "magicyuv": CodecInfo(color="#b08ea2", marker="o", formats=["RGBA8", "RGB8"]),
+    "utvideo": CodecInfo(color="#7a5c8f", marker="o", formats=["RGBA8", "RGB8"]),
+    "avif": CodecInfo(color="#5d3754", marker="o", formats=["RGBA8", "RGB8", "YUV"]),
+    "webp": CodecInfo(color="#007a78", marker="o", formats=["RGBA8", "RGB8"]),
+    "jpegls": CodecInfo(color="#a6192e", marker="o", formats=["RGBA8", "RGB8", "YUV"])
 }
 
+def available_codecs(bin_path: str) -> typing.Dict[str, CodecInfo]:
+  """Preferences of the codecs of CODEC_PREFS that libench was built with, e.g. without ext/charls there is no jpegls"""
+  names = subprocess.run([bin_path, "--list-codecs"], check=True, stdout=subprocess.PIPE, encoding="utf-8").stdout.split()
+
+  for codec_name in CODEC_PREFS:
+    if codec_name not in names:
+      print(f"Skipping {codec_name}, which libench was built without")
+
+  return {codec_name: codec_info for codec_name, codec_info in CODEC_PREFS.items() if codec_name in names}
+
 def make_analysis(df, msg: str, fig_name: str, build_dir_path: str):
   df_by_set = df.groupby(["set_name", "codec_name"]).mean().reset_index().groupby("set_name")
   n_plots = len(df_by_set)
@@ -162,76 +188,230 @@ def make_analysis(df, msg: str, fig_name: str, build_dir_path: str):
   fig.tight_layout()
   fig.savefig(os.path.join(build_dir_path, f"{fig_name}-decode.png"))
 
-def run_perf_tests(root_path: str, bin_path: str) -> typing.List[Result]:
+def _image_format(file_path: str) -> typing.Optional[str]:
+  if os.path.splitext(file_path)[1] == ".png":
+    _, _, _png_rows, png_info = png.Reader(filename=file_path).read(lenient=True)
+
+    if png_info["greyscale"] or png_info["bitdepth"] != 8:
+      return None
+
+    return "RGBA8" if png_info["alpha"] else "RGB8"
+
+  if os.path.splitext(file_path)[1] == ".yuv":
+    return "YUV"
+
+  return None
+
+def _image_size(file_path: str) -> int:
+  """Size of the uncompressed image, in bytes"""
+  if os.path.splitext(file_path)[1] == ".png":
+    width, height, _png_rows, png_info = png.Reader(filename=file_path).read(lenient=True)
+    return width * height * png_info["planes"] * png_info["bitdepth"] // 8
+
+  return os.path.getsize(file_path)
+
+def _write_record(records_file: typing.TextIO, record: dict):
+  """Appends a record and flushes it, so that the records of completed runs survive a crash"""
+  records_file.write(json.dumps(record) + "\n")
+  records_file.flush()
+
+def _run_pipelined_collection(dirpath: str, filenames: typing.List[str], root_path: str, bin_path: str,
+                              codecs: typing.Dict[str, CodecInfo], run_count: int, sub_env: dict,
+                              store: typing.Optional[ResultsStore], records_file: typing.TextIO):
+  """Runs each codec once over all the images of a collection using the libench pipeline"""
+  collection_name = os.path.relpath(dirpath, root_path)
+
+  images = []
+  for fn in filenames:
+    file_path = os.path.join(dirpath, fn)
+    image_format = _image_format(file_path)
+    if image_format is not None:
+      images.append((file_path, image_format))
+
+  for codec_name, codec_info in codecs.items():
+
+    codec_images = [file_path for file_path, image_format in images if image_format in codec_info.formats]
+
+    if store is not None:
+      for file_path in list(codec_images):
+        stored = store.get(store.key(store.image_hash(file_path), codec_name, CODEC_OPTIONS, PIPELINE_SETTINGS, run_count))
+        if stored is not None:
+          _write_record(records_file, stored)
+          codec_images.remove(file_path)
+
+    if len(codec_images) == 0:
+      continue
+
+    print(f"{codec_name}: ", end="")
+
+    with tempfile.NamedTemporaryFile("w", suffix=".txt", encoding="utf-8", delete=False) as batch_file:
+      batch_file.write("\n".join(codec_images))
 
-  results = []
+    # libench appends a record to this file as soon as each image is verified
+    records_path = batch_file.name + ".jsonl"
+
+    try:
+      stdout = json.loads(
+        subprocess.run([bin_path, "--repetitions", str(run_count), "--batch", batch_file.name,
+                        "--jsonl", records_path, "--set-name", collection_name, codec_name],
+                       env=sub_env, check=True, stdout=subprocess.PIPE, encoding="utf-8").stdout
+        )
+
+      with open(records_path, "r", encoding="utf-8") as f:
+        for line in f:
+          record = json.loads(line)
+
+          if store is not None:
+            store.put(store.key(record["imageHash"], codec_name, CODEC_OPTIONS, PIPELINE_SETTINGS, run_count), record)
+
+          _write_record(records_file, record)
+
+    except (json.decoder.JSONDecodeError, subprocess.CalledProcessError):
+      print("x")
+      raise
+    finally:
+      os.remove(batch_file.name)
+      if os.path.exists(records_path):
+        os.remove(records_path)
+
+    queues = ", ".join(f"{q['name']} {q['meanOccupancy']:.1f}/{q['capacity']}" for q in stdout["queues"])
+    print(f"{stdout['imagesPerSecond']:.2f} images/s (mean queue occupancy: {queues})")
+
+def _run_sharded(bin_path: str, jobs: typing.List[sharded_runner.Job], worker_count: int, skew_sample: int,
+                 sub_env: dict, store: typing.Optional[ResultsStore], records_file: typing.TextIO):
+  """Runs the (image, codec) jobs concurrently, each libench process on a physical core of its own"""
+  allowed_cpus = os.sched_getaffinity(0)
+  cores = sharded_runner.physical_cores(allowed_cpus)
+  cpus, housekeeping = sharded_runner.worker_cpus(cores, max_workers=worker_count)
+
+  print(f"Running {len(jobs)} jobs on CPUs {cpus}, leaving CPUs {housekeeping} to housekeeping")
+
+  def on_record(job: sharded_runner.Job, record: dict):
+    if store is not None:
+      store.put(job.tag, record)
+    _write_record(records_file, record)
+    print(".", end="", flush=True)
+
+  # keep the runner itself off the worker cores
+  os.sched_setaffinity(0, housekeeping)
+
+  try:
+    completed = sharded_runner.run_jobs(bin_path, jobs, cpus, sub_env, on_record)
+    print()
+
+    skew = sharded_runner.measure_skew(bin_path, completed, cpus[0], sub_env, skew_sample)
+  finally:
+    os.sched_setaffinity(0, allowed_cpus)
+
+  if skew is not None:
+    print(f"Concurrent/isolated time over {skew.sample_count} jobs: "
+          f"encode {skew.encode_ratio_median:.3f} (max {skew.encode_ratio_max:.3f}), "
+          f"decode {skew.decode_ratio_median:.3f} (max {skew.decode_ratio_max:.3f})")
+
+def run_perf_tests(root_path: str, bin_path: str, records_path: str, pipeline: bool = False,
+                   store: typing.Optional[ResultsStore] = None, cold: typing.Optional[str] = None,
+                   worker_count: int = 1, skew_sample: int = 0):
+  """Runs every codec over the images found under root_path
+
+  One libench JSON Lines record per (image, codec) is written to records_path
+  as soon as it is available. Codecs that libench was built without are
+  skipped. When a results store is provided, only the
+  (image, codec) combinations that are missing from the store, or stale, are
+  measured. When cold is set to a cache eviction method, cache-cold times are
+  measured alongside the hot ones, which requires the libench processes to run
+  one at a time, since concurrent processes evict each other's caches.
+
+  When worker_count is greater than 1, the (image, codec) jobs are run by up to
+  worker_count concurrent libench processes, longest first, and skew_sample of
+  them are then re-run in isolation to measure the effect of the concurrency.
+  """
 
   sub_env = os.environ.copy()
   sub_env["OMP_NUM_THREADS"] = "1"
 
-  for dirpath, _dirnames, filenames in os.walk(root_path):
-    collection_name = os.path.relpath(dirpath, root_path)
-    print(f"Collection: {collection_name}")
+  run_count = 3
+
+  # run_count is the minimum: libench repeats until the mean times are known to
+  # within 2%, or for at most 10 s per image and codec
+  run_args = ["--precision", "0.02", "--time-budget", "10"]
 
-    for fn in filenames:
+  if cold is not None:
+    if pipeline or worker_count > 1:
+      raise ValueError("Cache-cold times require the codecs to run one at a time")
+    run_args += ["--cold", cold]
 
-      file_path = os.path.join(dirpath, fn)
+  is_sharded = worker_count > 1 and not pipeline
+  jobs = []
 
-      if os.path.splitext(fn)[1] == ".png":
-        _, _, _png_rows, png_info = png.Reader(filename=file_path).read(lenient=True)
+  codecs = available_codecs(bin_path)
 
-        if png_info["greyscale"] or png_info["bitdepth"] != 8:
+  with open(records_path, "w", encoding="utf-8") as records_file:
+    for dirpath, _dirnames, filenames in os.walk(root_path):
+      collection_name = os.path.relpath(dirpath, root_path)
+      print(f"Collection: {collection_name}")
+
+      if pipeline:
+        _run_pipelined_collection(dirpath, filenames, root_path, bin_path, codecs, run_count, sub_env, store, records_file)
+        if store is not None:
+          store.save_hash_cache()
+        continue
+
+      for fn in filenames:
+
+        file_path = os.path.join(dirpath, fn)
+
+        image_format = _image_format(file_path)
+
+        if image_format is None:
           continue
 
-        image_format = "RGBA8" if png_info["alpha"] else "RGB8"
+        rel_path = os.path.relpath(file_path, root_path)
 
-      elif os.path.splitext(fn)[1] == ".yuv":
-        image_format = "YUV"
+        print(f"{rel_path} ({image_format}): ", end="")
 
-      else:
-        continue
+        for codec_name, codec_info in codecs.items():
 
-      rel_path = os.path.relpath(file_path, root_path)
+          if not image_format in codec_info.formats:
+            continue
 
-      print(f"{rel_path} ({image_format}): ", end="")
+          store_key = None
+          if store is not None:
+            store_key = store.key(store.image_hash(file_path), codec_name, CODEC_OPTIONS, " ".join(run_args), run_count)
+            stored = store.get(store_key)
+            if stored is not None:
+              _write_record(records_file, stored)
+              print("o", end="")
+              continue
 
-      run_count = 3
+          args = ["--repetitions", str(run_count), *run_args, "--jsonl", "-", "--set-name", collection_name, codec_name, file_path]
 
-      for codec_name, codec_info in CODEC_PREFS.items():
+          if is_sharded:
+            jobs.append(sharded_runner.Job(args=args, cost=_image_size(file_path), tag=store_key))
+            continue
 
-        if not image_format in codec_info.formats:
-          continue
+          try:
+            record = json.loads(
+              subprocess.run([bin_path, *args], env=sub_env, check=True, stdout=subprocess.PIPE, encoding="utf-8").stdout
+              )
 
-        try:
-          stdout = json.loads(
-            subprocess.run([bin_path, "--repetitions", str(run_count), codec_name, file_path], env=sub_env, check=True, stdout=subprocess.PIPE, encoding="utf-8").stdout
-            )
+            if store is not None:
+              store.put(store_key, record)
 
-          result = Result(
-              codec_name=codec_name,
-              encode_time=sum(stdout["encodeTimes"])/len(stdout["encodeTimes"]),
-              decode_time=sum(stdout["decodeTimes"])/len(stdout["decodeTimes"]),
-              coded_size=stdout["codestreamSize"],
-              image_size=stdout["imageSize"],
-              image_height=stdout["imageHeight"],
-              image_width=stdout["imageWidth"],
-              image_format=image_format,
-              image_path=rel_path,
-              set_name=collection_name,
-              run_count=len(stdout["encodeTimes"])
-          )
+            _write_record(records_file, record)
 
-          results.append(result)
+            print(".", end="")
 
-          print(".", end="")
+          except (json.decoder.JSONDecodeError, subprocess.CalledProcessError):
+            print("x", end="")
+            raise
 
-        except (json.decoder.JSONDecodeError, subprocess.CalledProcessError):
-          print("x", end="")
-          raise
+        print()
 
-      print()
+      if store is not None:
+        store.save_hash_cache()
 
-  return results
+    if len(jobs) > 0:
+      _run_sharded(bin_path, jobs, worker_count, skew_sample, sub_env, store, records_file)
 
 def _main():
   parser = argparse.ArgumentParser(description="Generate static web page with lossless coding results.")
@@ -242,24 +422,26 @@ def _main():
   parser.add_argument("--version", type=str, default="unknown", help="Version string")
   parser.add_argument("--machine", type=str, default="unknown", help="Machine string")
   parser.add_argument("--compiler", type=str, default="unknown", help="Compiler version")
+  parser.add_argument("--pipeline", action="store_true", help="Run each collection through the libench load/encode/decode/verify pipeline")
+  parser.add_argument("--store", type=str, default=None, help="Path of a results store; only results missing from the store are measured")
+  parser.add_argument("--cold", type=str, default=None, choices=["sweep", "clflush"], help="Also measure cache-cold encode and decode times using the specified eviction method")
+  parser.add_argument("--jobs", type=int, default=1, help="Number of concurrent libench processes, each pinned to a physical core of its own")
+  parser.add_argument("--skew_sample", type=int, default=20, help="With --jobs, number of jobs re-run in isolation to measure the effect of the concurrency")
   args = parser.parse_args()
 
   os.makedirs(args.build_path, exist_ok=True)
 
-  results_path = os.path.join(args.build_path, "results.csv")
+  results_path = os.path.join(args.build_path, "results.jsonl")
 
   if not args.skip_run:
-    results = run_perf_tests(args.images_path, args.bin_path)
-
-    with open(results_path, "w", encoding="utf-8") as csvfile:
-      writer = csv.DictWriter(csvfile, list(map(lambda x: x.name, dataclasses.fields(Result))))
-
-      writer.writeheader()
-
-      for result in results:
-        writer.writerow(dataclasses.asdict(result))
+    store = ResultsStore(args.store, args.bin_path, schema_version=RECORD_SCHEMA_VERSION) if args.store is not None else None
+    if args.pipeline and args.cold is not None:
+      parser.error("--cold cannot be combined with --pipeline")
+    if args.jobs > 1 and args.cold is not None:
+      parser.error("--cold cannot be combined with --jobs greater than 1")
+    run_perf_tests(args.images_path, args.bin_path, results_path, args.pipeline, store, args.cold, args.jobs, args.skew_sample)
 
-  df = pd.read_csv(results_path)
+  df = pd.read_json(results_path, lines=True)[list(RECORD_COLUMNS.keys())].rename(columns=RECORD_COLUMNS)
 
   panels = []
 
@@ -270,7 +452,7 @@ def _main():
     make_analysis(df_rgb, "RGB(A), 8-bit, single thread", "rgb", args.build_path)
     panels.append({"name": "RGB(A)", "id": "rgb", "active": "true"})
 
-  df_yuv = df[df.image_format.isin(["YUV"])]
+  df_yuv = df[df.image_format.str.startswith("YUV")]
   if not df_yuv.empty:
     make_analysis(df_yuv, "YCbCr, 10-bit, single thread", "yuv", args.build_path)
     panels.append({"name": "YCbCr", "id": "yuv"})
@@ -0,0 +1,85 @@
+import argparse
+import dataclasses
+import itertools
+import subprocess
+import typing
+
+import sweep_common
+
+PAGE_SIZES = ["default", "4k", "thp", "hugetlbfs"]
+ALLOCATORS = ["glibc", "arena", "jemalloc", "mimalloc"]
+
+
+@dataclasses.dataclass
+class MemoryResult:
+  """Result of a single page size and allocator combination"""
+  pages: str
+  allocator: str
+  encode_time: float
+  decode_time: float
+  encode_speedup: float
+  decode_speedup: float
+
+
+def _run(bin_path: str, codec_name: str, image_path: str, run_count: int, pages: str,
+         allocator: str) -> typing.Optional[typing.Tuple[float, float]]:
+  """Returns None if the combination is not available on this machine, e.g. jemalloc is not installed"""
+  args = ["--repetitions", str(run_count), "--into", "--allocator", allocator]
+  if pages != "default":
+    args += ["--pages", pages]
+
+  try:
+    record = sweep_common.run_libench(bin_path, [*args, codec_name, image_path], capture_stderr=True)
+  except subprocess.CalledProcessError as e:
+    print(f"Skipping {pages}/{allocator}: {e.stderr.strip()}")
+    return None
+
+  return sweep_common.best_times(record)
+
+
+def run_sweep(bin_path: str, codec_name: str, image_path: str, run_count: int) -> typing.List[MemoryResult]:
+  """Measures the codec for each page size and allocator, relative to malloc-backed buffers and glibc"""
+  base = _run(bin_path, codec_name, image_path, run_count, "default", "glibc")
+  if base is None:
+    raise RuntimeError("Baseline run failed")
+
+  results = []
+
+  for pages, allocator in itertools.product(PAGE_SIZES, ALLOCATORS):
+    times = _run(bin_path, codec_name, image_path, run_count, pages, allocator)
+    if times is None:
+      continue
+
+    results.append(MemoryResult(
+      pages=pages,
+      allocator=allocator,
+      encode_time=times[0],
+      decode_time=times[1],
+      encode_speedup=base[0] / times[0],
+      decode_speedup=base[1] / times[1]
+    ))
+
+  return results
+
+
+def _main():
+  parser = argparse.ArgumentParser(description="Measure the sensitivity of a codec to the page size and allocator.")
+  parser.add_argument("codec_name", type=str, help="Codec, e.g. png")
+  parser.add_argument("image_path", type=str, help="Path of the image")
+  parser.add_argument("--bin_path", type=str, default="./build/libench", help="Path of the libench executable")
+  parser.add_argument("--repetitions", type=int, default=5, help="Number of repetitions per combination")
+  parser.add_argument("--csv_path", type=str, default=None, help="Optional path of a CSV file to write the results to")
+  args = parser.parse_args()
+
+  results = run_sweep(args.bin_path, args.codec_name, args.image_path, args.repetitions)
+
+  print(f"{'pages':>10} {'allocator':>10} {'encode (s)':>12} {'decode (s)':>12} {'enc. speedup':>12} {'dec. speedup':>12}")
+  for r in results:
+    print(f"{r.pages:>10} {r.allocator:>10} {r.encode_time:>12.6f} {r.decode_time:>12.6f} {r.encode_speedup:>12.2f} {r.decode_speedup:>12.2f}")
+
+  if args.csv_path is not None:
+    sweep_common.write_csv(args.csv_path, MemoryResult, results)
+
+
+if __name__ == "__main__":
+  _main()
@@ -0,0 +1,127 @@
+import hashlib
+import json
+import os
+import os.path
+import platform
+import subprocess
+import typing
+
+
+def _cpu_model() -> str:
+  try:
+    with open("/proc/cpuinfo", "r", encoding="utf-8") as cpuinfo:
+      for line in cpuinfo:
+        if line.startswith("model name"):
+          return line.split(":", 1)[1].strip()
+  except OSError:
+    pass
+  return platform.processor()
+
+
+def machine_fingerprint() -> str:
+  """Identifies the hardware and OS the results were measured on, excluding the kernel release"""
+  return " | ".join([_cpu_model(), str(os.cpu_count()), platform.machine(), platform.system()])
+
+
+def build_info(bin_path: str) -> dict:
+  """Versions embedded in the libench binary, see libench --build-info"""
+  return json.loads(
+    subprocess.run([bin_path, "--build-info"], check=True, stdout=subprocess.PIPE, encoding="utf-8").stdout
+    )
+
+
+class ResultsStore:
+  """Content-addressed store of libench results
+
+  Each result is keyed by the hash of the input image, the codec, the codec
+  options, the run settings, the number of repetitions, the libench version, the
+  revision of the library of the codec and the machine fingerprint, so that a
+  result becomes stale, and is re-measured, as soon as any of these change.
+  Updating one codec library thus only invalidates the results of the codecs
+  built on it. When a schema version is specified, stored records of another
+  version, e.g. written before records were versioned, are stale as well.
+  """
+
+  HASH_CACHE_NAME = "image_hashes.json"
+
+  def __init__(self, store_path: str, bin_path: str, schema_version: typing.Optional[int] = None):
+    self.store_path = store_path
+    self.bin_path = bin_path
+    self.schema_version = schema_version
+    info = build_info(bin_path)
+    self.libench_version = info["libenchVersion"]
+    self.submodules = info["submodules"]
+    self.codec_libraries = info["codecLibraries"]
+    self.machine = machine_fingerprint()
+
+    os.makedirs(self.store_path, exist_ok=True)
+
+    self.hash_cache_path = os.path.join(self.store_path, ResultsStore.HASH_CACHE_NAME)
+    self.hash_cache = {}
+    if os.path.exists(self.hash_cache_path):
+      with open(self.hash_cache_path, "r", encoding="utf-8") as f:
+        self.hash_cache = json.load(f)
+
+  def image_hash(self, file_path: str) -> str:
+    """Returns the hash libench computes over the image samples, cached by path, size and modification time"""
+    stat = os.stat(file_path)
+    abs_path = os.path.abspath(file_path)
+
+    cached = self.hash_cache.get(abs_path)
+    if cached is not None and cached["size"] == stat.st_size and cached["mtime_ns"] == stat.st_mtime_ns:
+      return cached["hash"]
+
+    image_hash = json.loads(
+      subprocess.run([self.bin_path, "--hash-only", file_path], check=True, stdout=subprocess.PIPE, encoding="utf-8").stdout
+      )["imageHash"]
+
+    self.hash_cache[abs_path] = {"size": stat.st_size, "mtime_ns": stat.st_mtime_ns, "hash": image_hash}
+
+    return image_hash
+
+  def save_hash_cache(self):
+    tmp_path = self.hash_cache_path + ".tmp"
+    with open(tmp_path, "w", encoding="utf-8") as f:
+      json.dump(self.hash_cache, f)
+    os.replace(tmp_path, self.hash_cache_path)
+
+  def codec_version(self, codec_name: str) -> str:
+    """Submodule revision of the library of the codec, or "unknown" if it is not built from a submodule"""
+    # bands<K>:<codec> uses the library of the inner codec
+    if codec_name.startswith("bands") and ":" in codec_name:
+      codec_name = codec_name.split(":", 1)[1]
+    return self.submodules.get(self.codec_libraries.get(codec_name, ""), "unknown")
+
+  def key(self, image_hash: str, codec_name: str, codec_options: str, run_settings: str, run_count: int) -> str:
+    """run_settings are the libench arguments, other than the codec options, that change what is measured"""
+    return hashlib.sha256(json.dumps({
+      "image": image_hash,
+      "codec": codec_name,
+      "options": codec_options,
+      "settings": run_settings,
+      "runCount": run_count,
+      "libenchVersion": self.libench_version,
+      "codecVersion": self.codec_version(codec_name),
+      "machine": self.machine
+    }, sort_keys=True).encode("utf-8")).hexdigest()
+
+  def _path(self, key: str) -> str:
+    return os.path.join(self.store_path, key[:2], key + ".json")
+
+  def get(self, key: str) -> typing.Optional[dict]:
+    path = self._path(key)
+    if not os.path.exists(path):
+      return None
+    with open(path, "r", encoding="utf-8") as f:
+      record = json.load(f)
+    if self.schema_version is not None and record.get("schemaVersion") != self.schema_version:
+      return None
+    return record
+
+  def put(self, key: str, record: dict):
+    path = self._path(key)
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    tmp_path = path + ".tmp"
+    with open(tmp_path, "w", encoding="utf-8") as f:
+      json.dump(record, f)
+    os.replace(tmp_path, path)
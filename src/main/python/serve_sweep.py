@@ -0,0 +1,106 @@
+import argparse
+import dataclasses
+import os
+import typing
+import matplotlib.pyplot as plt
+
+import sweep_common
+
+# offered load, as a fraction of the capacity measured by the calibration run
+LOAD_FRACTIONS = [0.1, 0.3, 0.5, 0.7, 0.8, 0.9, 0.95, 1.0, 1.1, 1.25]
+
+
+@dataclasses.dataclass
+class ServeResult:
+  """Latency of a codec at a single offered load"""
+  codec_name: str
+  offered_load: float
+  throughput: float
+  utilization: float
+  latency_p50: float
+  latency_p99: float
+  latency_p999: float
+
+
+def _serve(bin_path: str, codec_name: str, list_path: str, workers: int, rate: float, request_count: int,
+           is_encode: bool) -> dict:
+  args = ["--serve", list_path, "--workers", str(workers), "--rate", str(rate), "--requests", str(request_count)]
+  if is_encode:
+    args.append("--serve-encode")
+
+  return sweep_common.run_libench(bin_path, [*args, codec_name])
+
+
+def run_sweep(bin_path: str, codec_name: str, list_path: str, workers: int, duration: float,
+              is_encode: bool) -> typing.List[ServeResult]:
+  """Measures the latency percentiles of the codec from light load to past saturation"""
+
+  # at a light load, the measured service time gives the capacity of the workers
+  capacity = _serve(bin_path, codec_name, list_path, workers, 1, 20, is_encode)["capacity"]
+
+  results = []
+
+  for fraction in LOAD_FRACTIONS:
+    rate = fraction * capacity
+    report = _serve(bin_path, codec_name, list_path, workers, rate, max(100, int(rate * duration)), is_encode)
+
+    results.append(ServeResult(
+      codec_name=codec_name,
+      offered_load=report["offeredLoad"],
+      throughput=report["throughput"],
+      utilization=report["offeredLoad"] / report["capacity"],
+      latency_p50=report["latencyP50"],
+      latency_p99=report["latencyP99"],
+      latency_p999=report["latencyP999"]
+    ))
+
+    print(f"{codec_name:>12} {fraction:>6.0%} {report['offeredLoad']:>10.1f} {report['throughput']:>10.1f} "
+          f"{report['latencyP50'] * 1000:>10.3f} {report['latencyP99'] * 1000:>10.3f} {report['latencyP999'] * 1000:>10.3f}")
+
+  return results
+
+
+def plot(results: typing.List[ServeResult], fig_path: str):
+  fig, axs = plt.subplots(1, 3, figsize=(15, 5), sharey=True)
+
+  for ax, (name, field) in zip(axs, [("p50", "latency_p50"), ("p99", "latency_p99"), ("p99.9", "latency_p999")]):
+    for codec_name in sorted(set(r.codec_name for r in results)):
+      codec_results = [r for r in results if r.codec_name == codec_name]
+      ax.plot([r.utilization for r in codec_results], [getattr(r, field) for r in codec_results], marker="o", label=codec_name)
+    ax.set_title(f"{name} latency")
+    ax.set_xlabel("Offered load / capacity")
+    ax.set_yscale("log")
+
+  axs[0].set_ylabel("Latency (s)")
+  axs[0].legend(loc="upper left")
+  fig.tight_layout()
+  fig.savefig(fig_path)
+
+
+def _main():
+  parser = argparse.ArgumentParser(description="Measure the tail latency of codecs served under open-loop load.")
+  parser.add_argument("list_path", type=str, help="Path of a file listing the images of the corpus, one per line")
+  parser.add_argument("codec_names", type=str, nargs="+", help="Codecs, e.g. png jxl")
+  parser.add_argument("--bin_path", type=str, default="./build/libench", help="Path of the libench executable")
+  parser.add_argument("--workers", type=int, default=os.cpu_count(), help="Number of worker threads")
+  parser.add_argument("--duration", type=float, default=10, help="Approximate duration of each load step, in seconds")
+  parser.add_argument("--encode", action="store_true", help="Serve encode requests instead of decode requests")
+  parser.add_argument("--csv_path", type=str, default=None, help="Optional path of a CSV file to write the results to")
+  parser.add_argument("--fig_path", type=str, default=None, help="Optional path of a plot of latency against load")
+  args = parser.parse_args()
+
+  print(f"{'codec':>12} {'load':>6} {'offered':>10} {'achieved':>10} {'p50 (ms)':>10} {'p99 (ms)':>10} {'p99.9 (ms)':>10}")
+
+  results = []
+  for codec_name in args.codec_names:
+    results.extend(run_sweep(args.bin_path, codec_name, args.list_path, args.workers, args.duration, args.encode))
+
+  if args.csv_path is not None:
+    sweep_common.write_csv(args.csv_path, ServeResult, results)
+
+  if args.fig_path is not None:
+    plot(results, args.fig_path)
+
+
+if __name__ == "__main__":
+  _main()
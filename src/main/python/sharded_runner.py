@@ -0,0 +1,184 @@
+import dataclasses
+import json
+import os
+import random
+import statistics
+import subprocess
+import threading
+import typing
+
+
+SYSFS_CPU_PATH = "/sys/devices/system/cpu"
+
+
+@dataclasses.dataclass
+class Job:
+  """A single libench run"""
+  args: typing.List[str]
+  # estimated duration, in arbitrary units, used to start the longest jobs first
+  cost: float
+  # opaque to the runner
+  tag: typing.Any = None
+
+
+@dataclasses.dataclass
+class SkewReport:
+  """Ratio of the times measured concurrently to the times measured in isolation"""
+  sample_count: int
+  encode_ratio_median: float
+  encode_ratio_max: float
+  decode_ratio_median: float
+  decode_ratio_max: float
+
+
+def _parse_cpu_list(cpu_list: str) -> typing.Set[int]:
+  """Parses a kernel CPU list, e.g. 0-3,8"""
+  cpus = set()
+
+  for part in cpu_list.strip().split(","):
+    if "-" in part:
+      first, last = part.split("-")
+      cpus.update(range(int(first), int(last) + 1))
+    elif part:
+      cpus.add(int(part))
+
+  return cpus
+
+
+def physical_cores(allowed_cpus: typing.Iterable[int], sysfs_path: str = SYSFS_CPU_PATH) -> typing.List[typing.List[int]]:
+  """Groups the allowed logical CPUs by physical core, i.e. with their SMT siblings, sorted by CPU number"""
+  cores = {}
+
+  for cpu in sorted(allowed_cpus):
+    topology_path = os.path.join(sysfs_path, f"cpu{cpu}", "topology")
+
+    try:
+      with open(os.path.join(topology_path, "thread_siblings_list"), encoding="utf-8") as f:
+        siblings = _parse_cpu_list(f.read())
+    except FileNotFoundError:
+      siblings = {cpu}
+
+    cores.setdefault(min(siblings), []).append(cpu)
+
+  return [cores[k] for k in sorted(cores)]
+
+
+def worker_cpus(cores: typing.List[typing.List[int]], housekeeping_count: int = 1,
+                max_workers: typing.Optional[int] = None) -> typing.Tuple[typing.List[int], typing.List[int]]:
+  """Returns one logical CPU for each worker and the CPUs left to housekeeping
+
+  Each worker gets a physical core of its own, on which only its first logical
+  CPU is used so that its SMT siblings stay idle. The first physical cores are
+  left to the runner and the rest of the system.
+  """
+  if len(cores) <= housekeeping_count:
+    raise ValueError(f"At least {housekeeping_count + 1} physical cores are required, found {len(cores)}")
+
+  housekeeping = [cpu for core in cores[:housekeeping_count] for cpu in core]
+  workers = [core[0] for core in cores[housekeeping_count:]]
+
+  if max_workers is not None:
+    workers = workers[:max_workers]
+
+  return workers, housekeeping
+
+
+def _run(bin_path: str, job: Job, env: dict) -> dict:
+  return json.loads(
+    subprocess.run([bin_path, *job.args], env=env, check=True, stdout=subprocess.PIPE, encoding="utf-8").stdout
+    )
+
+
+def run_jobs(bin_path: str, jobs: typing.List[Job], cpus: typing.List[int], env: dict,
+             on_record: typing.Callable[[Job, dict], None]) -> typing.List[typing.Tuple[Job, dict]]:
+  """Runs the jobs, longest first, with one libench process at a time pinned to each CPU
+
+  Each job is expected to print a single JSON record, which is passed to
+  on_record as soon as the job completes; on_record is never called
+  concurrently. Once a job fails, no further job is started and the error is
+  raised after the running jobs have completed.
+  """
+  pending = sorted(jobs, key=lambda j: j.cost, reverse=True)
+  completed = []
+  errors = []
+  lock = threading.Lock()
+
+  def worker(cpu: int):
+    # the affinity of the calling thread is inherited by the processes it starts
+    os.sched_setaffinity(0, {cpu})
+
+    while True:
+      with lock:
+        if len(pending) == 0 or len(errors) > 0:
+          return
+        job = pending.pop(0)
+
+      try:
+        record = _run(bin_path, job, env)
+      except Exception as e: # pylint: disable=broad-except
+        with lock:
+          errors.append(e)
+        return
+
+      with lock:
+        completed.append((job, record))
+        on_record(job, record)
+
+  threads = [threading.Thread(target=worker, args=(cpu,)) for cpu in cpus]
+
+  for t in threads:
+    t.start()
+
+  for t in threads:
+    t.join()
+
+  if len(errors) > 0:
+    raise errors[0]
+
+  return completed
+
+
+def _ratios(completed: typing.List[typing.Tuple[dict, dict]], field: str) -> typing.List[float]:
+  return [concurrent[field] / isolated[field] for concurrent, isolated in completed
+          if concurrent.get(field, 0) > 0 and isolated.get(field, 0) > 0]
+
+
+def measure_skew(bin_path: str, completed: typing.List[typing.Tuple[Job, dict]], cpu: int, env: dict,
+                 sample_count: int, seed: int = 0) -> typing.Optional[SkewReport]:
+  """Re-runs a random sample of the completed jobs one at a time, with the rest of the machine idle
+
+  Returns None if no job was sampled.
+  """
+  sample = random.Random(seed).sample(completed, min(sample_count, len(completed)))
+
+  if len(sample) == 0:
+    return None
+
+  pairs = []
+  errors = []
+
+  def isolated_runs():
+    os.sched_setaffinity(0, {cpu})
+    try:
+      for job, record in sample:
+        pairs.append((record, _run(bin_path, job, env)))
+    except Exception as e: # pylint: disable=broad-except
+      errors.append(e)
+
+  thread = threading.Thread(target=isolated_runs)
+  thread.start()
+  thread.join()
+
+  if len(errors) > 0:
+    raise errors[0]
+
+  encode_ratios = _ratios(pairs, "encodeTime") or [1.0]
+  decode_ratios = _ratios(pairs, "decodeTime") or [1.0]
+
+  return SkewReport(
+    sample_count=len(pairs),
+    encode_ratio_median=statistics.median(encode_ratios),
+    encode_ratio_max=max(encode_ratios),
+    decode_ratio_median=statistics.median(decode_ratios),
+    decode_ratio_max=max(decode_ratios)
+  )
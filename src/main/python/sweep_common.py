@@ -0,0 +1,36 @@
+import csv
+import dataclasses
+import json
+import os
+import subprocess
+import typing
+
+
+def run_libench(bin_path: str, args: typing.List[str], capture_stderr: bool = False) -> dict:
+  """Runs libench with OpenMP limited to one thread and returns the JSON document it writes to stdout
+
+  Raises subprocess.CalledProcessError if libench fails, whose stderr attribute holds the error message if
+  capture_stderr is set.
+  """
+  sub_env = os.environ.copy()
+  sub_env["OMP_NUM_THREADS"] = "1"
+
+  proc = subprocess.run([bin_path, *args], env=sub_env, stdout=subprocess.PIPE,
+                        stderr=subprocess.PIPE if capture_stderr else None, encoding="utf-8")
+  proc.check_returncode()
+
+  return json.loads(proc.stdout)
+
+
+def best_times(record: dict) -> typing.Tuple[float, float]:
+  """Fastest encode and decode times of a libench run"""
+  return (min(record["encodeTimes"]), min(record["decodeTimes"]))
+
+
+def write_csv(csv_path: str, cls, rows):
+  """Writes rows, instances of the dataclass cls, to a CSV file with a column per field"""
+  with open(csv_path, "w", encoding="utf-8") as csvfile:
+    writer = csv.DictWriter(csvfile, list(map(lambda x: x.name, dataclasses.fields(cls))))
+    writer.writeheader()
+    for r in rows:
+      writer.writerow(dataclasses.asdict(r))
@@ -0,0 +1,128 @@
+import argparse
+import dataclasses
+import typing
+
+import numpy as np
+
+import sweep_common
+
+
+@dataclasses.dataclass
+class SizeResult:
+  """Result of a single codec at a single image size"""
+  codec_name: str
+  width: int
+  height: int
+  encode_time: float
+  decode_time: float
+  coded_size: int
+
+
+@dataclasses.dataclass
+class ScalingFit:
+  """Least-squares fit of time = overhead + pixel_count * time_per_pixel"""
+  codec_name: str
+  encode_ns_per_pixel: float
+  encode_overhead_us: float
+  decode_ns_per_pixel: float
+  decode_overhead_us: float
+
+
+def _run(bin_path: str, codec_name: str, image_spec: str, run_count: int) -> typing.Tuple[float, float, int]:
+  record = sweep_common.run_libench(bin_path, ["--repetitions", str(run_count), codec_name, image_spec])
+
+  return (*sweep_common.best_times(record), record["codestreamSize"])
+
+
+def image_sizes(min_size: int, max_size: int, steps_per_octave: int) -> typing.List[typing.Tuple[int, int]]:
+  """Square sizes spaced geometrically between min_size and max_size, rounded to multiples of 16"""
+  sizes = []
+  size = float(min_size)
+  while size <= max_size:
+    side = max(16, int(round(size / 16)) * 16)
+    if len(sizes) == 0 or sizes[-1][0] != side:
+      sizes.append((side, side))
+    size *= 2 ** (1 / steps_per_octave)
+  return sizes
+
+
+def run_sweep(bin_path: str, codec_name: str, pattern: str, pix_fmt: str, param: typing.Optional[str],
+              sizes: typing.List[typing.Tuple[int, int]], run_count: int) -> typing.List[SizeResult]:
+  results = []
+
+  for width, height in sizes:
+    image_spec = f"synth:{pattern}:{width}x{height}:{pix_fmt}" + (f":{param}" if param is not None else "")
+
+    encode_time, decode_time, coded_size = _run(bin_path, codec_name, image_spec, run_count)
+
+    results.append(SizeResult(
+      codec_name=codec_name,
+      width=width,
+      height=height,
+      encode_time=encode_time,
+      decode_time=decode_time,
+      coded_size=coded_size
+    ))
+
+  return results
+
+
+def fit_scaling(codec_name: str, results: typing.List[SizeResult]) -> ScalingFit:
+  pixel_counts = np.array([r.width * r.height for r in results], dtype=float)
+
+  encode_slope, encode_intercept = np.polyfit(pixel_counts, [r.encode_time for r in results], 1)
+  decode_slope, decode_intercept = np.polyfit(pixel_counts, [r.decode_time for r in results], 1)
+
+  return ScalingFit(
+    codec_name=codec_name,
+    encode_ns_per_pixel=encode_slope * 1e9,
+    encode_overhead_us=encode_intercept * 1e6,
+    decode_ns_per_pixel=decode_slope * 1e9,
+    decode_overhead_us=decode_intercept * 1e6
+  )
+
+
+def _main():
+  parser = argparse.ArgumentParser(description="Measure how codec throughput scales with image size using synthetic images.")
+  parser.add_argument("codec_names", type=str, nargs="+", help="Codecs to measure, e.g. qoi png")
+  parser.add_argument("--pattern", type=str, default="natural", help="Synthetic pattern: flat, gradient, noise, screen or natural")
+  parser.add_argument("--pix_fmt", type=str, default="rgb24", help="Pixel format of the synthetic images, e.g. rgb24 or yuv422p10le")
+  parser.add_argument("--param", type=str, default=None, help="Optional pattern parameter, e.g. the noise entropy in bits")
+  parser.add_argument("--min_size", type=int, default=64, help="Smallest image side")
+  parser.add_argument("--max_size", type=int, default=4096, help="Largest image side")
+  parser.add_argument("--steps_per_octave", type=int, default=2, help="Number of image sizes per doubling of the side")
+  parser.add_argument("--bin_path", type=str, default="./build/libench", help="Path of the libench executable")
+  parser.add_argument("--repetitions", type=int, default=5, help="Number of repetitions per image size")
+  parser.add_argument("--csv_path", type=str, default=None, help="Optional path of a CSV file to write the per-size results to")
+  args = parser.parse_args()
+
+  sizes = image_sizes(args.min_size, args.max_size, args.steps_per_octave)
+
+  all_results = []
+  fits = []
+
+  for codec_name in args.codec_names:
+    results = run_sweep(args.bin_path, codec_name, args.pattern, args.pix_fmt, args.param, sizes, args.repetitions)
+    all_results.extend(results)
+
+    print(f"{codec_name}")
+    print(f"{'size':>11} {'enc. ns/px':>12} {'dec. ns/px':>12} {'bytes/px':>10}")
+    for r in results:
+      pixel_count = r.width * r.height
+      print(f"{r.width:>5}x{r.height:<5} {r.encode_time / pixel_count * 1e9:>12.2f} "
+            f"{r.decode_time / pixel_count * 1e9:>12.2f} {r.coded_size / pixel_count:>10.3f}")
+
+    fits.append(fit_scaling(codec_name, results))
+
+  print()
+  print(f"{'codec':>20} {'enc. ns/px':>12} {'enc. fixed (us)':>16} {'dec. ns/px':>12} {'dec. fixed (us)':>16}")
+  for f in fits:
+    print(f"{f.codec_name:>20} {f.encode_ns_per_pixel:>12.2f} {f.encode_overhead_us:>16.1f} "
+          f"{f.decode_ns_per_pixel:>12.2f} {f.decode_overhead_us:>16.1f}")
+
+  if args.csv_path is not None:
+    sweep_common.write_csv(args.csv_path, SizeResult, all_results)
+
+
+if __name__ == "__main__":
+  _main()
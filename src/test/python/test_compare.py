@@ -0,0 +1,86 @@
+import unittest
+import json
+import os
+import compare
+
+
+def _record(image_hash: str, codec_name: str, set_name: str, encode_times, decode_times, size: int) -> dict:
+  return {
+    "schemaVersion": 1,
+    "imageHash": image_hash,
+    "codec": codec_name,
+    "codecOptions": "",
+    "setName": set_name,
+    "encodeTimes": encode_times,
+    "decodeTimes": decode_times,
+    "codestreamSize": size
+  }
+
+
+def _write_records(path: str, records):
+  with open(path, "w", encoding="utf-8") as f:
+    for r in records:
+      f.write(json.dumps(r) + "\n")
+
+
+class CompareTest(unittest.TestCase):
+
+  BUILD_DIR = "build/python_test"
+
+  def setUp(self):
+    os.makedirs(CompareTest.BUILD_DIR, exist_ok=True)
+
+    self.baseline = [
+      _record(f"{i:032x}", "qoi", "photo", [1.0 + 0.01 * i, 1.02 + 0.01 * i, 0.98 + 0.01 * i], [0.5, 0.51, 0.49], 1000 + i)
+      for i in range(8)
+    ]
+
+  def _run(self, candidate) -> int:
+    baseline_path = os.path.join(CompareTest.BUILD_DIR, "baseline.jsonl")
+    candidate_path = os.path.join(CompareTest.BUILD_DIR, "candidate.jsonl")
+
+    _write_records(baseline_path, self.baseline)
+    _write_records(candidate_path, candidate)
+
+    return compare._main([baseline_path, candidate_path, "--resamples", "500"])
+
+  def test_no_change(self):
+    self.assertEqual(self._run(self.baseline), 0)
+
+  def test_encode_regression(self):
+    candidate = [dict(r, encodeTimes=[t * 1.2 for t in r["encodeTimes"]]) for r in self.baseline]
+
+    self.assertEqual(self._run(candidate), 1)
+
+  def test_improvement(self):
+    candidate = [dict(r, decodeTimes=[t * 0.8 for t in r["decodeTimes"]]) for r in self.baseline]
+
+    self.assertEqual(self._run(candidate), 0)
+
+  def test_size_regression(self):
+    candidate = [dict(r, codestreamSize=r["codestreamSize"] + 10) for r in self.baseline]
+
+    self.assertEqual(self._run(candidate), 1)
+
+  def test_run_settings(self):
+    # the same images measured with other settings are not compared to the baseline
+    candidate = [dict(r, encodeTimes=[t * 1.2 for t in r["encodeTimes"]], pages="thp", into=True) for r in self.baseline]
+
+    self.assertEqual(self._run(candidate), 0)
+
+    baseline = compare.load_records(os.path.join(CompareTest.BUILD_DIR, "baseline.jsonl"))
+    candidate = compare.load_records(os.path.join(CompareTest.BUILD_DIR, "candidate.jsonl"))
+    self.assertEqual(len(baseline.keys() & candidate.keys()), 0)
+    self.assertEqual({k[3] for k in candidate}, {"pages=thp,into=True"})
+
+  def test_confidence_interval(self):
+    baseline = {(r["imageHash"], r["codec"], "", ""): r for r in self.baseline}
+    candidate = {k: dict(r, encodeTimes=[t * 1.1 for t in r["encodeTimes"]]) for k, r in baseline.items()}
+
+    comparisons = compare.compare(baseline, candidate, ["encode"], {"encode": 0.05}, resample_count=500)
+
+    for c in comparisons:
+      self.assertAlmostEqual(c.ratio, 1.1)
+      self.assertLessEqual(c.ratio_low, c.ratio)
+      self.assertGreaterEqual(c.ratio_high, c.ratio)
+      self.assertTrue(c.is_regression)
@@ -1,5 +1,6 @@
 import unittest
 import os
+import json
 import make_page
 
 
@@ -12,10 +13,23 @@ class MakePageTest(unittest.TestCase):
     os.makedirs(MakePageTest.BUILD_DIR, exist_ok=True)
 
   def test_perf_tests(self):
-    results = make_page.run_perf_tests("src/test/resources/images", MakePageTest.BIN_PATH)
+    records_path = os.path.join(MakePageTest.BUILD_DIR, "results.jsonl")
 
-    self.assertIsNotNone(results)
-    self.assertEqual(len(results), 14)
+    make_page.run_perf_tests("src/test/resources/images", MakePageTest.BIN_PATH, records_path)
+
+    with open(records_path, "r", encoding="utf-8") as f:
+      records = [json.loads(line) for line in f]
+
+    # one record per test image and codec of the build that supports its format
+    codecs = make_page.available_codecs(MakePageTest.BIN_PATH)
+    image_formats = [make_page._image_format(os.path.join(dirpath, fn))
+                     for dirpath, _dirnames, filenames in os.walk("src/test/resources/images") for fn in filenames]
+    expected_count = sum(1 for image_format in image_formats if image_format is not None
+                         for codec_info in codecs.values() if image_format in codec_info.formats)
+
+    self.assertEqual(len(records), expected_count)
+    for record in records:
+      self.assertEqual(record["schemaVersion"], make_page.RECORD_SCHEMA_VERSION)
 
   def test_make_analysis(self):
     make_page.make_analysis("src/test/resources/results/results.csv", MakePageTest.BUILD_DIR)
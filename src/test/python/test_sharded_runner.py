@@ -0,0 +1,73 @@
+import unittest
+import os
+import stat
+import sharded_runner
+
+
+class ShardedRunnerTest(unittest.TestCase):
+
+  BUILD_DIR = "build/python_test"
+
+  def setUp(self):
+    os.makedirs(ShardedRunnerTest.BUILD_DIR, exist_ok=True)
+
+    # stands in for libench: prints a record whose times are its first argument
+    self.bin_path = os.path.abspath(os.path.join(ShardedRunnerTest.BUILD_DIR, "fake_libench"))
+    with open(self.bin_path, "w", encoding="utf-8") as f:
+      f.write("#!/bin/sh\necho \"{\\\"encodeTime\\\": $1, \\\"decodeTime\\\": $1}\"\n")
+    os.chmod(self.bin_path, os.stat(self.bin_path).st_mode | stat.S_IXUSR)
+
+  def test_physical_cores(self):
+    sysfs_path = os.path.join(ShardedRunnerTest.BUILD_DIR, "sysfs")
+
+    # 4 cores with 2 threads each, numbered as on most x86 hosts
+    for cpu in range(8):
+      topology_path = os.path.join(sysfs_path, f"cpu{cpu}", "topology")
+      os.makedirs(topology_path, exist_ok=True)
+      with open(os.path.join(topology_path, "thread_siblings_list"), "w", encoding="utf-8") as f:
+        f.write(f"{cpu % 4},{cpu % 4 + 4}\n")
+
+    cores = sharded_runner.physical_cores(range(8), sysfs_path)
+    self.assertEqual(cores, [[0, 4], [1, 5], [2, 6], [3, 7]])
+
+    workers, housekeeping = sharded_runner.worker_cpus(cores)
+    self.assertEqual(workers, [1, 2, 3])
+    self.assertEqual(housekeeping, [0, 4])
+
+    workers, _ = sharded_runner.worker_cpus(cores, max_workers=2)
+    self.assertEqual(workers, [1, 2])
+
+    with self.assertRaises(ValueError):
+      sharded_runner.worker_cpus(cores[:1])
+
+  def test_parse_cpu_list(self):
+    self.assertEqual(sharded_runner._parse_cpu_list("0-2,8\n"), {0, 1, 2, 8})
+
+  def test_longest_first(self):
+    cpu = min(os.sched_getaffinity(0))
+    jobs = [sharded_runner.Job(args=[str(cost)], cost=cost) for cost in [2, 5, 1, 3]]
+    order = []
+
+    completed = sharded_runner.run_jobs(self.bin_path, jobs, [cpu], os.environ.copy(),
+                                        lambda job, record: order.append(record["encodeTime"]))
+
+    self.assertEqual(order, [5, 3, 2, 1])
+    self.assertEqual(len(completed), 4)
+
+  def test_skew(self):
+    cpu = min(os.sched_getaffinity(0))
+    job = sharded_runner.Job(args=["2"], cost=1)
+
+    # the concurrent run was twice as slow as the isolated one
+    skew = sharded_runner.measure_skew(self.bin_path, [(job, {"encodeTime": 4, "decodeTime": 2})], cpu,
+                                       os.environ.copy(), 5)
+
+    self.assertEqual(skew.sample_count, 1)
+    self.assertAlmostEqual(skew.encode_ratio_median, 2)
+    self.assertAlmostEqual(skew.decode_ratio_max, 1)
+
+    self.assertIsNone(sharded_runner.measure_skew(self.bin_path, [], cpu, os.environ.copy(), 5))
+
+
+if __name__ == '__main__':
+  unittest.main()
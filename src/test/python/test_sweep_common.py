@@ -0,0 +1,35 @@
+import unittest
+import os
+import stat
+import subprocess
+import sweep_common
+
+
+class SweepCommonTest(unittest.TestCase):
+
+  BUILD_DIR = "build/python_test"
+
+  def setUp(self):
+    os.makedirs(SweepCommonTest.BUILD_DIR, exist_ok=True)
+
+    # stands in for libench: prints a record holding OMP_NUM_THREADS, or fails if its first argument is fail
+    self.bin_path = os.path.abspath(os.path.join(SweepCommonTest.BUILD_DIR, "fake_sweep_libench"))
+    with open(self.bin_path, "w", encoding="utf-8") as f:
+      f.write("#!/bin/sh\n"
+              "if [ \"$1\" = fail ]; then echo \"bad codec\" >&2; exit 1; fi\n"
+              "echo \"{\\\"encodeTimes\\\": [3, 1, 2], \\\"decodeTimes\\\": [5, 4], \\\"threads\\\": $OMP_NUM_THREADS}\"\n")
+    os.chmod(self.bin_path, os.stat(self.bin_path).st_mode | stat.S_IXUSR)
+
+  def test_run_libench(self):
+    record = sweep_common.run_libench(self.bin_path, ["qoi"])
+    self.assertEqual(record["threads"], 1)
+    self.assertEqual(sweep_common.best_times(record), (1, 4))
+
+  def test_run_libench_failure(self):
+    with self.assertRaises(subprocess.CalledProcessError) as cm:
+      sweep_common.run_libench(self.bin_path, ["fail"], capture_stderr=True)
+    self.assertEqual(cm.exception.stderr.strip(), "bad codec")
+
+
+if __name__ == '__main__':
+  unittest.main()